@@ -0,0 +1,325 @@
+// ================================================================
+// FASTRNG.C
+// Please see the comments in fastrng.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fastrng.h"
+#include "psdes.h"
+#include "urandom.h"
+
+// ----------------------------------------------------------------
+// SplitMix64, for expanding a 64-bit seed into a larger state.
+static uint64_t splitmix64(uint64_t* px)
+{
+	uint64_t z = (*px += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+// ================================================================
+// xoshiro256++
+void xoshiro256_seed_r(xoshiro256_state_t* pstate, uint64_t seed)
+{
+	int k;
+	for (k = 0; k < 4; k++)
+		pstate->s[k] = splitmix64(&seed);
+}
+
+uint64_t xoshiro256_next_r(xoshiro256_state_t* pstate)
+{
+	uint64_t* s = pstate->s;
+	uint64_t result = rotl64(s[0] + s[3], 23) + s[0];
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl64(s[3], 45);
+	return result;
+}
+
+// ================================================================
+// PCG64, XSL-RR output.  The seeding follows pcg_setseq_128_srandom_r().
+#define PCG64_MULT \
+	(((unsigned __int128)0x2360ed051fc65da4ULL << 64) | 0x4385df649fccf645ULL)
+#define PCG64_STREAM \
+	(((unsigned __int128)0x5851f42d4c957f2dULL << 64) | 0x14057b7ef767814fULL)
+
+static inline void pcg64_step(pcg64_state_t* pstate)
+{
+	pstate->state = pstate->state * PCG64_MULT + pstate->inc;
+}
+
+void pcg64_seed_r(pcg64_state_t* pstate, uint64_t seed)
+{
+	pstate->state = 0;
+	pstate->inc   = (PCG64_STREAM << 1) | 1;
+	pcg64_step(pstate);
+	pstate->state += seed;
+	pcg64_step(pstate);
+}
+
+uint64_t pcg64_next_r(pcg64_state_t* pstate)
+{
+	unsigned __int128 old = pstate->state;
+	uint64_t x = (uint64_t)(old >> 64) ^ (uint64_t)old;
+	int rot = (int)(old >> 122);
+
+	pcg64_step(pstate);
+	return (x >> rot) | (x << ((-rot) & 63));
+}
+
+// ================================================================
+// Philox4x32-10.
+#define PHILOX_M0 0xd2511f53U
+#define PHILOX_M1 0xcd9e8d57U
+#define PHILOX_W0 0x9e3779b9U
+#define PHILOX_W1 0xbb67ae85U
+
+void philox4x32_10(uint32_t key[2], uint64_t counter, uint32_t out[4])
+{
+	uint32_t c0 = (uint32_t)counter;
+	uint32_t c1 = (uint32_t)(counter >> 32);
+	uint32_t c2 = 0;
+	uint32_t c3 = 0;
+	uint32_t k0 = key[0];
+	uint32_t k1 = key[1];
+	int round;
+
+	for (round = 0; round < 10; round++) {
+		uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+		uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+		uint32_t hi0 = (uint32_t)(p0 >> 32), lo0 = (uint32_t)p0;
+		uint32_t hi1 = (uint32_t)(p1 >> 32), lo1 = (uint32_t)p1;
+
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+void philox_seed_r(philox_state_t* pstate, uint64_t seed)
+{
+	pstate->key[0]  = (uint32_t)seed;
+	pstate->key[1]  = (uint32_t)(seed >> 32);
+	pstate->counter = 0;
+	pstate->outpos  = 4;
+}
+
+uint64_t philox_next_r(philox_state_t* pstate)
+{
+	uint64_t result;
+	if (pstate->outpos >= 4) {
+		philox4x32_10(pstate->key, pstate->counter++, pstate->out);
+		pstate->outpos = 0;
+	}
+	result = ((uint64_t)pstate->out[pstate->outpos] << 32)
+		| pstate->out[pstate->outpos+1];
+	pstate->outpos += 2;
+	return result;
+}
+
+// ================================================================
+// The runtime-selectable front end.  The selection is shared by all threads;
+// the states are per thread, unless rcm_use_state() says otherwise.
+
+static int rcm_which = RCM_GEN_RAND48;
+
+#define RCM_STATE_UNSEEDED { \
+	-1, \
+	{ 0x330e, 0, 0 }, \
+	0, 0, \
+	{ { 0x9e3779b97f4a7c15ULL, 0xbf58476d1ce4e5b9ULL, \
+	    0x94d049bb133111ebULL, 0x2545f4914f6cdd1dULL } }, \
+	{ 0, 1 }, \
+	{ { 0, 0 }, 0, { 0 }, 4 } \
+}
+
+static const rcm_state_t unseeded_state = RCM_STATE_UNSEEDED;
+static __thread rcm_state_t thread_state = RCM_STATE_UNSEEDED;
+static __thread rcm_state_t* pcurrent_state = 0;
+
+static char* rcm_names[RCM_NUM_GENS] = {
+	"rand48", "psdes", "urandom", "xoshiro", "pcg64", "philox"
+};
+
+// The calling thread's current stream, and the generator it uses.
+static inline rcm_state_t* current_state(int* pwhich)
+{
+	rcm_state_t* ps = pcurrent_state ? pcurrent_state : &thread_state;
+	*pwhich = (ps->which < 0) ? rcm_which : ps->which;
+	return ps;
+}
+
+// ----------------------------------------------------------------
+void rcm_select_generator(int which)
+{
+	if ((which < 0) || (which >= RCM_NUM_GENS)) {
+		fprintf(stderr, "rcm_select_generator:  unknown generator %d.\n",
+			which);
+		exit(1);
+	}
+	rcm_which = which;
+}
+
+int rcm_get_generator(void)
+{
+	return rcm_which;
+}
+
+int rcm_generator_by_name(char* name)
+{
+	int which;
+	for (which = 0; which < RCM_NUM_GENS; which++)
+		if (strcmp(name, rcm_names[which]) == 0)
+			return which;
+	return -1;
+}
+
+char* rcm_generator_name(int which)
+{
+	return rcm_names[which];
+}
+
+// ----------------------------------------------------------------
+// The rand48 state is set as srand48() would set it, so that the sequence
+// from erand48() and nrand48() is that of drand48() and lrand48().
+static void seed_state(rcm_state_t* ps, int which, uint64_t seed)
+{
+	switch (which) {
+	case RCM_GEN_RAND48:
+		ps->rand48[0] = 0x330e;
+		ps->rand48[1] = (unsigned short)(seed & 0xffff);
+		ps->rand48[2] = (unsigned short)((seed >> 16) & 0xffff);
+		break;
+	case RCM_GEN_PSDES:
+		ps->psdes0 = 0;
+		ps->psdes1 = (unsigned)seed;
+		break;
+	case RCM_GEN_URANDOM:
+		break;
+	case RCM_GEN_XOSHIRO:
+		xoshiro256_seed_r(&ps->xoshiro, seed);
+		break;
+	case RCM_GEN_PCG64:
+		pcg64_seed_r(&ps->pcg64, seed);
+		break;
+	case RCM_GEN_PHILOX:
+		philox_seed_r(&ps->philox, seed);
+		break;
+	}
+}
+
+void rcm_seed(uint64_t seed)
+{
+	int which;
+	rcm_state_t* ps = current_state(&which);
+	seed_state(ps, which, seed);
+}
+
+// ----------------------------------------------------------------
+void rcm_state_init(rcm_state_t* pstate, int which, uint64_t seed)
+{
+	if ((which < -1) || (which >= RCM_NUM_GENS)) {
+		fprintf(stderr, "rcm_state_init:  unknown generator %d.\n", which);
+		exit(1);
+	}
+	*pstate = unseeded_state;
+	pstate->which = which;
+	seed_state(pstate, (which < 0) ? rcm_which : which, seed);
+}
+
+rcm_state_t* rcm_use_state(rcm_state_t* pstate)
+{
+	rcm_state_t* pprev = pcurrent_state;
+	pcurrent_state = pstate;
+	return pprev;
+}
+
+// ----------------------------------------------------------------
+double rcm_urandom(void)
+{
+	int which;
+	rcm_state_t* ps = current_state(&which);
+
+	switch (which) {
+	case RCM_GEN_XOSHIRO:
+		return U64_TO_UNIT_DOUBLE(xoshiro256_next_r(&ps->xoshiro));
+	case RCM_GEN_PCG64:
+		return U64_TO_UNIT_DOUBLE(pcg64_next_r(&ps->pcg64));
+	case RCM_GEN_PHILOX:
+		return U64_TO_UNIT_DOUBLE(philox_next_r(&ps->philox));
+	case RCM_GEN_PSDES:
+		return fran32_r(&ps->psdes0, &ps->psdes1);
+	case RCM_GEN_URANDOM:
+		return get_urandomu();
+	default:
+		return erand48(ps->rand48);
+	}
+}
+
+// ----------------------------------------------------------------
+void rcm_urandom_fill(double* out, int n)
+{
+	int which;
+	rcm_state_t* ps = current_state(&which);
+	int k;
+
+	switch (which) {
+	case RCM_GEN_PSDES:
+		fran32_fill_r(out, n, &ps->psdes0, &ps->psdes1);
+		break;
+	case RCM_GEN_XOSHIRO:
+		for (k = 0; k < n; k++)
+			out[k] = U64_TO_UNIT_DOUBLE(xoshiro256_next_r(&ps->xoshiro));
+		break;
+	case RCM_GEN_PCG64:
+		for (k = 0; k < n; k++)
+			out[k] = U64_TO_UNIT_DOUBLE(pcg64_next_r(&ps->pcg64));
+		break;
+	default:
+		for (k = 0; k < n; k++)
+			out[k] = rcm_urandom();
+		break;
+	}
+}
+
+// ----------------------------------------------------------------
+uint32_t rcm_irandom32(void)
+{
+	int which;
+	rcm_state_t* ps = current_state(&which);
+
+	switch (which) {
+	case RCM_GEN_XOSHIRO:
+		return (uint32_t)(xoshiro256_next_r(&ps->xoshiro) >> 32);
+	case RCM_GEN_PCG64:
+		return (uint32_t)(pcg64_next_r(&ps->pcg64) >> 32);
+	case RCM_GEN_PHILOX:
+		return (uint32_t)(philox_next_r(&ps->philox) >> 32);
+	case RCM_GEN_PSDES:
+		return iran32_r(&ps->psdes0, &ps->psdes1);
+	case RCM_GEN_URANDOM:
+		return (uint32_t)get_urandom();
+	default:
+		return (uint32_t)nrand48(ps->rand48);
+	}
+}
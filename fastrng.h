@@ -0,0 +1,125 @@
+// ================================================================
+// FASTRNG.H
+//
+// These are fast pseudorandom-number generators, each with an explicit state
+// object, along with a runtime-selectable front end used by rcmrand.h.
+//
+// * xoshiro256++ (Blackman and Vigna):  256 bits of state, a few shifts,
+//   rotates, and adds per 64-bit output.
+// * PCG64 (O'Neill), the XSL-RR variant:  a 128-bit linear congruential
+//   generator with a permuted 64-bit output.
+// * Philox4x32-10 (Salmon et al.):  a counter-based generator.  Output block
+//   k is a keyed bijection of the counter k, so any block can be computed
+//   independently of the others; the state is just the key and the counter.
+//
+// As in psdes.h, the routines ending in "_r" are reentrant:  you keep the
+// state yourself.  The seeding routines take a 64-bit seed and expand it as
+// each generator's authors recommend.
+//
+// ================================================================
+// RUNTIME SELECTION
+//
+// rcmrand.h (with RCM_WHICH == RCM_RUNTIME, the default) maps SRANDOM(),
+// URANDOM(), and IMODRANDOM() to rcm_seed(), rcm_urandom(), and
+// rcm_irandom32(), which call whichever generator was chosen by
+// rcm_select_generator().  Besides the above three, the choices are the
+// older generators:  rand48 (the default, giving the same sequence as
+// srand48()/drand48()), psdes, and urandom.  The generator states are
+// thread-local, so each thread has its own stream; a thread which does not
+// seed its generator gets the seed 0.
+//
+// A caller which wants a stream of its own, independent of the thread it
+// runs on, may keep an rcm_state_t and install it with rcm_use_state() for
+// as long as it draws from it.  The contexts in perco2ctx.h do this.
+// ================================================================
+
+#ifndef FASTRNG_H
+#define FASTRNG_H
+
+#include <stdint.h>
+
+// ----------------------------------------------------------------
+typedef struct _xoshiro256_state_t {
+	uint64_t s[4];
+} xoshiro256_state_t;
+
+void     xoshiro256_seed_r(xoshiro256_state_t* pstate, uint64_t seed);
+uint64_t xoshiro256_next_r(xoshiro256_state_t* pstate);
+
+// ----------------------------------------------------------------
+typedef struct _pcg64_state_t {
+	unsigned __int128 state;
+	unsigned __int128 inc;   // Must be odd
+} pcg64_state_t;
+
+void     pcg64_seed_r(pcg64_state_t* pstate, uint64_t seed);
+uint64_t pcg64_next_r(pcg64_state_t* pstate);
+
+// ----------------------------------------------------------------
+typedef struct _philox_state_t {
+	uint32_t key[2];
+	uint64_t counter;    // Index of the next block
+	uint32_t out[4];     // The current block
+	int      outpos;     // Next unused word of out[], or 4 if none
+} philox_state_t;
+
+void     philox_seed_r(philox_state_t* pstate, uint64_t seed);
+uint64_t philox_next_r(philox_state_t* pstate);
+// The block of four 32-bit words for a given key and counter.
+void     philox4x32_10(uint32_t key[2], uint64_t counter, uint32_t out[4]);
+
+// ----------------------------------------------------------------
+// Converts 64 random bits to a double uniform on [0.0, 1.0), using the top
+// 53 bits.
+#define U64_TO_UNIT_DOUBLE(x) ((double)((x) >> 11) * (1.0/9007199254740992.0))
+
+// ================================================================
+// The runtime-selectable front end.
+
+#define RCM_GEN_RAND48   0
+#define RCM_GEN_PSDES    1
+#define RCM_GEN_URANDOM  2
+#define RCM_GEN_XOSHIRO  3
+#define RCM_GEN_PCG64    4
+#define RCM_GEN_PHILOX   5
+#define RCM_NUM_GENS     6
+
+// All of one stream's state, for every generator, so that the generator may
+// be chosen at run time.
+typedef struct _rcm_state_t {
+	int                which;      // RCM_GEN_*, or -1 for the global choice
+	unsigned short     rand48[3];
+	unsigned           psdes0, psdes1;
+	xoshiro256_state_t xoshiro;
+	pcg64_state_t      pcg64;
+	philox_state_t     philox;
+} rcm_state_t;
+
+// Sets up a stream using the given generator (or -1 for whichever
+// rcm_select_generator() chose at the time of each draw), seeded with seed.
+void rcm_state_init(rcm_state_t* pstate, int which, uint64_t seed);
+
+// Makes the routines below use *pstate on the calling thread, until the next
+// call; a null pstate goes back to the thread's own state.  Returns the
+// previous one (null for the thread's own), so that calls may be nested.
+rcm_state_t* rcm_use_state(rcm_state_t* pstate);
+
+// Selects the generator for all threads.  Call this before seeding.
+void  rcm_select_generator(int which);
+int   rcm_get_generator(void);
+// Looks up "rand48", "psdes", "urandom", "xoshiro", "pcg64", or "philox",
+// returning the RCM_GEN_* value, or -1 if the name is not one of those.
+int   rcm_generator_by_name(char* name);
+char* rcm_generator_name(int which);
+
+// Seeds the selected generator, for the calling thread's current stream.
+void     rcm_seed(uint64_t seed);
+// Uniform double on [0.0, 1.0).
+double   rcm_urandom(void);
+// n uniform doubles, the same as n calls to rcm_urandom().  For psdes this
+// uses the bulk fran32_fill_r(), which hashes several states at once.
+void     rcm_urandom_fill(double* out, int n);
+// Uniform 32-bit unsigned integer.
+uint32_t rcm_irandom32(void);
+
+#endif // FASTRNG_H
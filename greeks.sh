@@ -21,6 +21,13 @@
 # * theta = P(A in C)
 # * sigma = P(A1 in C or A2 in C)
 # * tau   = P(A1 o--o A2)
+#
+# "perco2 sweep" runs the same grid in one process on all CPUs; please see
+# README.txt.
+#
+# With a second argument, e.g. "greeks.sh theta greeks.cache", results are
+# kept in that file, with seed=1, 2, 3 for the three tries, so that a rerun
+# after adding points or raising reps computes only what is new.
 # ================================================================
 # John Kerl
 # kerl.john.r@gmail.com
@@ -39,11 +46,12 @@ reps=10000
 tries="1 2 3"
 
 # E.g. one may type "greeks.sh theta", "greeks.sh sigma", "greeks.sh tau".
-if [ $# -ne 1 ]; then
-	echo "Usage: $0 {theta|sigma|tau}" 1>&2
+if [ $# -ne 1 -a $# -ne 2 ]; then
+	echo "Usage: $0 {theta|sigma|tau} [cache file]" 1>&2
 	exit 1
 fi
 greek=$1
+cache=$2
 
 if   [ $greek = theta ]; then
 	cmd=PAinC
@@ -59,7 +67,11 @@ fi
 for MN in $MNs; do
 	for p in $ps; do
 		for try in $tries; do
-			./perco2 $cmd reps=$reps MN=$MN p=$p
+			if [ -n "$cache" ]; then
+				./perco2 $cmd reps=$reps MN=$MN p=$p seed=$try cache=$cache
+			else
+				./perco2 $cmd reps=$reps MN=$MN p=$p
+			fi
 		done
 	done
 done
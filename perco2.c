@@ -23,15 +23,39 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "putil.h"
 #include "perco2lib.h"
 #include "perco2print.h"
 #include "perco2plot.h"
+#include "perco2fixed.h"
+#include "perco2pad.h"
+#include "perco2tile.h"
+#include "perco2ws.h"
+#include "perco2wrap.h"
+#include "perco2chem.h"
+#include "perco2engine.h"
+#include "perco2mem.h"
+#include "perco2sweep.h"
+#include "perco2cache.h"
+#include "perco2io.h"
+#include "percod.h"
 #include "rcmrand.h"
 
 // ----------------------------------------------------------------
 // Prototypes for functions local to this file:
 static void main_usage(char* argv0);
+static void parse_global_options(int* pargc, char*** pargv);
+static void get_realization(int** vbonds, int** hbonds, int M, int N,
+	double p);
+static void save_realization(int** vbonds, int** hbonds, int** site_marks,
+	int M, int N, double p);
+static int  parse_avg_option(char* arg, int* pavg_all);
 static void usage(char* argv0, char* argv1, int print_reps_usage);
 
 static void test_print_lattice        (int argc, char** argv);
@@ -42,32 +66,70 @@ static void test_plot_cluster         (int argc, char** argv);
 static void test_mean_C0_size         (int argc, char** argv);
 static void test_mean_finite_C0_size  (int argc, char** argv);
 static void test_corrlen              (int argc, char** argv);
+static void test_P_wrap               (int argc, char** argv);
+static void test_chemical_distance    (int argc, char** argv);
 static void test_A1_oo_A2             (int argc, char** argv);
 static void test_P_A1_oo_A2           (int argc, char** argv);
 static void test_cluster_numbers      (int argc, char** argv);
 static void test_plot_clusters        (int argc, char** argv);
+static void test_plot_pyramid         (int argc, char** argv);
 static void test_cluster_sizes        (int argc, char** argv);
 static void test_A_in_C               (int argc, char** argv);
 static void test_P_A_in_C             (int argc, char** argv);
 static void test_A1_or_A2_in_C        (int argc, char** argv);
 static void test_P_A1_or_A2_in_C      (int argc, char** argv);
+static void test_percod               (int argc, char** argv);
+static void test_bench_labeling       (int argc, char** argv);
+static void test_bc_compare           (int argc, char** argv);
+static void test_bench_rng            (int argc, char** argv);
+static void test_bench_avg            (int argc, char** argv);
+static void test_sweep                (int argc, char** argv);
+static void test_serve                (int argc, char** argv);
+static void test_cluster_size_dist    (int argc, char** argv);
+
+// ----------------------------------------------------------------
+// State for the seed=, save=, load=, and cache= options.  The seed is chosen
+// here, rather than inside the RNG, so that it can be recorded in saved files.
+static unsigned long long rng_seed = 0;
+static int rng_seed_given = 0; // By seed=, load=, or a serve job's seed=
+static char* save_file_name = 0;
+static perco2_mapped_file_t* ploaded_file = 0;
+static int realization_io_done = 0;
+static result_cache_t* presult_cache = 0;
+static int mem_report = 0; // Set by mem=
 
 // ----------------------------------------------------------------
 int main(int argc, char** argv)
 {
-	STRANDOM(); // Seed the random-number generator.
+	int argi;
 
 	// If the user invoked us with no arguments, give them a usage message.
 
 	if (argc < 2)
 		main_usage(argv[0]);
 
+	// Options such as "layout=padded" apply to all commands.  Handle them
+	// here, removing them from the argument list.
+	rng_seed = (unsigned)(time(0) ^ getpid());
+	parse_global_options(&argc, &argv);
+
+	SRANDOM(rng_seed); // Seed the random-number generator.
+
 	// Invoke the appropriate subroutine (if any) for the first argument the
 	// user typed, passing all remaining arguments along to that subroutine.
 	// If the first argument is unrecognized, give them a usage message.
 	//
 	// Sample command line:  "./perco2 print p=0.6 M=8 N=16".
 
+	// A "dim=2" or "dim=3" argument selects the dimension-generic routines in
+	// percod.h, for the estimators which those support.
+	for (argi = 2; argi < argc; argi++) {
+		if (strncmp(argv[argi], "dim=", 4) == 0) {
+			test_percod(argc, argv);
+			return 0;
+		}
+	}
+
 	if      (strcmp(argv[1], "print") == 0)
 		test_print_lattice(argc, argv);
 	else if (strcmp(argv[1], "plot") == 0)
@@ -86,6 +148,10 @@ int main(int argc, char** argv)
 		test_mean_finite_C0_size(argc, argv);
 	else if (strcmp(argv[1], "corrlen") == 0)
 		test_corrlen(argc, argv);
+	else if (strcmp(argv[1], "Pwrap") == 0)
+		test_P_wrap(argc, argv);
+	else if (strcmp(argv[1], "chemdist") == 0)
+		test_chemical_distance(argc, argv);
 
 	else if (strcmp(argv[1], "1o2") == 0)
 		test_A1_oo_A2(argc, argv);
@@ -96,6 +162,8 @@ int main(int argc, char** argv)
 		test_cluster_numbers(argc, argv);
 	else if (strcmp(argv[1], "plotclusters") == 0)
 		test_plot_clusters(argc, argv);
+	else if (strcmp(argv[1], "plotpyramid") == 0)
+		test_plot_pyramid(argc, argv);
 	else if (strcmp(argv[1], "clszs") == 0)
 		test_cluster_sizes(argc, argv);
 
@@ -109,9 +177,33 @@ int main(int argc, char** argv)
 	else if (strcmp(argv[1], "PU2inC") == 0) // This is sigma(p) in greeks.sh.
 		test_P_A1_or_A2_in_C(argc, argv);
 
+	else if (strcmp(argv[1], "benchlabel") == 0)
+		test_bench_labeling(argc, argv);
+	else if (strcmp(argv[1], "bccmp") == 0)
+		test_bc_compare(argc, argv);
+	else if (strcmp(argv[1], "benchrng") == 0)
+		test_bench_rng(argc, argv);
+	else if (strcmp(argv[1], "benchavg") == 0)
+		test_bench_avg(argc, argv);
+	else if (strcmp(argv[1], "sweep") == 0)
+		test_sweep(argc, argv);
+	else if (strcmp(argv[1], "serve") == 0)
+		test_serve(argc, argv);
+	else if (strcmp(argv[1], "clsdist") == 0)
+		test_cluster_size_dist(argc, argv);
+
 	else
 		main_usage(argv[0]);
 
+	if ((save_file_name || ploaded_file) && !realization_io_done)
+		fprintf(stderr, "%s: save= and load= are ignored by \"%s\".\n",
+			argv[0], argv[1]);
+	fflush(stdout); // So the reports follow the results
+	if (get_labeling_engine() == ENGINE_AUTO)
+		print_engine_choices(stderr);
+	if (mem_report)
+		print_mem_report(stderr);
+
 	return 0;
 }
 
@@ -123,11 +215,271 @@ static void main_usage(char* argv0)
 	fprintf(stderr, "Usage: %s {command} [options].\n", argv0);
 	fprintf(stderr, "Commands: print plot nei cluster plotcluster meanC0size "
 		"meanfC0size corrlen\n");
-	fprintf(stderr, "  1o2 P1o2 clnos plotclusters clszs\n");
+	fprintf(stderr, "  Pwrap chemdist\n");
+	fprintf(stderr, "  1o2 P1o2 clnos plotclusters plotpyramid clszs\n");
 	fprintf(stderr, "  AinC PAinC U2inC PU2inC\n");
+	fprintf(stderr, "  benchlabel bccmp benchrng benchavg sweep serve "
+		"clsdist\n");
+	fprintf(stderr, "With dim=2 or dim=3: PAinC PU2inC P1o2 meanC0size "
+		"corrlen\n");
+	fprintf(stderr, "Options for all commands:\n");
+	fprintf(stderr, "  layout={plain|padded} : Lattice storage layout\n");
+	fprintf(stderr, "  bc={periodic|helical} : Boundary conditions\n");
+	fprintf(stderr, "  seed={n}              : RNG seed (default from time "
+		"and PID)\n");
+	fprintf(stderr, "  rng={name}            : RNG:  rand48 (default), psdes, "
+		"urandom,\n");
+	fprintf(stderr, "                          xoshiro, pcg64, or philox\n");
+	fprintf(stderr, "  threads={n|all}       : Threads for labeling lattices "
+		"of 256x256 or more\n");
+	fprintf(stderr, "  engine={name|auto}    : Labeling engine, as listed by "
+		"benchlabel, or auto\n");
+	fprintf(stderr, "  tune={file}           : Tuning file for engine=auto "
+		"(default %s)\n", DEFAULT_TUNING_FILE);
+	fprintf(stderr, "  mem={name}            : Large arrays from malloc "
+		"(default), thp, or hugetlb;\n");
+	fprintf(stderr, "                          reports how they were "
+		"obtained\n");
+	fprintf(stderr, "  save={file}           : Save the realization (and "
+		"cluster numbers)\n");
+	fprintf(stderr, "  load={file}           : Use a saved realization; sets "
+		"M, N, and p\n");
+	fprintf(stderr, "  cache={file}          : Store results; run only reps "
+		"not already stored\n");
+	fprintf(stderr, "save= and load= apply to the commands which use one "
+		"realization.\n");
+	fprintf(stderr, "cache= applies to PAinC, PU2inC, P1o2, and "
+		"meanC0size, and needs seed=.\n");
 	exit(1);
 }
 
+// ----------------------------------------------------------------
+// Handles the options which apply to all commands, removing them from argv
+// and decrementing *pargc accordingly.  The remaining arguments are left for
+// the individual command handlers to parse.
+//
+// For load=, the file's M, N, and p are appended to the argument list as
+// "M=...", "N=...", and "p=...", so that they override any given by the
+// user.  This needs a longer argv, so *pargv is replaced.
+static void parse_global_options(int* pargc, char*** pargv)
+{
+	char** argv = *pargv;
+	char** new_argv = (char**)malloc_or_die((*pargc + 4) * sizeof(char*));
+	int argi, argo;
+	int nthreads;
+
+	new_argv[0] = argv[0];
+	new_argv[1] = argv[1];
+	for (argi = 2, argo = 2; argi < *pargc; argi++) {
+		if (strcmp(argv[argi], "layout=plain") == 0)
+			set_lattice_layout(LAYOUT_PLAIN);
+		else if (strcmp(argv[argi], "layout=padded") == 0)
+			set_lattice_layout(LAYOUT_PADDED);
+		else if (strcmp(argv[argi], "bc=periodic") == 0)
+			set_boundary_condition(BC_PERIODIC);
+		else if (strcmp(argv[argi], "bc=helical") == 0)
+			set_boundary_condition(BC_HELICAL);
+		else if (sscanf(argv[argi], "seed=%llu", &rng_seed) == 1)
+			rng_seed_given = 1;
+		else if (strcmp(argv[argi], "threads=all") == 0)
+			set_labeling_threads(0);
+		else if (sscanf(argv[argi], "threads=%d", &nthreads) == 1)
+			set_labeling_threads(nthreads);
+		else if (strncmp(argv[argi], "engine=", 7) == 0) {
+			int engine = labeling_engine_by_name(&argv[argi][7]);
+			if (engine == ENGINE_UNKNOWN) {
+				fprintf(stderr, "%s: unknown engine \"%s\".\n",
+					argv[0], &argv[argi][7]);
+				exit(1);
+			}
+			set_labeling_engine(engine);
+		}
+		else if (strncmp(argv[argi], "tune=", 5) == 0)
+			set_tuning_file(&argv[argi][5]);
+		else if (strncmp(argv[argi], "mem=", 4) == 0) {
+			int policy = mem_policy_by_name(&argv[argi][4]);
+			if (policy < 0) {
+				fprintf(stderr, "%s: unknown mem= \"%s\".\n",
+					argv[0], &argv[argi][4]);
+				exit(1);
+			}
+			set_mem_policy(policy);
+			mem_report = 1;
+		}
+		else if (strncmp(argv[argi], "rng=", 4) == 0) {
+			int which = rcm_generator_by_name(&argv[argi][4]);
+			if (which < 0) {
+				fprintf(stderr, "%s: unknown generator \"%s\".\n",
+					argv[0], &argv[argi][4]);
+				exit(1);
+			}
+			rcm_select_generator(which);
+		}
+		else if (strncmp(argv[argi], "save=", 5) == 0)
+			save_file_name = &argv[argi][5];
+		else if (strncmp(argv[argi], "load=", 5) == 0)
+			ploaded_file = map_lattice_file(&argv[argi][5]);
+		else if (strncmp(argv[argi], "cache=", 6) == 0)
+			presult_cache = result_cache_open(&argv[argi][6]);
+		else
+			new_argv[argo++] = argv[argi];
+	}
+
+	if (ploaded_file) {
+		perco2_file_header_t* pheader = ploaded_file->pheader;
+		new_argv[argo] = (char*)malloc_or_die(32);
+		sprintf(new_argv[argo++], "M=%d", (int)pheader->M);
+		new_argv[argo] = (char*)malloc_or_die(32);
+		sprintf(new_argv[argo++], "N=%d", (int)pheader->N);
+		new_argv[argo] = (char*)malloc_or_die(32);
+		sprintf(new_argv[argo++], "p=%.17g", pheader->p);
+		set_boundary_condition((pheader->flags & PERCO2_FILE_HELICAL)
+			? BC_HELICAL : BC_PERIODIC);
+		rng_seed = pheader->seed;
+		rng_seed_given = 1;
+	}
+	new_argv[argo] = 0;
+
+	// The seed is part of every cache key, so with the default time-based
+	// seed nothing stored would ever be found again.  serve jobs may give
+	// their own seed=, so serve_job() checks for itself.
+	if (presult_cache && !rng_seed_given && strcmp(argv[1], "serve")) {
+		fprintf(stderr, "%s: cache= needs seed= as well.\n", argv[0]);
+		exit(1);
+	}
+
+	*pargc = argo;
+	*pargv = new_argv;
+}
+
+// ----------------------------------------------------------------
+// The commands which work on one realization call this rather than calling
+// populate_bonds() directly.  With load=, the bonds come from the file;
+// otherwise they are drawn at random.
+static void get_realization(int** vbonds, int** hbonds, int M, int N,
+	double p)
+{
+	if (ploaded_file) {
+		unpack_lattice_bonds(ploaded_file, vbonds, hbonds);
+		realization_io_done = 1;
+	}
+	else {
+		populate_bonds(vbonds, hbonds, M, N, p);
+	}
+}
+
+// ----------------------------------------------------------------
+// With save=, writes the realization to the file, along with the cluster
+// numbers if site_marks is non-null.
+static void save_realization(int** vbonds, int** hbonds, int** site_marks,
+	int M, int N, double p)
+{
+	if (!save_file_name)
+		return;
+	save_lattice_file(save_file_name, vbonds, hbonds, site_marks,
+		M, N, p, rng_seed, 0);
+	realization_io_done = 1;
+}
+
+// ----------------------------------------------------------------
+// Handles "avg=center" (the default) and "avg=all" for the estimators which
+// have translation-averaged versions.  Returns 1 if arg was one of those.
+static int parse_avg_option(char* arg, int* pavg_all)
+{
+	if (strcmp(arg, "avg=center") == 0)
+		*pavg_all = 0;
+	else if (strcmp(arg, "avg=all") == 0)
+		*pavg_all = 1;
+	else
+		return 0;
+	return 1;
+}
+
+// ----------------------------------------------------------------
+// The estimators which the sweep command and cache= can run:  those which are
+// means over reps, so that runs of reps can be combined.
+typedef struct _estimator_args_t {
+	char* cmd;
+	int   avg_all;
+} estimator_args_t;
+
+static double estimate_mean(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps, void* parg)
+{
+	estimator_args_t* pargs = (estimator_args_t*)parg;
+	int A1[d], A2[d];
+
+	set_A1_A2(A1, A2, M, N);
+	if (strcmp(pargs->cmd, "PAinC") == 0)
+		return pargs->avg_all
+			? P_A_in_C_avg_all(site_marks, vbonds, hbonds, M, N, p, reps)
+			: P_A_in_C(site_marks, vbonds, hbonds, M, N, p, reps, A1);
+	else if (strcmp(pargs->cmd, "PU2inC") == 0)
+		return pargs->avg_all
+			? P_A1_or_A2_in_C_avg_all(site_marks, vbonds, hbonds, M, N, p,
+				reps)
+			: P_A1_or_A2_in_C(site_marks, vbonds, hbonds, M, N, p, reps,
+				A1, A2);
+	else if (strcmp(pargs->cmd, "meanC0size") == 0)
+		return pargs->avg_all
+			? get_mean_C0_size_avg_all(site_marks, vbonds, hbonds, M, N, p,
+				reps)
+			: get_mean_C0_size(site_marks, vbonds, hbonds, M, N, p, reps,
+				A1);
+	else
+		return P_A1_oo_A2(site_marks, vbonds, hbonds, M, N, p, reps, A1, A2);
+}
+
+// ----------------------------------------------------------------
+// Runs reps of one of the estimators above, for the single-point commands.
+// With cache=, the result comes from the store as far as it goes, and only
+// the missing reps are run and then recorded there.  *preps is set to the
+// number of reps the result is over, which may be more than were asked for.
+static double run_cached_estimator(estimator_args_t* pargs, int** site_marks,
+	int** vbonds, int** hbonds, int M, int N, double p, int* preps)
+{
+	char key[512];
+	double sum, value;
+	int have, more;
+
+	if (!presult_cache)
+		return estimate_mean(site_marks, vbonds, hbonds, M, N, p, *preps,
+			pargs);
+
+	snprintf(key, sizeof(key),
+		"cmd=%s avg=%s M=%d N=%d p=%.17g seed=%llu rng=%s bc=%s",
+		pargs->cmd, pargs->avg_all ? "all" : "center", M, N, p, rng_seed,
+		RCM_RAND_DESC,
+		(get_boundary_condition() == BC_HELICAL) ? "helical" : "periodic");
+	have = result_cache_lookup(presult_cache, key, &sum);
+	if (have < *preps) {
+		more = *preps - have;
+		SRANDOM(result_cache_run_seed(rng_seed, have));
+		value = estimate_mean(site_marks, vbonds, hbonds, M, N, p, more,
+			pargs);
+		result_cache_append(presult_cache, key, have, more, value * more);
+		sum  += value * more;
+		have += more;
+	}
+	*preps = have;
+	return sum / have;
+}
+
+// ----------------------------------------------------------------
+// Prints an estimate in the same format as the command which computes it.
+static void print_estimate(FILE* fp, char* cmd, int M, int N, double p,
+	int reps, double value)
+{
+	fprintf(fp, "M=%d N=%d p=%.4lf reps=%d ", M, N, p, reps);
+	if (strcmp(cmd, "meanC0size") == 0)
+		fprintf(fp, "<size>=%11.7lf <density>=%11.7lf\n",
+			value, value/M/N);
+	else if (strcmp(cmd, "P1o2") == 0)
+		fprintf(fp, "PA1ooA2=%11.7lf\n", value);
+	else
+		fprintf(fp, "%s=%11.7lf\n", cmd, value);
+}
+
 // ----------------------------------------------------------------
 // Usage routine invoked by individual command handlers in the case of invalid
 // argument 2 and above.  All of those routines take mostly the same syntax, so
@@ -142,6 +494,8 @@ static void usage(char* argv0, char* argv1, int print_reps_usage)
 	fprintf(stderr, "p=[...]    : Bond probability (0 <= p <= 1)\n");
 	if (print_reps_usage)
 		fprintf(stderr, "reps=[...] : Number of repetitions for P.\n");
+	fprintf(stderr, "avg=all    : Average over all sites as origin "
+		"(PAinC, PU2inC, meanC0size)\n");
 	exit(1);
 }
 
@@ -185,7 +539,8 @@ static void test_print_lattice(int argc, char** argv)
 	set_A1_A2(A1, A2, M, N);
 
 	// Populate the bonds with probability p.
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
+	save_realization(vbonds, hbonds, 0, M, N, p);
 
 	// Print the lattice.
 	print_lattice(site_marks, vbonds, hbonds, M, N, A1, A2);
@@ -233,7 +588,8 @@ static void test_plot_lattice(int argc, char** argv)
 	site_marks = allocate_matrix(M, N, SITECHAR);
 	set_A1_A2(A1, A2, M, N);
 
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
+	save_realization(vbonds, hbonds, 0, M, N, p);
 	plot_lattice(site_marks, vbonds, hbonds, M, N, A1, A2,
 		image_file_name);
 	printf("Wrote %s.\n", image_file_name);
@@ -282,7 +638,8 @@ static void test_get_bonded_neighbors(int argc, char** argv)
 	site_marks = allocate_matrix(M, N, SITECHAR);
 	set_A1_A2(A1, A2, M, N);
 
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
+	save_realization(vbonds, hbonds, 0, M, N, p);
 	print_lattice(site_marks, vbonds, hbonds, M, N, A1, A2);
 	printf("\n");
 
@@ -338,7 +695,8 @@ static void test_cluster(int argc, char** argv)
 	site_marks = allocate_matrix(M, N, SITECHAR);
 	set_A1_A2(A1, A2, M, N);
 
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
+	save_realization(vbonds, hbonds, 0, M, N, p);
 	mark_one_cluster(site_marks, vbonds, hbonds, M, N, A1, VISITEDCHAR);
 	print_lattice(site_marks, vbonds, hbonds, M, N, A1, A2);
 
@@ -389,7 +747,8 @@ static void test_plot_cluster(int argc, char** argv)
 	site_marks = allocate_matrix(M, N, SITECHAR);
 	set_A1_A2(A1, A2, M, N);
 
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
+	save_realization(vbonds, hbonds, 0, M, N, p);
 	mark_one_cluster(site_marks, vbonds, hbonds, M, N, A1, VISITEDCHAR);
 	if (compact)
 		plot_one_cluster_compactly(site_marks, vbonds, hbonds, M, N,
@@ -418,9 +777,8 @@ static void test_mean_C0_size(int argc, char** argv)
 	int** vbonds;
 	int** hbonds;
 	int** site_marks;
-	int A1[d];
-	int A2[d];
 	double mean_C0_size;
+	estimator_args_t args = { "meanC0size", 0 };
 
 	for (argi = 2; argi < argc; argi++) {
 		if (sscanf(argv[argi], "M=%d", &M) == 1)
@@ -433,6 +791,8 @@ static void test_mean_C0_size(int argc, char** argv)
 			;
 		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
 			;
+		else if (parse_avg_option(argv[argi], &args.avg_all))
+			;
 		else
 			usage(argv[0], argv[1], 1);
 	}
@@ -442,10 +802,9 @@ static void test_mean_C0_size(int argc, char** argv)
 	vbonds = allocate_matrix(M, N, 0);
 	hbonds = allocate_matrix(M, N, 0);
 	site_marks = allocate_matrix(M, N, SITECHAR);
-	set_A1_A2(A1, A2, M, N);
 
-	mean_C0_size = get_mean_C0_size(site_marks, vbonds, hbonds,
-		M, N, p, reps, A1);
+	mean_C0_size = run_cached_estimator(&args, site_marks, vbonds, hbonds,
+		M, N, p, &reps);
 	printf("M=%d N=%d p=%.4lf reps=%d <size>=%11.7lf <density>=%11.7lf\n",
 		M, N, p, reps, mean_C0_size, mean_C0_size/M/N);
 
@@ -553,6 +912,113 @@ static void test_corrlen(int argc, char** argv)
 	free_matrix(site_marks, M, N);
 }
 
+// ----------------------------------------------------------------
+// Over a specified number of repetitions:  randomly populates lattice bonds
+// and finds whether some cluster wraps around the torus horizontally,
+// vertically, both ways, or either way.  Prints the fraction of repetitions
+// for each.
+static void test_P_wrap(int argc, char** argv)
+{
+	int   M = 18;
+	int   N = 18;
+	double p = 0.5;
+	int   reps = 1000;
+	int argi;
+	perco_ws_t* pws = perco_ws_current();
+	double R_h, R_v, R_both, R_either;
+
+	for (argi = 2; argi < argc; argi++) {
+		if (sscanf(argv[argi], "M=%d", &M) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &N) == 1)
+			;
+		else if (sscanf(argv[argi], "MN=%d", &M) == 1)
+			N = M;
+		else if (sscanf(argv[argi], "p=%lf", &p) == 1)
+			;
+		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
+			;
+		else
+			usage(argv[0], argv[1], 1);
+	}
+	if ((M < 3) || (N < 3) || (reps < 1))
+		usage(argv[0], argv[1], 1);
+	if (get_boundary_condition() != BC_PERIODIC) {
+		fprintf(stderr, "%s %s: wrapping needs bc=periodic.\n",
+			argv[0], argv[1]);
+		exit(1);
+	}
+
+	perco_ws_shape(pws, M, N);
+	get_wrapping_probabilities(pws->vbonds, pws->hbonds, M, N, p, reps,
+		&R_h, &R_v, &R_both, &R_either);
+	printf("M=%d N=%d p=%.4lf reps=%d R_h=%11.7lf R_v=%11.7lf "
+		"R_both=%11.7lf R_either=%11.7lf\n",
+		M, N, p, reps, R_h, R_v, R_both, R_either);
+}
+
+// ----------------------------------------------------------------
+// Over a specified number of repetitions:  randomly populates lattice bonds
+// and finds the chemical distance between A1 and A2, when they are
+// connected, and from A1 to the farthest site of its cluster.  Prints the
+// means, then histograms of both, binned as by chem_dist_bin().
+static void test_chemical_distance(int argc, char** argv)
+{
+	int   M = 18;
+	int   N = 18;
+	double p = 0.6;
+	int   reps = 1000;
+	int argi, b;
+	perco_ws_t* pws = perco_ws_current();
+	int A1[d], A2[d];
+	long long dist_bins[CHEM_DIST_BINS];
+	long long radius_bins[CHEM_DIST_BINS];
+	long long num_connected = 0;
+	double dist_sum = 0.0, radius_sum = 0.0;
+
+	for (argi = 2; argi < argc; argi++) {
+		if (sscanf(argv[argi], "M=%d", &M) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &N) == 1)
+			;
+		else if (sscanf(argv[argi], "MN=%d", &M) == 1)
+			N = M;
+		else if (sscanf(argv[argi], "p=%lf", &p) == 1)
+			;
+		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
+			;
+		else
+			usage(argv[0], argv[1], 1);
+	}
+	if ((M < 3) || (N < 3) || (reps < 1))
+		usage(argv[0], argv[1], 1);
+
+	perco_ws_shape(pws, M, N);
+	set_A1_A2(A1, A2, M, N);
+	for (b = 0; b < CHEM_DIST_BINS; b++)
+		dist_bins[b] = radius_bins[b] = 0;
+
+	get_chemical_distances(pws->vbonds, pws->hbonds, M, N, p, reps, A1, A2,
+		dist_bins, radius_bins, &num_connected, &dist_sum, &radius_sum);
+
+	printf("# M=%d N=%d p=%.4lf reps=%d P1o2=%.7lf mean_dist=%.7lf "
+		"mean_radius=%.7lf\n", M, N, p, reps, (double)num_connected / reps,
+		num_connected ? dist_sum / num_connected : 0.0, radius_sum / reps);
+	printf("# %8s %10s %14s %14s %14s %14s\n", "d_lo", "d_hi", "A1A2",
+		"frac", "radius", "frac");
+	for (b = 0; b < CHEM_DIST_BINS; b++) {
+		long long d_lo = (b == 0) ? 0 : 1LL << (b-1);
+		long long d_hi = (b == 0) ? 0 : (1LL << b) - 1;
+		if ((dist_bins[b] == 0) && (radius_bins[b] == 0))
+			continue;
+		printf("  %8lld %10lld %14lld %14.7le %14lld %14.7le\n",
+			d_lo, d_hi,
+			dist_bins[b], num_connected ?
+				(double)dist_bins[b] / num_connected : 0.0,
+			radius_bins[b], (double)radius_bins[b] / reps);
+	}
+}
+
 // ----------------------------------------------------------------
 // Randomly populates lattice bonds and determines if there exists a path from
 // the center site to the site diagonally below and to the right.  One may then
@@ -590,7 +1056,8 @@ static void test_A1_oo_A2(int argc, char** argv)
 	site_marks = allocate_matrix(M, N, SITECHAR);
 	set_A1_A2(A1, A2, M, N);
 
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
+	save_realization(vbonds, hbonds, 0, M, N, p);
 	print_lattice(site_marks, vbonds, hbonds, M, N, A1, A2);
 	printf("\n");
 	ctd = A1_oo_A2(site_marks, vbonds, hbonds, M, N, A1, A2);
@@ -619,9 +1086,8 @@ static void test_P_A1_oo_A2(int argc, char** argv)
 	int** vbonds;
 	int** hbonds;
 	int** site_marks;
-	int A1[d];
-	int A2[d];
 	double P;
+	estimator_args_t args = { "P1o2", 0 };
 
 	for (argi = 2; argi < argc; argi++) {
 		if (sscanf(argv[argi], "M=%d", &M) == 1)
@@ -643,9 +1109,9 @@ static void test_P_A1_oo_A2(int argc, char** argv)
 	vbonds = allocate_matrix(M, N, 0);
 	hbonds = allocate_matrix(M, N, 0);
 	site_marks = allocate_matrix(M, N, SITECHAR);
-	set_A1_A2(A1, A2, M, N);
 
-	P = P_A1_oo_A2(site_marks, vbonds, hbonds, M, N, p, reps, A1, A2);
+	P = run_cached_estimator(&args, site_marks, vbonds, hbonds, M, N, p,
+		&reps);
 	printf("M=%d N=%d p=%.4lf reps=%d PA1ooA2=%11.7lf\n", M, N, p, reps, P);
 
 	free_matrix(vbonds,     M, N);
@@ -688,11 +1154,12 @@ static void test_cluster_numbers(int argc, char** argv)
 	hbonds = allocate_matrix(M, N, 0);
 	site_marks = allocate_matrix(M, N, SITECHAR);
 
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
 	print_lattice(site_marks, vbonds, hbonds, M, N, A1, A2);
 	printf("\n");
 
 	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, 0);
+	save_realization(vbonds, hbonds, site_marks, M, N, p);
 	print_lattice_and_cluster_numbers(site_marks, vbonds, hbonds, M, N);
 	sanity_check_cluster_numbers(site_marks, vbonds, hbonds, M, N);
 
@@ -717,6 +1184,7 @@ static void test_plot_clusters(int argc, char** argv)
 	int A2[d] = {-1, -1}; // Not used here
 	char* image_file_name = "p2.ppm";
 	int compact = 1;
+	int stream = 0;
 
 	for (argi = 2; argi < argc; argi++) {
 		if (sscanf(argv[argi], "M=%d", &M) == 1)
@@ -731,6 +1199,8 @@ static void test_plot_clusters(int argc, char** argv)
 			image_file_name = &argv[argi][2];
 		else if (sscanf(argv[argi], "c=%d", &compact) == 1)
 			;
+		else if (sscanf(argv[argi], "stream=%d", &stream) == 1)
+			;
 		else
 			usage(argv[0], argv[1], 0);
 	}
@@ -740,9 +1210,16 @@ static void test_plot_clusters(int argc, char** argv)
 	vbonds = allocate_matrix(M, N, 0);
 	hbonds = allocate_matrix(M, N, 0);
 	site_marks = allocate_matrix(M, N, SITECHAR);
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
 	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, 0);
-	if (compact)
+	save_realization(vbonds, hbonds, site_marks, M, N, p);
+	if (stream && compact)
+		plot_all_clusters_compactly_streaming(site_marks, vbonds, hbonds,
+			M, N, A1, A2, image_file_name);
+	else if (stream)
+		plot_lattice_and_all_clusters_streaming(site_marks, vbonds, hbonds,
+			M, N, A1, A2, image_file_name);
+	else if (compact)
 		plot_all_clusters_compactly(site_marks, vbonds, hbonds, M, N,
 			A1, A2, image_file_name);
 	else
@@ -755,6 +1232,63 @@ static void test_plot_clusters(int argc, char** argv)
 	free_matrix(site_marks, M, N);
 }
 
+// ----------------------------------------------------------------
+// Randomly populates lattice bonds and marks all clusters, writing
+// downsampled overview images of the result:  please see plot_pyramid() in
+// perco2plot.h.
+static void test_plot_pyramid(int argc, char** argv)
+{
+	int   M = 1024;
+	int   N = 1024;
+	double p = 0.5;
+	int   k = 4;
+	int   levels = 4;
+	int argi;
+	int** vbonds;
+	int** hbonds;
+	int** site_marks;
+	int* cluster_sizes;
+	int num_clusters, C_clno;
+	char* prefix = "pyr";
+
+	for (argi = 2; argi < argc; argi++) {
+		if (sscanf(argv[argi], "M=%d", &M) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &N) == 1)
+			;
+		else if (sscanf(argv[argi], "MN=%d", &M) == 1)
+			N = M;
+		else if (sscanf(argv[argi], "p=%lf", &p) == 1)
+			;
+		else if (sscanf(argv[argi], "k=%d", &k) == 1)
+			;
+		else if (sscanf(argv[argi], "levels=%d", &levels) == 1)
+			;
+		else if (strncmp(argv[argi], "f=", 2) == 0)
+			prefix = &argv[argi][2];
+		else
+			usage(argv[0], argv[1], 0);
+	}
+	if ((M < 3) || (N < 3) || (k < 1) || (levels < 1))
+		usage(argv[0], argv[1], 0);
+
+	vbonds = allocate_matrix(M, N, 0);
+	hbonds = allocate_matrix(M, N, 0);
+	site_marks = allocate_matrix(M, N, SITECHAR);
+	cluster_sizes = (int*)large_alloc_or_die((size_t)M * N * sizeof(int));
+	get_realization(vbonds, hbonds, M, N, p);
+	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, &num_clusters);
+	save_realization(vbonds, hbonds, site_marks, M, N, p);
+	get_cluster_sizes(site_marks, M, N, num_clusters, cluster_sizes, &C_clno);
+
+	plot_pyramid(site_marks, vbonds, hbonds, M, N, C_clno, k, levels, prefix);
+
+	large_free(cluster_sizes);
+	free_matrix(vbonds,     M, N);
+	free_matrix(hbonds,     M, N);
+	free_matrix(site_marks, M, N);
+}
+
 // ----------------------------------------------------------------
 // Randomly populates lattice bonds, marks all clusters, and computes cluster
 // sizes.  One may then visually verify the cluster-size computation.
@@ -794,8 +1328,9 @@ static void test_cluster_sizes(int argc, char** argv)
 	hbonds = allocate_matrix(M, N, 0);
 	site_marks = allocate_matrix(M, N, SITECHAR);
 
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
 	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, &num_clusters);
+	save_realization(vbonds, hbonds, site_marks, M, N, p);
 	if (print_lattice)
 		print_lattice_and_cluster_numbers(site_marks, vbonds, hbonds, M, N);
 	sanity_check_cluster_numbers(site_marks, vbonds, hbonds, M, N);
@@ -858,8 +1393,9 @@ static void test_A_in_C(int argc, char** argv)
 	site_marks = allocate_matrix(M, N, SITECHAR);
 	set_A1(A, M, N);
 
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
 	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, &num_clusters);
+	save_realization(vbonds, hbonds, site_marks, M, N, p);
 	if (print_lattice)
 		print_lattice_and_cluster_numbers(site_marks, vbonds, hbonds, M, N);
 	sanity_check_cluster_numbers(site_marks, vbonds, hbonds, M, N);
@@ -893,9 +1429,9 @@ static void test_P_A_in_C(int argc, char** argv)
 	int** vbonds;
 	int** hbonds;
 	int** site_marks;
-	int A[d];
 	int   reps = 1000;
 	double P;
+	estimator_args_t args = { "PAinC", 0 };
 
 	for (argi = 2; argi < argc; argi++) {
 		if (sscanf(argv[argi], "M=%d", &M) == 1)
@@ -908,6 +1444,8 @@ static void test_P_A_in_C(int argc, char** argv)
 			;
 		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
 			;
+		else if (parse_avg_option(argv[argi], &args.avg_all))
+			;
 		else
 			usage(argv[0], argv[1], 0);
 	}
@@ -917,9 +1455,9 @@ static void test_P_A_in_C(int argc, char** argv)
 	vbonds = allocate_matrix(M, N, 0);
 	hbonds = allocate_matrix(M, N, 0);
 	site_marks = allocate_matrix(M, N, SITECHAR);
-	set_A1(A, M, N);
 
-	P = P_A_in_C(site_marks, vbonds, hbonds, M, N, p, reps, A);
+	P = run_cached_estimator(&args, site_marks, vbonds, hbonds, M, N, p,
+		&reps);
 	printf("M=%d N=%d p=%.4lf reps=%d PAinC=%11.7lf\n", M, N, p, reps, P);
 
 	free_matrix(vbonds,     M, N);
@@ -971,8 +1509,9 @@ static void test_A1_or_A2_in_C(int argc, char** argv)
 	site_marks = allocate_matrix(M, N, SITECHAR);
 	set_A1_A2(A1, A2, M, N);
 
-	populate_bonds(vbonds, hbonds, M, N, p);
+	get_realization(vbonds, hbonds, M, N, p);
 	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, &num_clusters);
+	save_realization(vbonds, hbonds, site_marks, M, N, p);
 	if (print_lattice)
 		print_lattice_and_cluster_numbers(site_marks, vbonds, hbonds, M, N);
 	sanity_check_cluster_numbers(site_marks, vbonds, hbonds, M, N);
@@ -1014,9 +1553,9 @@ static void test_P_A1_or_A2_in_C(int argc, char** argv)
 	int** vbonds;
 	int** hbonds;
 	int** site_marks;
-	int A1[d], A2[d];
 	int   reps = 1000;
 	double P;
+	estimator_args_t args = { "PU2inC", 0 };
 
 	for (argi = 2; argi < argc; argi++) {
 		if (sscanf(argv[argi], "M=%d", &M) == 1)
@@ -1029,6 +1568,8 @@ static void test_P_A1_or_A2_in_C(int argc, char** argv)
 			;
 		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
 			;
+		else if (parse_avg_option(argv[argi], &args.avg_all))
+			;
 		else
 			usage(argv[0], argv[1], 0);
 	}
@@ -1038,12 +1579,1053 @@ static void test_P_A1_or_A2_in_C(int argc, char** argv)
 	vbonds = allocate_matrix(M, N, 0);
 	hbonds = allocate_matrix(M, N, 0);
 	site_marks = allocate_matrix(M, N, SITECHAR);
-	set_A1_A2(A1, A2, M, N);
 
-	P = P_A1_or_A2_in_C(site_marks, vbonds, hbonds, M, N, p, reps, A1, A2);
+	P = run_cached_estimator(&args, site_marks, vbonds, hbonds, M, N, p,
+		&reps);
 	printf("M=%d N=%d p=%.4lf reps=%d PU2inC=%11.7lf\n", M, N, p, reps, P);
 
 	free_matrix(vbonds,     M, N);
 	free_matrix(hbonds,     M, N);
 	free_matrix(site_marks, M, N);
 }
+
+// ----------------------------------------------------------------
+// One of the estimators from percod.h, by command name.
+static double run_percod_estimator(char* cmd, percod_lattice_t* plat,
+	double p, int reps)
+{
+	if (strcmp(cmd, "PAinC") == 0)
+		return percod_P_A_in_C(plat, p, reps);
+	else if (strcmp(cmd, "PU2inC") == 0)
+		return percod_P_A1_or_A2_in_C(plat, p, reps);
+	else if (strcmp(cmd, "P1o2") == 0)
+		return percod_P_A1_oo_A2(plat, p, reps);
+	else if (strcmp(cmd, "meanC0size") == 0)
+		return percod_get_mean_C0_size(plat, p, reps);
+	else
+		return percod_get_corrlen(plat, p, reps);
+}
+
+// ----------------------------------------------------------------
+// As run_cached_estimator(), for test_percod(), with the dimension and all the
+// side lengths in the key.  corrlen is not a mean over reps, so it is never
+// cached, as without dim=.
+static double run_cached_percod_estimator(char* cmd, percod_lattice_t* plat,
+	int D, int* dims, double p, int* preps)
+{
+	char key[512];
+	double sum, value;
+	int have, more;
+
+	if (!presult_cache || (strcmp(cmd, "corrlen") == 0))
+		return run_percod_estimator(cmd, plat, p, *preps);
+
+	snprintf(key, sizeof(key),
+		"cmd=%s dim=%d M=%d N=%d L=%d p=%.17g seed=%llu rng=%s bc=%s",
+		cmd, D, dims[0], dims[1], (D == 3) ? dims[2] : 1, p, rng_seed,
+		RCM_RAND_DESC,
+		(get_boundary_condition() == BC_HELICAL) ? "helical" : "periodic");
+	have = result_cache_lookup(presult_cache, key, &sum);
+	if (have < *preps) {
+		more = *preps - have;
+		SRANDOM(result_cache_run_seed(rng_seed, have));
+		value = run_percod_estimator(cmd, plat, p, more);
+		result_cache_append(presult_cache, key, have, more, value * more);
+		sum  += value * more;
+		have += more;
+	}
+	*preps = have;
+	return sum / have;
+}
+
+// ----------------------------------------------------------------
+// For given lattice dimension, side lengths, and bond density, runs one of the
+// estimators from percod.h.  This handles the estimator commands for which a
+// "dim=2" or "dim=3" argument was given; see main().
+static void test_percod(int argc, char** argv)
+{
+	int   D = 2;
+	int   dims[PERCOD_MAXD] = {18, 18, 18};
+	double p = 0.6;
+	int   reps = 1000;
+	int argi, k;
+	percod_lattice_t* plat;
+	char* label;
+	double value;
+
+	for (argi = 2; argi < argc; argi++) {
+		if (sscanf(argv[argi], "dim=%d", &D) == 1)
+			;
+		else if (sscanf(argv[argi], "M=%d", &dims[0]) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &dims[1]) == 1)
+			;
+		else if (sscanf(argv[argi], "L=%d", &dims[2]) == 1)
+			;
+		else if (sscanf(argv[argi], "MNL=%d", &dims[0]) == 1)
+			dims[1] = dims[2] = dims[0];
+		else if (sscanf(argv[argi], "MN=%d", &dims[0]) == 1)
+			dims[1] = dims[0];
+		else if (sscanf(argv[argi], "p=%lf", &p) == 1)
+			;
+		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
+			;
+		else
+			usage(argv[0], argv[1], 1);
+	}
+	if ((D < 2) || (D > PERCOD_MAXD))
+		usage(argv[0], argv[1], 1);
+	for (k = 0; k < D; k++)
+		if (dims[k] < 3)
+			usage(argv[0], argv[1], 1);
+
+	if (strcmp(argv[1], "PAinC") == 0)
+		label = "PAinC";
+	else if (strcmp(argv[1], "PU2inC") == 0)
+		label = "PU2inC";
+	else if (strcmp(argv[1], "P1o2") == 0)
+		label = "PA1ooA2";
+	else if (strcmp(argv[1], "meanC0size") == 0)
+		label = "<size>";
+	else if (strcmp(argv[1], "corrlen") == 0)
+		label = "corrlen";
+	else {
+		main_usage(argv[0]);
+		return;
+	}
+
+	plat = percod_alloc(D, dims);
+	percod_set_boundary_condition(plat, get_boundary_condition());
+	value = run_cached_percod_estimator(argv[1], plat, D, dims, p, &reps);
+
+	printf("d=%d M=%d N=%d", D, dims[0], dims[1]);
+	if (D == 3)
+		printf(" L=%d", dims[2]);
+	printf(" p=%.4lf reps=%d %s=%11.7lf\n", p, reps, label, value);
+
+	percod_free(plat);
+}
+
+// ----------------------------------------------------------------
+// Over a specified number of repetitions: randomly populates lattice bonds
+// and runs each applicable cluster-labeling routine on the same realization,
+// checking that they all produce the same cluster numbers as the generic
+// depth-first search.  Prints the time per lattice site for each.  Above
+// DFS_MAX_SITES the depth-first search does not apply, and the tiled labeler
+// is the reference instead.
+static void test_bench_labeling(int argc, char** argv)
+{
+	int   M = 128;
+	int   N = 128;
+	double p = 0.5;
+	int   reps = 100;
+	int argi;
+	int** vbonds;
+	int** hbonds;
+	int** site_marks;
+	int** ref_marks;
+	int num_engines = num_labeling_engines();
+	double* seconds;
+	long long* allocs;
+	long long count0;
+	double t0;
+	int rep, e, i, j;
+	int num_clusters, ref_num_clusters;
+
+	for (argi = 2; argi < argc; argi++) {
+		if (sscanf(argv[argi], "M=%d", &M) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &N) == 1)
+			;
+		else if (sscanf(argv[argi], "MN=%d", &M) == 1)
+			N = M;
+		else if (sscanf(argv[argi], "p=%lf", &p) == 1)
+			;
+		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
+			;
+		else
+			usage(argv[0], argv[1], 1);
+	}
+	if ((M < 3) || (N < 3))
+		usage(argv[0], argv[1], 1);
+
+	vbonds     = allocate_matrix(M, N, 0);
+	hbonds     = allocate_matrix(M, N, 0);
+	site_marks = allocate_matrix(M, N, SITECHAR);
+	ref_marks  = allocate_matrix(M, N, SITECHAR);
+
+	seconds = (double*)malloc_or_die(num_engines * sizeof(double));
+	allocs  = (long long*)malloc_or_die(num_engines * sizeof(long long));
+	for (e = 0; e < num_engines; e++) {
+		seconds[e] = 0.0;
+		allocs[e]  = 0;
+	}
+
+	for (rep = 0; rep < reps; rep++) {
+		populate_bonds(vbonds, hbonds, M, N, p);
+		if ((long long)M * N > DFS_MAX_SITES)
+			mark_cluster_numbers_tiled(ref_marks, vbonds, hbonds, M, N,
+				&ref_num_clusters);
+		else
+			mark_cluster_numbers_dfs(ref_marks, vbonds, hbonds, M, N,
+				&ref_num_clusters);
+
+		for (e = 0; e < num_engines; e++) {
+			if (!labeling_engine_applies(e, M, N))
+				continue;
+			count0 = get_malloc_count();
+			t0 = get_sys_time_float();
+			run_labeling_engine(e, site_marks, vbonds, hbonds, M, N,
+				&num_clusters);
+			seconds[e] += get_sys_time_float() - t0;
+			// The first rep warms the workspace.
+			if (rep > 0)
+				allocs[e] += get_malloc_count() - count0;
+
+			if (num_clusters != ref_num_clusters) {
+				fprintf(stderr, "%s: %s: cluster-count mismatch.\n",
+					argv[0], labeling_engine_name(e));
+				exit(1);
+			}
+			for (i = 0; i < M; i++) {
+				for (j = 0; j < N; j++) {
+					if (site_marks[i][j] != ref_marks[i][j]) {
+						fprintf(stderr, "%s: %s: cluster-number mismatch.\n",
+							argv[0], labeling_engine_name(e));
+						exit(1);
+					}
+				}
+			}
+		}
+	}
+
+	for (e = 0; e < num_engines; e++) {
+		if (!labeling_engine_applies(e, M, N))
+			continue;
+		printf("M=%d N=%d p=%.4lf reps=%d engine=%-7s ns/site=%9.3lf "
+			"allocs/rep=%.3lf\n",
+			M, N, p, reps, labeling_engine_name(e),
+			1e9 * seconds[e] / reps / M / N,
+			(reps > 1) ? (double)allocs[e] / (reps - 1) : 0.0);
+	}
+
+	free_matrix(vbonds,     M, N);
+	free_matrix(hbonds,     M, N);
+	free_matrix(site_marks, M, N);
+	free_matrix(ref_marks,  M, N);
+	free(seconds);
+	free(allocs);
+}
+
+// ----------------------------------------------------------------
+// Runs one of the estimators for a given number of repetitions, under the
+// current boundary condition, returning its value.
+static double run_estimator(char* cmd, int M, int N, double p, int reps)
+{
+	int** vbonds     = allocate_matrix(M, N, 0);
+	int** hbonds     = allocate_matrix(M, N, 0);
+	int** site_marks = allocate_matrix(M, N, SITECHAR);
+	int A1[d], A2[d];
+	double value;
+
+	set_A1_A2(A1, A2, M, N);
+
+	if (strcmp(cmd, "PAinC") == 0)
+		value = P_A_in_C(site_marks, vbonds, hbonds, M, N, p, reps, A1);
+	else if (strcmp(cmd, "PU2inC") == 0)
+		value = P_A1_or_A2_in_C(site_marks, vbonds, hbonds, M, N, p, reps,
+			A1, A2);
+	else if (strcmp(cmd, "P1o2") == 0)
+		value = P_A1_oo_A2(site_marks, vbonds, hbonds, M, N, p, reps, A1, A2);
+	else if (strcmp(cmd, "meanC0size") == 0)
+		value = get_mean_C0_size(site_marks, vbonds, hbonds, M, N, p, reps,
+			A1);
+	else if (strcmp(cmd, "meanfC0size") == 0)
+		value = get_mean_finite_C0_size(site_marks, vbonds, hbonds, M, N, p,
+			reps, A1);
+	else if (strcmp(cmd, "corrlen") == 0)
+		value = get_corrlen(site_marks, vbonds, hbonds, M, N, p, reps, A1);
+	else {
+		fprintf(stderr, "run_estimator: unknown estimator \"%s\".\n", cmd);
+		exit(1);
+	}
+
+	free_matrix(vbonds,     M, N);
+	free_matrix(hbonds,     M, N);
+	free_matrix(site_marks, M, N);
+	return value;
+}
+
+// ----------------------------------------------------------------
+// Runs an estimator under periodic and under helical boundary conditions,
+// and prints each value with its standard error along with their difference.
+// The reps are split into batches, alternating between the two boundary
+// conditions; the standard errors are those of the batch means.  A large
+// |z| means the boundary conditions give detectably different answers at
+// this lattice size.
+static void test_bc_compare(int argc, char** argv)
+{
+	char*  cmd = "PAinC";
+	int    M = 50;
+	int    N = 50;
+	double p = 0.5;
+	int    reps = 10000;
+	int    batches = 20;
+	int argi, batch, bc;
+	int batch_reps;
+	double sum[2]  = { 0.0, 0.0 };
+	double sum2[2] = { 0.0, 0.0 };
+	double mean[2], stderror[2];
+	double value, diff, diff_stderror;
+	int saved_bc = get_boundary_condition();
+
+	for (argi = 2; argi < argc; argi++) {
+		if (strncmp(argv[argi], "cmd=", 4) == 0)
+			cmd = &argv[argi][4];
+		else if (sscanf(argv[argi], "M=%d", &M) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &N) == 1)
+			;
+		else if (sscanf(argv[argi], "MN=%d", &M) == 1)
+			N = M;
+		else if (sscanf(argv[argi], "p=%lf", &p) == 1)
+			;
+		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
+			;
+		else if (sscanf(argv[argi], "batches=%d", &batches) == 1)
+			;
+		else
+			usage(argv[0], argv[1], 1);
+	}
+	if ((M < 3) || (N < 3) || (batches < 2) || (reps < batches))
+		usage(argv[0], argv[1], 1);
+	batch_reps = reps / batches;
+
+	for (batch = 0; batch < batches; batch++) {
+		for (bc = 0; bc < 2; bc++) {
+			set_boundary_condition(bc == 0 ? BC_PERIODIC : BC_HELICAL);
+			value = run_estimator(cmd, M, N, p, batch_reps);
+			sum[bc]  += value;
+			sum2[bc] += value * value;
+		}
+	}
+	set_boundary_condition(saved_bc);
+
+	for (bc = 0; bc < 2; bc++) {
+		double var;
+		mean[bc] = sum[bc] / batches;
+		var = (sum2[bc] - batches * mean[bc] * mean[bc]) / (batches - 1);
+		stderror[bc] = (var > 0.0) ? sqrt(var / batches) : 0.0;
+	}
+	diff = mean[1] - mean[0];
+	diff_stderror = sqrt(stderror[0]*stderror[0] + stderror[1]*stderror[1]);
+
+	printf("M=%d N=%d p=%.4lf reps=%d batches=%d %s\n",
+		M, N, p, batch_reps * batches, batches, cmd);
+	printf("  periodic=%11.7lf +- %9.7lf\n", mean[0], stderror[0]);
+	printf("  helical =%11.7lf +- %9.7lf\n", mean[1], stderror[1]);
+	printf("  diff    =%11.7lf +- %9.7lf z=%.3lf\n", diff, diff_stderror,
+		(diff_stderror > 0.0) ? diff / diff_stderror : 0.0);
+}
+
+// ----------------------------------------------------------------
+// For each of the generators in fastrng.h, times populate_bonds() and prints
+// the number of bonds per second.
+static void test_bench_rng(int argc, char** argv)
+{
+	int   M = 1000;
+	int   N = 1000;
+	double p = 0.5;
+	int   reps = 20;
+	int argi, rep, which;
+	int** vbonds;
+	int** hbonds;
+	int saved_which = rcm_get_generator();
+	int max_lanes = psdes_simd_lanes();
+	int lanes;
+	double t0, seconds;
+
+	for (argi = 2; argi < argc; argi++) {
+		if (sscanf(argv[argi], "M=%d", &M) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &N) == 1)
+			;
+		else if (sscanf(argv[argi], "MN=%d", &M) == 1)
+			N = M;
+		else if (sscanf(argv[argi], "p=%lf", &p) == 1)
+			;
+		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
+			;
+		else
+			usage(argv[0], argv[1], 1);
+	}
+	if ((M < 3) || (N < 3) || (reps < 1))
+		usage(argv[0], argv[1], 1);
+
+	vbonds = allocate_matrix(M, N, 0);
+	hbonds = allocate_matrix(M, N, 0);
+
+	// Each generator, then psdes again with each narrower SIMD width the CPU
+	// supports, down to scalar.
+	for (which = 0; which < RCM_NUM_GENS + 2; which++) {
+		char name[32];
+		if (which < RCM_NUM_GENS) {
+			rcm_select_generator(which);
+			strcpy(name, rcm_generator_name(which));
+		}
+		else {
+			lanes = (which == RCM_NUM_GENS) ? 8 : 1;
+			if (lanes >= max_lanes)
+				continue;
+			rcm_select_generator(RCM_GEN_PSDES);
+			psdes_set_simd_lanes(lanes);
+			sprintf(name, "psdes/%d", lanes);
+		}
+		if (which == RCM_GEN_PSDES)
+			sprintf(name, "psdes/%d", max_lanes);
+		SRANDOM(rng_seed);
+		populate_bonds(vbonds, hbonds, M, N, p); // Warm up
+		t0 = get_sys_time_float();
+		for (rep = 0; rep < reps; rep++)
+			populate_bonds(vbonds, hbonds, M, N, p);
+		seconds = get_sys_time_float() - t0;
+		printf("M=%d N=%d p=%.4lf reps=%d rng=%-8s Mbonds/sec=%9.3lf\n",
+			M, N, p, reps, name,
+			2.0 * M * N * reps / seconds * 1e-6);
+	}
+	rcm_select_generator(saved_which);
+	psdes_set_simd_lanes(max_lanes);
+
+	free_matrix(vbonds, M, N);
+	free_matrix(hbonds, M, N);
+}
+
+// ----------------------------------------------------------------
+// Compares the single-origin and translation-averaged (avg=all) versions of
+// an estimator:  PAinC, PU2inC, or meanC0size.  For each, prints the mean,
+// its standard error, the variance of one realization's score, and the time
+// per realization.  The figure of merit is 1/(variance * time):  the inverse
+// of the CPU time needed to reach a given standard error.  Both versions see
+// the same realizations.
+static void test_bench_avg(int argc, char** argv)
+{
+	char*  cmd = "PAinC";
+	int    M = 50;
+	int    N = 50;
+	double p = 0.5;
+	int    reps = 10000;
+	int argi, rep, avg_all;
+	int** vbonds;
+	int** hbonds;
+	int** site_marks;
+	int* cluster_sizes;
+	perco_ws_t* pws = perco_ws_current();
+	int A1[d], A2[d];
+	long long count0 = 0;
+	double value, sum, sum2, mean, var, t0, seconds, allocs;
+	double var_of[2], seconds_of[2];
+
+	for (argi = 2; argi < argc; argi++) {
+		if (strncmp(argv[argi], "cmd=", 4) == 0)
+			cmd = &argv[argi][4];
+		else if (sscanf(argv[argi], "M=%d", &M) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &N) == 1)
+			;
+		else if (sscanf(argv[argi], "MN=%d", &M) == 1)
+			N = M;
+		else if (sscanf(argv[argi], "p=%lf", &p) == 1)
+			;
+		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
+			;
+		else
+			usage(argv[0], argv[1], 1);
+	}
+	if ((M < 3) || (N < 3) || (reps < 2))
+		usage(argv[0], argv[1], 1);
+	if (strcmp(cmd, "PAinC") && strcmp(cmd, "PU2inC")
+	&& strcmp(cmd, "meanC0size")) {
+		fprintf(stderr, "%s %s: cmd must be PAinC, PU2inC, or meanC0size.\n",
+			argv[0], argv[1]);
+		exit(1);
+	}
+
+	perco_ws_shape(pws, M, N);
+	vbonds        = pws->vbonds;
+	hbonds        = pws->hbonds;
+	site_marks    = pws->site_marks;
+	cluster_sizes = pws->cluster_sizes;
+	set_A1_A2(A1, A2, M, N);
+
+	for (avg_all = 0; avg_all < 2; avg_all++) {
+		SRANDOM(rng_seed);
+		sum = sum2 = 0.0;
+		t0 = get_sys_time_float();
+		for (rep = 0; rep < reps; rep++) {
+			populate_bonds(vbonds, hbonds, M, N, p);
+			if (strcmp(cmd, "PAinC") == 0)
+				value = avg_all
+					? A_in_C_avg_all(site_marks, vbonds, hbonds, M, N,
+						cluster_sizes)
+					: A_in_C(site_marks, vbonds, hbonds, M, N, p, A1,
+						cluster_sizes);
+			else if (strcmp(cmd, "PU2inC") == 0)
+				value = avg_all
+					? A1_or_A2_in_C_avg_all(site_marks, vbonds, hbonds, M, N,
+						cluster_sizes)
+					: A1_or_A2_in_C(site_marks, vbonds, hbonds, M, N, p,
+						A1, A2, cluster_sizes);
+			else
+				value = avg_all
+					? C0_size_avg_all(site_marks, vbonds, hbonds, M, N,
+						cluster_sizes)
+					: get_cluster_size(site_marks, vbonds, hbonds, M, N, A1);
+			sum  += value;
+			sum2 += value * value;
+			// The first rep warms the workspace.
+			if (rep == 0)
+				count0 = get_malloc_count();
+		}
+		seconds = get_sys_time_float() - t0;
+		allocs = (double)(get_malloc_count() - count0) / (reps - 1);
+
+		mean = sum / reps;
+		var  = (sum2 - reps * mean * mean) / (reps - 1);
+		if (var < 0.0)
+			var = 0.0;
+		var_of[avg_all] = var;
+		seconds_of[avg_all] = seconds / reps;
+		printf("M=%d N=%d p=%.4lf reps=%d %s avg=%-6s mean=%11.7lf "
+			"stderr=%11.7lf var/rep=%12.6le usec/rep=%10.3lf merit=%12.6le "
+			"allocs/rep=%.3lf\n",
+			M, N, p, reps, cmd, avg_all ? "all" : "center", mean,
+			sqrt(var / reps), var, seconds_of[avg_all] * 1e6,
+			(var > 0.0) ? 1.0 / (var * seconds_of[avg_all]) : 0.0, allocs);
+	}
+
+	if (var_of[1] > 0.0)
+		printf("variance reduction=%.3lf cost ratio=%.3lf "
+			"variance reduction per unit CPU=%.3lf\n",
+			var_of[0] / var_of[1], seconds_of[1] / seconds_of[0],
+			(var_of[0] * seconds_of[0]) / (var_of[1] * seconds_of[1]));
+}
+
+// ----------------------------------------------------------------
+// Parses a comma-separated list of numbers, each of which may instead be a
+// range "lo:hi:step" (inclusive of hi, give or take rounding), into a new
+// array.  Returns the number of values, or 0 on a syntax error.
+static int parse_number_list(char* s, double** pvalues)
+{
+	int capacity = 16;
+	int n = 0;
+	double* values = (double*)malloc_or_die(capacity * sizeof(double));
+	double lo, hi, step;
+	int k, count, nchars;
+
+	while (*s) {
+		if (sscanf(s, "%lf:%lf:%lf%n", &lo, &hi, &step, &nchars) == 3) {
+			if (step <= 0.0 || hi < lo)
+				return 0;
+			count = (int)((hi - lo) / step + 1e-9) + 1;
+		}
+		else if (sscanf(s, "%lf%n", &lo, &nchars) == 1) {
+			step  = 0.0;
+			count = 1;
+		}
+		else {
+			return 0;
+		}
+		for (k = 0; k < count; k++) {
+			if (n == capacity) {
+				capacity *= 2;
+				values = (double*)realloc(values, capacity * sizeof(double));
+				if (values == 0) {
+					fprintf(stderr, "parse_number_list:  out of memory.\n");
+					exit(1);
+				}
+			}
+			values[n++] = lo + k * step;
+		}
+		s += nchars;
+		if (*s == ',')
+			s++;
+		else if (*s)
+			return 0;
+	}
+	*pvalues = values;
+	return n;
+}
+
+// ----------------------------------------------------------------
+static void sweep_emit(sweep_point_t* ppoint, void* parg)
+{
+	estimator_args_t* pargs = (estimator_args_t*)parg;
+
+	print_estimate(stdout, pargs->cmd, ppoint->M, ppoint->N, ppoint->p,
+		ppoint->reps_done, ppoint->sum / ppoint->reps_done);
+	fflush(stdout);
+}
+
+// ----------------------------------------------------------------
+static void sweep_usage(char* argv0, char* argv1)
+{
+	fprintf(stderr, "Usage: %s %s [options]\n", argv0, argv1);
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "cmd=[...]   : PAinC (default), PU2inC, P1o2, or "
+		"meanC0size\n");
+	fprintf(stderr, "MNs=[...]   : Lattice sizes, e.g. 20,30 or 20:100:10\n");
+	fprintf(stderr, "ps=[...]    : Bond probabilities, e.g. "
+		"0.45:0.55:0.01,0.6\n");
+	fprintf(stderr, "reps=[...]  : Repetitions per point (default 10000)\n");
+	fprintf(stderr, "tries=[...] : Times to repeat each point (default 3)\n");
+	fprintf(stderr, "chunk=[...] : Repetitions per task (default 1000)\n");
+	fprintf(stderr, "workers=[...] : Worker threads (default one per CPU)\n");
+	fprintf(stderr, "avg=all     : Average over all sites as origin "
+		"(PAinC, PU2inC, meanC0size)\n");
+	exit(1);
+}
+
+// ----------------------------------------------------------------
+// Runs one estimator over a grid of lattice sizes and bond densities, in
+// parallel, with the work-stealing scheduler in perco2sweep.h.  The output is
+// in the same order as from greeks.sh:  by MN, then p, then try.  The default
+// grid is greeks.sh's.
+static void test_sweep(int argc, char** argv)
+{
+	estimator_args_t args = { "PAinC", 0 };
+	char* MNs_string = "20:100:10";
+	char* ps_string  =
+		"0.450:0.532:0.002,0.533,0.535,0.537,0.540:0.548:0.002";
+	int   reps    = 10000;
+	int   tries   = 3;
+	int   chunk   = 1000;
+	int   workers = 0;
+	double* MNs;
+	double* ps;
+	int num_MNs, num_ps, num_points;
+	sweep_point_t* points;
+	sweep_stats_t stats;
+	int argi, m, k, t, i;
+
+	for (argi = 2; argi < argc; argi++) {
+		if (strncmp(argv[argi], "cmd=", 4) == 0)
+			args.cmd = &argv[argi][4];
+		else if (strncmp(argv[argi], "MNs=", 4) == 0)
+			MNs_string = &argv[argi][4];
+		else if (strncmp(argv[argi], "ps=", 3) == 0)
+			ps_string = &argv[argi][3];
+		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
+			;
+		else if (sscanf(argv[argi], "tries=%d", &tries) == 1)
+			;
+		else if (sscanf(argv[argi], "chunk=%d", &chunk) == 1)
+			;
+		else if (sscanf(argv[argi], "workers=%d", &workers) == 1)
+			;
+		else if (parse_avg_option(argv[argi], &args.avg_all))
+			;
+		else
+			sweep_usage(argv[0], argv[1]);
+	}
+	if (strcmp(args.cmd, "PAinC") && strcmp(args.cmd, "PU2inC")
+	&& strcmp(args.cmd, "P1o2") && strcmp(args.cmd, "meanC0size")) {
+		fprintf(stderr,
+			"%s %s: cmd must be PAinC, PU2inC, P1o2, or meanC0size.\n",
+			argv[0], argv[1]);
+		exit(1);
+	}
+	num_MNs = parse_number_list(MNs_string, &MNs);
+	num_ps  = parse_number_list(ps_string,  &ps);
+	if ((num_MNs < 1) || (num_ps < 1) || (reps < 1) || (tries < 1)) {
+		fprintf(stderr, "%s %s: could not parse MNs=, ps=, reps=, or "
+			"tries=.\n", argv[0], argv[1]);
+		exit(1);
+	}
+	for (m = 0; m < num_MNs; m++)
+		if ((int)(MNs[m] + 0.5) < 3)
+			sweep_usage(argv[0], argv[1]);
+
+	num_points = num_MNs * num_ps * tries;
+	points = (sweep_point_t*)malloc_or_die(num_points *
+		sizeof(sweep_point_t));
+	for (m = 0, i = 0; m < num_MNs; m++) {
+		for (k = 0; k < num_ps; k++) {
+			for (t = 0; t < tries; t++, i++) {
+				points[i].M = points[i].N = (int)(MNs[m] + 0.5);
+				points[i].p = ps[k];
+				points[i].try_number = t;
+				points[i].reps = reps;
+			}
+		}
+	}
+
+	run_sweep(points, num_points, chunk, workers, rng_seed, 0,
+		estimate_mean, sweep_emit, &args, &stats);
+	fprintf(stderr, "sweep: points=%d tasks=%d workers=%d steals=%d "
+		"seconds=%.3lf\n", num_points, stats.num_tasks, stats.num_workers,
+		stats.steals, stats.seconds);
+
+	free(points);
+	free(MNs);
+	free(ps);
+}
+
+// ----------------------------------------------------------------
+// Lattices for the serve command, kept from one job to the next so that a
+// run of jobs at a few sizes allocates nothing after the first job at each
+// size.  When all the slots are full the least recently used is replaced.
+#define SERVE_LATTICE_SLOTS 8
+
+typedef struct _serve_lattice_t {
+	int M, N;
+	int** vbonds;
+	int** hbonds;
+	int** site_marks;
+	long long last_used;
+} serve_lattice_t;
+
+static serve_lattice_t serve_lattices[SERVE_LATTICE_SLOTS];
+static long long serve_job_count = 0;
+
+static serve_lattice_t* get_serve_lattice(int M, int N)
+{
+	serve_lattice_t* plat = &serve_lattices[0];
+	int k;
+
+	for (k = 0; k < SERVE_LATTICE_SLOTS; k++) {
+		if ((serve_lattices[k].M == M) && (serve_lattices[k].N == N)) {
+			plat = &serve_lattices[k];
+			plat->last_used = serve_job_count;
+			return plat;
+		}
+		if (serve_lattices[k].last_used < plat->last_used)
+			plat = &serve_lattices[k];
+	}
+
+	if (plat->site_marks) {
+		free_matrix(plat->vbonds,     plat->M, plat->N);
+		free_matrix(plat->hbonds,     plat->M, plat->N);
+		free_matrix(plat->site_marks, plat->M, plat->N);
+	}
+	plat->M = M;
+	plat->N = N;
+	plat->vbonds     = allocate_matrix(M, N, 0);
+	plat->hbonds     = allocate_matrix(M, N, 0);
+	plat->site_marks = allocate_matrix(M, N, SITECHAR);
+	plat->last_used  = serve_job_count;
+	return plat;
+}
+
+// ----------------------------------------------------------------
+// Runs one job line, e.g. "PAinC MN=30 p=0.5 reps=10000 seed=7 avg=all",
+// writing one line to fp:  the same as the command would print, or a line
+// starting with "error:".  A job with seed= reseeds the generator, once it is
+// known to be valid; one without continues from the previous job.  Returns 0
+// for "quit", else 1.
+static int serve_job(char* line, FILE* fp)
+{
+	estimator_args_t args = { 0, 0 };
+	int   M = 18;
+	int   N = 18;
+	double p = 0.6;
+	int   reps = 1000;
+	unsigned long long seed;
+	int have_seed = 0;
+	char* argv[32];
+	int argc = 0, argi;
+	serve_lattice_t* plat;
+	double value;
+	char* token;
+	char* save;
+
+	for (token = strtok_r(line, " \t\r\n", &save); token;
+		token = strtok_r(0, " \t\r\n", &save))
+	{
+		if (argc == 32) {
+			fprintf(fp, "error: too many arguments\n");
+			return 1;
+		}
+		argv[argc++] = token;
+	}
+	if ((argc == 0) || (argv[0][0] == '#'))
+		return 1;
+	if (strcmp(argv[0], "quit") == 0)
+		return 0;
+
+	if (strcmp(argv[0], "PAinC") && strcmp(argv[0], "PU2inC")
+	&& strcmp(argv[0], "P1o2") && strcmp(argv[0], "meanC0size")) {
+		fprintf(fp, "error: unknown command \"%s\"\n", argv[0]);
+		return 1;
+	}
+	args.cmd = argv[0];
+
+	for (argi = 1; argi < argc; argi++) {
+		if (sscanf(argv[argi], "M=%d", &M) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &N) == 1)
+			;
+		else if (sscanf(argv[argi], "MN=%d", &M) == 1)
+			N = M;
+		else if (sscanf(argv[argi], "p=%lf", &p) == 1)
+			;
+		else if (sscanf(argv[argi], "reps=%d", &reps) == 1)
+			;
+		else if (sscanf(argv[argi], "seed=%llu", &seed) == 1)
+			have_seed = 1;
+		else if (parse_avg_option(argv[argi], &args.avg_all))
+			;
+		else {
+			fprintf(fp, "error: unknown argument \"%s\"\n", argv[argi]);
+			return 1;
+		}
+	}
+	if ((M < 3) || (N < 3) || (reps < 1) || (p < 0.0) || (p > 1.0)) {
+		fprintf(fp, "error: need M, N >= 3, reps >= 1, and 0 <= p <= 1\n");
+		return 1;
+	}
+	if (!lattice_size_ok(M, N)) {
+		fprintf(fp, "error: lattice of %d by %d sites is too large\n", M, N);
+		return 1;
+	}
+
+	if (presult_cache && !have_seed && !rng_seed_given) {
+		fprintf(fp, "error: cache= needs seed=, in the job or globally\n");
+		return 1;
+	}
+
+	if (have_seed) {
+		rng_seed = seed;
+		rng_seed_given = 1;
+		SRANDOM(rng_seed);
+	}
+	serve_job_count++;
+	plat = get_serve_lattice(M, N);
+	value = run_cached_estimator(&args, plat->site_marks, plat->vbonds,
+		plat->hbonds, M, N, p, &reps);
+	print_estimate(fp, args.cmd, M, N, p, reps, value);
+	return 1;
+}
+
+// ----------------------------------------------------------------
+// Reads jobs from a stream until end of file or "quit", answering each on
+// out.  Stops early, as at end of file, if out can no longer be written, e.g.
+// because the client has gone away.  Returns 0 after "quit", else 1.
+static int serve_stream(FILE* in, FILE* out)
+{
+	char line[1024];
+
+	while (fgets(line, sizeof(line), in)) {
+		if (!serve_job(line, out))
+			return 0;
+		if ((fflush(out) != 0) || ferror(out))
+			return 1;
+	}
+	return 1;
+}
+
+// ----------------------------------------------------------------
+// Answers estimator jobs, one per line, for programs which would otherwise
+// run perco2 once per point.  The process, the generator, and the lattices
+// all stay up from one job to the next; global options such as cache= and
+// threads= apply to every job.  Jobs come from stdin, or with socket= from
+// clients of a Unix-domain socket, served one at a time.  A client which
+// disconnects early is dropped, rather than its SIGPIPE ending the server.
+static void test_serve(int argc, char** argv)
+{
+	char* socket_path = 0;
+	struct sockaddr_un addr;
+	int listen_fd, client_fd, argi;
+	FILE* in;
+	FILE* out;
+
+	for (argi = 2; argi < argc; argi++) {
+		if (strncmp(argv[argi], "socket=", 7) == 0) {
+			socket_path = &argv[argi][7];
+		}
+		else {
+			fprintf(stderr, "Usage: %s %s [socket={path}]\n",
+				argv[0], argv[1]);
+			exit(1);
+		}
+	}
+
+	if (!socket_path) {
+		serve_stream(stdin, stdout);
+		return;
+	}
+
+	if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s %s: socket path too long.\n", argv[0], argv[1]);
+		exit(1);
+	}
+	signal(SIGPIPE, SIG_IGN);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path);
+	if ((listen_fd < 0)
+	|| (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+	|| (listen(listen_fd, 8) < 0))
+	{
+		fprintf(stderr, "%s %s: couldn't listen on \"%s\".\n",
+			argv[0], argv[1], socket_path);
+		exit(1);
+	}
+
+	for (;;) {
+		client_fd = accept(listen_fd, 0, 0);
+		if (client_fd < 0)
+			continue;
+		in  = fdopen(client_fd, "r");
+		out = fdopen(dup(client_fd), "w");
+		if ((in == 0) || (out == 0)) {
+			fprintf(stderr, "%s %s: fdopen failed.\n", argv[0], argv[1]);
+			exit(1);
+		}
+		argi = serve_stream(in, out);
+		fclose(in);
+		fclose(out);
+		if (!argi)
+			break;
+	}
+	close(listen_fd);
+	unlink(socket_path);
+}
+
+// ----------------------------------------------------------------
+// State shared by the clsdist workers.  The reps are cut into chunks, which
+// the workers claim in turn; chunk k runs reps k*chunk on, seeded as
+// cache= would seed them.  Each worker keeps its own histograms, and they
+// are summed at the end, so the result does not depend on the number of
+// workers.
+typedef struct _clsdist_t {
+	int M, N;
+	double p;
+	int reps, chunk;
+	int next_chunk;
+	pthread_mutex_t mutex;
+} clsdist_t;
+
+typedef struct _clsdist_worker_t {
+	clsdist_t* pdist;
+	long long bins[CLUSTER_SIZE_BINS];
+	long long largest_bins[CLUSTER_SIZE_BINS];
+} clsdist_worker_t;
+
+static void* clsdist_worker(void* pvworker)
+{
+	clsdist_worker_t* pworker = (clsdist_worker_t*)pvworker;
+	clsdist_t* pdist = pworker->pdist;
+	int M = pdist->M;
+	int N = pdist->N;
+	int** vbonds     = allocate_matrix(M, N, 0);
+	int** hbonds     = allocate_matrix(M, N, 0);
+	int** site_marks = allocate_matrix(M, N, SITECHAR);
+	int first, reps;
+
+	for (;;) {
+		pthread_mutex_lock(&pdist->mutex);
+		first = pdist->next_chunk * pdist->chunk;
+		pdist->next_chunk++;
+		pthread_mutex_unlock(&pdist->mutex);
+		if (first >= pdist->reps)
+			break;
+		reps = pdist->reps - first;
+		if (reps > pdist->chunk)
+			reps = pdist->chunk;
+
+		SRANDOM(result_cache_run_seed(rng_seed, first));
+		get_cluster_size_histogram(site_marks, vbonds, hbonds, M, N,
+			pdist->p, reps, pworker->bins, pworker->largest_bins);
+	}
+
+	free_matrix(vbonds,     M, N);
+	free_matrix(hbonds,     M, N);
+	free_matrix(site_marks, M, N);
+	return 0;
+}
+
+// ----------------------------------------------------------------
+// Over a specified number of repetitions, accumulates the cluster-number
+// distribution n_s:  the number of clusters of size s per lattice site, in
+// log2 bins.  Prints one line per non-empty bin:  the bin's least and
+// greatest sizes, the number of clusters, and n_s averaged over the bin;
+// then the same two without the largest cluster of each realization.
+static void test_cluster_size_dist(int argc, char** argv)
+{
+	clsdist_t dist;
+	clsdist_worker_t* workers;
+	long long bins[CLUSTER_SIZE_BINS];
+	long long largest_bins[CLUSTER_SIZE_BINS];
+	int num_workers = 1;
+	int argi, w, b;
+	double per_size;
+
+	dist.M = 18;
+	dist.N = 18;
+	dist.p = 0.5;
+	dist.reps = 1000;
+	dist.chunk = 100;
+	for (argi = 2; argi < argc; argi++) {
+		if (sscanf(argv[argi], "M=%d", &dist.M) == 1)
+			;
+		else if (sscanf(argv[argi], "N=%d", &dist.N) == 1)
+			;
+		else if (sscanf(argv[argi], "MN=%d", &dist.M) == 1)
+			dist.N = dist.M;
+		else if (sscanf(argv[argi], "p=%lf", &dist.p) == 1)
+			;
+		else if (sscanf(argv[argi], "reps=%d", &dist.reps) == 1)
+			;
+		else if (sscanf(argv[argi], "chunk=%d", &dist.chunk) == 1)
+			;
+		else if (sscanf(argv[argi], "workers=%d", &num_workers) == 1)
+			;
+		else
+			usage(argv[0], argv[1], 1);
+	}
+	if ((dist.M < 3) || (dist.N < 3) || (dist.reps < 1) || (dist.chunk < 1))
+		usage(argv[0], argv[1], 1);
+	if (num_workers < 1)
+		num_workers = num_online_cpus();
+	dist.next_chunk = 0;
+	pthread_mutex_init(&dist.mutex, 0);
+
+	workers = (clsdist_worker_t*)malloc_or_die(num_workers *
+		sizeof(clsdist_worker_t));
+	for (w = 0; w < num_workers; w++) {
+		workers[w].pdist = &dist;
+		for (b = 0; b < CLUSTER_SIZE_BINS; b++)
+			workers[w].bins[b] = workers[w].largest_bins[b] = 0;
+	}
+	run_workers(num_workers, clsdist_worker, workers,
+		sizeof(clsdist_worker_t));
+
+	for (b = 0; b < CLUSTER_SIZE_BINS; b++) {
+		bins[b] = largest_bins[b] = 0;
+		for (w = 0; w < num_workers; w++) {
+			bins[b]         += workers[w].bins[b];
+			largest_bins[b] += workers[w].largest_bins[b];
+		}
+	}
+
+	printf("# M=%d N=%d p=%.4lf reps=%d\n", dist.M, dist.N, dist.p,
+		dist.reps);
+	printf("# %8s %10s %14s %14s %14s %14s\n", "s_lo", "s_hi", "clusters",
+		"n_s", "finite", "n_s_finite");
+	for (b = 0; b < CLUSTER_SIZE_BINS; b++) {
+		long long s_lo = 1LL << b;
+		long long s_hi = (1LL << (b+1)) - 1;
+		if (bins[b] == 0)
+			continue;
+		per_size = (double)dist.reps * dist.M * dist.N * (s_hi - s_lo + 1);
+		printf("  %8lld %10lld %14lld %14.7le %14lld %14.7le\n",
+			s_lo, s_hi, bins[b], bins[b] / per_size,
+			bins[b] - largest_bins[b],
+			(bins[b] - largest_bins[b]) / per_size);
+	}
+
+	pthread_mutex_destroy(&dist.mutex);
+	free(workers);
+}
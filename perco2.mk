@@ -17,48 +17,139 @@ EXTRA_DEPS =
 COMPILE_FLAGS = -c $(INCLUDE_DIRS) $(DEFINES) $(MISC_CFLAGS)
 LINK_FLAGS =  $(LIB_DIRS) $(MISC_LFLAGS)
 
-build: mk_obj_dir ./perco2
+build: mk_obj_dir ./perco2 ./libperco2.so
+
+lib: mk_obj_dir ./libperco2.so
 
 mk_obj_dir:
-	mkdir -p ./perco_objs
+	mkdir -p ./perco_objs ./perco_objs/pic
 
-./perco_objs/perco2.o:  perco2.c perco2lib.h perco2plot.h perco2print.h psdes.h putil.h rcmrand.h urandom.h
+./perco_objs/perco2.o:  fastrng.h perco2.c perco2cache.h perco2chem.h perco2ctx.h perco2engine.h perco2fixed.h perco2io.h perco2lib.h perco2mem.h perco2pad.h perco2plot.h perco2print.h perco2sweep.h perco2tile.h perco2wrap.h perco2ws.h percod.h psdes.h putil.h rcmrand.h urandom.h
 	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2.c -o ./perco_objs/perco2.o
 
-./perco_objs/perco2lib.o:  perco2lib.c perco2lib.h perco2print.h psdes.h putil.h rcmrand.h urandom.h
+./perco_objs/perco2lib.o:  fastrng.h perco2ctx.h perco2engine.h perco2fixed.h perco2lib.c perco2lib.h perco2mem.h perco2pad.h perco2print.h perco2tile.h perco2ws.h psdes.h putil.h rcmrand.h urandom.h
 	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2lib.c -o ./perco_objs/perco2lib.o
 
-./perco_objs/perco2print.o:  perco2lib.h perco2print.c perco2print.h psdes.h putil.h rcmrand.h urandom.h
+./perco_objs/perco2fixed.o:  perco2fixed.c perco2fixed.h perco2lib.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2fixed.c -o ./perco_objs/perco2fixed.o
+
+./perco_objs/perco2pad.o:  fastrng.h perco2ctx.h perco2lib.h perco2pad.c perco2pad.h perco2tile.h perco2ws.h putil.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2pad.c -o ./perco_objs/perco2pad.o
+
+./perco_objs/perco2mem.o:  perco2mem.c perco2mem.h putil.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2mem.c -o ./perco_objs/perco2mem.o
+
+./perco_objs/perco2cache.o:  perco2cache.c perco2cache.h putil.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2cache.c -o ./perco_objs/perco2cache.o
+
+./perco_objs/perco2sweep.o:  fastrng.h perco2ctx.h perco2lib.h perco2sweep.c perco2sweep.h perco2tile.h perco2ws.h psdes.h putil.h rcmrand.h urandom.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2sweep.c -o ./perco_objs/perco2sweep.o
+
+./perco_objs/perco2ctx.o:  fastrng.h perco2ctx.c perco2ctx.h perco2lib.h perco2tile.h perco2ws.h putil.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2ctx.c -o ./perco_objs/perco2ctx.o
+
+./perco_objs/perco2tile.o:  fastrng.h perco2ctx.h perco2lib.h perco2mem.h perco2tile.c perco2tile.h perco2ws.h putil.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2tile.c -o ./perco_objs/perco2tile.o
+
+./perco_objs/perco2ws.o:  fastrng.h perco2ctx.h perco2lib.h perco2mem.h perco2tile.h perco2ws.c perco2ws.h putil.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2ws.c -o ./perco_objs/perco2ws.o
+
+./perco_objs/perco2wrap.o:  fastrng.h perco2ctx.h perco2lib.h perco2tile.h perco2wrap.c perco2wrap.h perco2ws.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2wrap.c -o ./perco_objs/perco2wrap.o
+
+./perco_objs/perco2engine.o:  perco2engine.c perco2engine.h perco2fixed.h perco2lib.h perco2pad.h perco2tile.h putil.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2engine.c -o ./perco_objs/perco2engine.o
+
+./perco_objs/perco2chem.o:  fastrng.h perco2chem.c perco2chem.h perco2ctx.h perco2lib.h perco2tile.h perco2ws.h putil.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2chem.c -o ./perco_objs/perco2chem.o
+
+./perco_objs/percod.o:  fastrng.h perco2lib.h perco2mem.h percod.c percod.h percod_body.h psdes.h putil.h rcmrand.h urandom.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  percod.c -o ./perco_objs/percod.o
+
+./perco_objs/perco2print.o:  fastrng.h perco2lib.h perco2print.c perco2print.h psdes.h putil.h rcmrand.h urandom.h
 	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2print.c -o ./perco_objs/perco2print.o
 
-./perco_objs/perco2plot.o:  perco2lib.h perco2plot.c psdes.h putil.h rcmrand.h rgb_matrix.h urandom.h
+./perco_objs/perco2plot.o:  fastrng.h perco2lib.h perco2mem.h perco2plot.c psdes.h putil.h rcmrand.h rgb_matrix.h urandom.h
 	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2plot.c -o ./perco_objs/perco2plot.o
 
-./perco_objs/rgb_matrix.o:  putil.h rgb_matrix.c rgb_matrix.h
+./perco_objs/rgb_matrix.o:  perco2mem.h putil.h rgb_matrix.c rgb_matrix.h
 	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  rgb_matrix.c -o ./perco_objs/rgb_matrix.o
 
+./perco_objs/fastrng.o:  fastrng.c fastrng.h psdes.h urandom.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  fastrng.c -o ./perco_objs/fastrng.o
+
 ./perco_objs/psdes.o:  psdes.c psdes.h
 	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  psdes.c -o ./perco_objs/psdes.o
 
 ./perco_objs/urandom.o:  urandom.c urandom.h
 	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  urandom.c -o ./perco_objs/urandom.o
 
+./perco_objs/perco2io.o:  perco2io.c perco2io.h perco2lib.h putil.h
+	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  perco2io.c -o ./perco_objs/perco2io.o
+
 ./perco_objs/putil.o:  putil.c putil.h
 	gcc $(OPTCFLAGS) -Wall -Werror $(COMPILE_FLAGS)  putil.c -o ./perco_objs/putil.o
 
 OBJS = \
 	./perco_objs/perco2.o \
 	./perco_objs/perco2lib.o \
+	./perco_objs/perco2fixed.o \
+	./perco_objs/perco2pad.o \
+	./perco_objs/perco2tile.o \
+	./perco_objs/perco2ws.o \
+	./perco_objs/perco2wrap.o \
+	./perco_objs/perco2chem.o \
+	./perco_objs/perco2engine.o \
+	./perco_objs/perco2mem.o \
+	./perco_objs/perco2sweep.o \
+	./perco_objs/perco2cache.o \
+	./perco_objs/perco2ctx.o \
+	./perco_objs/percod.o \
+	./perco_objs/perco2io.o \
 	./perco_objs/perco2print.o \
 	./perco_objs/perco2plot.o \
 	./perco_objs/rgb_matrix.o \
+	./perco_objs/fastrng.o \
 	./perco_objs/psdes.o \
 	./perco_objs/urandom.o \
 	./perco_objs/putil.o
 
 ./perco2: $(OBJS) $(EXTRA_DEPS)
-	gcc $(OPTLFLAGS) -lm $(OBJS) -o ./perco2 $(LINK_FLAGS)
+	gcc $(OPTLFLAGS) $(OBJS) -o ./perco2 $(LINK_FLAGS) -lpthread -lm
+
+# The shared library has the same objects but perco2.o, plus perco2api.o,
+# compiled position-independent.  Symbols are hidden but for those marked
+# PERCO2_API in perco2api.h.
+LIB_OBJS = \
+	./perco_objs/pic/perco2api.o \
+	./perco_objs/pic/perco2lib.o \
+	./perco_objs/pic/perco2fixed.o \
+	./perco_objs/pic/perco2pad.o \
+	./perco_objs/pic/perco2tile.o \
+	./perco_objs/pic/perco2ws.o \
+	./perco_objs/pic/perco2wrap.o \
+	./perco_objs/pic/perco2chem.o \
+	./perco_objs/pic/perco2engine.o \
+	./perco_objs/pic/perco2mem.o \
+	./perco_objs/pic/perco2sweep.o \
+	./perco_objs/pic/perco2cache.o \
+	./perco_objs/pic/perco2ctx.o \
+	./perco_objs/pic/percod.o \
+	./perco_objs/pic/perco2io.o \
+	./perco_objs/pic/perco2print.o \
+	./perco_objs/pic/perco2plot.o \
+	./perco_objs/pic/rgb_matrix.o \
+	./perco_objs/pic/fastrng.o \
+	./perco_objs/pic/psdes.o \
+	./perco_objs/pic/urandom.o \
+	./perco_objs/pic/putil.o
+
+./perco_objs/pic/%.o: %.c $(wildcard *.h)
+	gcc $(OPTCFLAGS) -fPIC -fvisibility=hidden -Wall -Werror $(COMPILE_FLAGS)  $< -o $@
+
+./libperco2.so: $(LIB_OBJS) $(EXTRA_DEPS)
+	gcc $(OPTLFLAGS) -shared $(LIB_OBJS) -o ./libperco2.so $(LINK_FLAGS) -lpthread -lm
 
 clean:
-	-@rm -f $(OBJS)
-	-@rm -f ./perco2
+	-@rm -f $(OBJS) $(LIB_OBJS)
+	-@rm -f ./perco2 ./libperco2.so
@@ -0,0 +1,74 @@
+// ================================================================
+// PERCO2API.C
+// Please see the comments in perco2api.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "putil.h"
+#include "fastrng.h"
+#include "perco2lib.h"
+#include "perco2ctx.h"
+#include "perco2sweep.h"
+#include "perco2api.h"
+
+// ----------------------------------------------------------------
+static double batch_estimate(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps, void* parg)
+{
+	return perco_estimate(*(int*)parg, site_marks, vbonds, hbonds,
+		M, N, p, reps);
+}
+
+// ----------------------------------------------------------------
+int perco2_estimate_batch(int estimator, int num_points,
+	const int* M, const int* N, const double* p, const int* reps,
+	uint64_t seed, const char* rng, int bc, int num_workers, int chunk_reps,
+	double* results)
+{
+	sweep_point_t* points;
+	perco_ctx_t* ptemplate;
+	int which_rng = RCM_GEN_RAND48;
+	int k;
+
+	if ((estimator < 0) || (estimator >= PERCO_NUM_ESTS) || (num_points < 0))
+		return -1;
+	if ((bc != BC_PERIODIC) && (bc != BC_HELICAL))
+		return -1;
+	if (rng && ((which_rng = rcm_generator_by_name((char*)rng)) < 0))
+		return -1;
+	for (k = 0; k < num_points; k++)
+		if ((M[k] < 3) || (N[k] < 3) || !lattice_size_ok(M[k], N[k]) ||
+			(reps[k] < 1) || !((p[k] >= 0.0) && (p[k] <= 1.0)))
+			return -1;
+	if (num_points == 0)
+		return 0;
+
+	points = (sweep_point_t*)malloc_or_die(num_points *
+		sizeof(sweep_point_t));
+	for (k = 0; k < num_points; k++) {
+		points[k].M          = M[k];
+		points[k].N          = N[k];
+		points[k].p          = p[k];
+		points[k].try_number = 0;
+		points[k].reps       = reps[k];
+	}
+	ptemplate = perco_ctx_alloc(which_rng, 0);
+	ptemplate->bc = bc;
+
+	run_sweep(points, num_points, chunk_reps, num_workers, seed, ptemplate,
+		batch_estimate, 0, &estimator, 0);
+
+	for (k = 0; k < num_points; k++)
+		results[k] = points[k].sum / points[k].reps_done;
+
+	perco_ctx_free(ptemplate);
+	free(points);
+	return 0;
+}
+
+// ----------------------------------------------------------------
+int perco2_num_estimators(void)
+{
+	return PERCO_NUM_ESTS;
+}
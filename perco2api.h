@@ -0,0 +1,67 @@
+// ================================================================
+// PERCO2API.H
+//
+// This is the interface of libperco2.so, for running sweeps of the
+// estimators from other programs in-process, rather than running perco2 once
+// per point and parsing its output.  For example, from Python:
+//
+//   import ctypes, numpy as np
+//   lib = ctypes.CDLL("./libperco2.so")
+//   MN = np.array([20, 40], dtype=np.int32)
+//   p  = np.array([0.5, 0.5])
+//   reps = np.array([10000, 10000], dtype=np.int32)
+//   out = np.empty(2)
+//   P = ctypes.POINTER
+//   lib.perco2_estimate_batch(0, 2,
+//     MN.ctypes.data_as(P(ctypes.c_int)), MN.ctypes.data_as(P(ctypes.c_int)),
+//     p.ctypes.data_as(P(ctypes.c_double)),
+//     reps.ctypes.data_as(P(ctypes.c_int)),
+//     ctypes.c_uint64(7), b"xoshiro", 0, 0, 1000,
+//     out.ctypes.data_as(P(ctypes.c_double)))
+//
+// The points are given as parallel arrays, and the results written to an
+// array of the caller's, so that nothing need be copied or parsed.  The
+// points are run on worker threads with the work-stealing scheduler of
+// perco2sweep.h, each worker in a context of its own (perco2ctx.h), so
+// neither the process-wide settings nor other callers are affected, and
+// several batches may run at once.
+//
+// The library is built by "make lib".
+// ================================================================
+
+#ifndef PERCO2API_H
+#define PERCO2API_H
+
+#include <stdint.h>
+
+// The rest of the library is compiled with -fvisibility=hidden, so that only
+// the functions marked with this are exported from libperco2.so.
+#define PERCO2_API __attribute__((visibility("default")))
+
+// The estimator numbers are PERCO_EST_* from perco2ctx.h:
+//   0  P(A in C)                       as "perco2 PAinC"
+//   1  P(A1 in C or A2 in C)           as "perco2 PU2inC"
+//   2  P(A1 o--o A2)                   as "perco2 P1o2"
+//   3  mean size of the cluster of A   as "perco2 meanC0size"
+//   4, 5, 6  0, 1, and 3 with avg=all
+//
+// For each point k < num_points, runs reps[k] repetitions on an M[k] by N[k]
+// lattice with bond probability p[k], and writes the estimate to
+// results[k].  The generator is named as for rng= (null for rand48), and bc
+// is 0 for periodic or 1 for helical.  Each point's reps are cut into chunks
+// of chunk_reps, each seeded from seed, the point's index, and the chunk's
+// index, so the results depend on those but not on num_workers.
+// num_workers < 1 means one per online CPU.
+//
+// Returns 0 on success, or -1 if an argument is invalid, including a lattice
+// of more sites than lattice_size_ok() in perco2lib.h allows, in which case
+// nothing is run.
+PERCO2_API int perco2_estimate_batch(int estimator, int num_points,
+	const int* M, const int* N, const double* p, const int* reps,
+	uint64_t seed, const char* rng, int bc, int num_workers, int chunk_reps,
+	double* results);
+
+// The number of estimators, for checking.
+PERCO2_API int perco2_num_estimators(void);
+
+#endif // PERCO2API_H
@@ -0,0 +1,160 @@
+// ================================================================
+// PERCO2CACHE.C
+// Please see the comments in perco2cache.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "putil.h"
+#include "perco2cache.h"
+
+#define RESULT_LINE_MAX 1024
+
+// ----------------------------------------------------------------
+static void add_run(result_cache_t* pcache, char* key, int first, int reps,
+	double sum)
+{
+	result_run_t* prun;
+
+	if (pcache->num_runs == pcache->capacity) {
+		pcache->capacity = pcache->capacity ? 2 * pcache->capacity : 64;
+		pcache->runs = (result_run_t*)realloc(pcache->runs,
+			pcache->capacity * sizeof(result_run_t));
+		if (pcache->runs == 0) {
+			fprintf(stderr, "result_cache:  out of memory.\n");
+			exit(1);
+		}
+	}
+	prun = &pcache->runs[pcache->num_runs++];
+	prun->key = strdup(key);
+	prun->first = first;
+	prun->reps  = reps;
+	prun->sum   = sum;
+}
+
+// ----------------------------------------------------------------
+result_cache_t* result_cache_open(char* path)
+{
+	result_cache_t* pcache =
+		(result_cache_t*)malloc_or_die(sizeof(result_cache_t));
+	char line[RESULT_LINE_MAX];
+	char* pfirst;
+	int first, reps;
+	double sum;
+	int lineno = 0;
+	FILE* fp;
+
+	pcache->path     = strdup(path);
+	pcache->runs     = 0;
+	pcache->num_runs = 0;
+	pcache->capacity = 0;
+
+	fp = fopen(path, "r");
+	if (fp == 0) {
+		if (errno == ENOENT)
+			return pcache;
+		fprintf(stderr, "result_cache_open:  couldn't open \"%s\".\n", path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		pfirst = strstr(line, " first=");
+		if ((pfirst == 0) || (sscanf(pfirst, " first=%d reps=%d sum=%lf",
+			&first, &reps, &sum) != 3))
+		{
+			// A partial last line, from a process killed mid-write, is
+			// skipped along with anything else unparseable.
+			fprintf(stderr, "result_cache_open:  skipping line %d of "
+				"\"%s\".\n", lineno, path);
+			continue;
+		}
+		*pfirst = 0;
+		add_run(pcache, line, first, reps, sum);
+	}
+	fclose(fp);
+	return pcache;
+}
+
+// ----------------------------------------------------------------
+void result_cache_free(result_cache_t* pcache)
+{
+	int k;
+	for (k = 0; k < pcache->num_runs; k++)
+		free(pcache->runs[k].key);
+	free(pcache->runs);
+	free(pcache->path);
+	free(pcache);
+}
+
+// ----------------------------------------------------------------
+int result_cache_lookup(result_cache_t* pcache, char* key, double* psum)
+{
+	int next = 0;
+	int k, found;
+
+	*psum = 0.0;
+	do {
+		found = 0;
+		for (k = 0; k < pcache->num_runs; k++) {
+			result_run_t* prun = &pcache->runs[k];
+			if ((prun->first == next) && (prun->reps > 0)
+			&& (strcmp(prun->key, key) == 0))
+			{
+				*psum += prun->sum;
+				next  += prun->reps;
+				found = 1;
+				break;
+			}
+		}
+	} while (found);
+	return next;
+}
+
+// ----------------------------------------------------------------
+void result_cache_append(result_cache_t* pcache, char* key, int first,
+	int reps, double sum)
+{
+	char line[RESULT_LINE_MAX];
+	int len, fd;
+
+	len = snprintf(line, sizeof(line), "%s first=%d reps=%d sum=%.17g\n",
+		key, first, reps, sum);
+	if (len >= (int)sizeof(line)) {
+		fprintf(stderr, "result_cache_append:  key too long.\n");
+		exit(1);
+	}
+
+	fd = open(pcache->path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "result_cache_append:  couldn't open \"%s\".\n",
+			pcache->path);
+		exit(1);
+	}
+	if (write(fd, line, len) != len) {
+		fprintf(stderr, "result_cache_append:  couldn't write \"%s\".\n",
+			pcache->path);
+		exit(1);
+	}
+	close(fd);
+
+	add_run(pcache, key, first, reps, sum);
+}
+
+// ----------------------------------------------------------------
+// SplitMix64 of the two together, so that runs at nearby first reps get
+// unrelated streams.
+uint64_t result_cache_run_seed(uint64_t seed, int first)
+{
+	uint64_t z;
+
+	if (first == 0)
+		return seed;
+	z = seed + 0x9e3779b97f4a7c15ULL * (uint64_t)first;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
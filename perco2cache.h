@@ -0,0 +1,68 @@
+// ================================================================
+// PERCO2CACHE.H
+//
+// This is an on-disk store of estimator results, so that rerunning a sweep
+// after adding a few points, or asking for more reps at a point already run,
+// costs only the new work.
+//
+// ================================================================
+// FILE FORMAT
+//
+// A text file with one line per run of reps, shown here on two:
+//
+//   cmd=PAinC avg=center M=20 N=20 p=0.5 seed=7 rng=rand48 bc=periodic
+//     first=0 reps=10000 sum=7291
+//
+// Everything before " first=" is the key, which the caller makes up from
+// every parameter the result depends on.  first is the number of the run's
+// first rep, counting from 0 over all the runs with the same key; reps is
+// the number of reps run; sum is the sum of the per-rep values, so that the
+// mean over several runs is their total sum over their total reps.
+//
+// Lines are only ever appended, each with a single write() to a file opened
+// with O_APPEND, so that several processes may share one file.  If two of
+// them extend the same point at once, both runs are recorded with the same
+// first; the one earlier in the file is used and the other ignored.
+//
+// Reps first and on are drawn from the generator seeded with
+// result_cache_run_seed(seed, first).  For first = 0 that is the seed
+// itself, so that the first run at a point gives the same result as without
+// the cache.
+// ================================================================
+
+#ifndef PERCO2CACHE_H
+#define PERCO2CACHE_H
+
+#include <stdint.h>
+
+typedef struct _result_run_t {
+	char*  key;
+	int    first;
+	int    reps;
+	double sum;
+} result_run_t;
+
+typedef struct _result_cache_t {
+	char*         path;
+	result_run_t* runs;
+	int           num_runs;
+	int           capacity;
+} result_cache_t;
+
+// Reads all the runs in the file, which need not exist yet.
+result_cache_t* result_cache_open(char* path);
+void result_cache_free(result_cache_t* pcache);
+
+// Finds the runs for the key which follow one another from rep 0, and
+// returns their total reps, putting their total sum in *psum.  Returns 0 if
+// there are none.
+int result_cache_lookup(result_cache_t* pcache, char* key, double* psum);
+
+// Records a run, in memory and in the file.
+void result_cache_append(result_cache_t* pcache, char* key, int first,
+	int reps, double sum);
+
+// The generator seed for the reps from first on.
+uint64_t result_cache_run_seed(uint64_t seed, int first);
+
+#endif // PERCO2CACHE_H
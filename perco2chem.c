@@ -0,0 +1,205 @@
+// ================================================================
+// PERCO2CHEM.C
+// Please see the comments in perco2chem.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "putil.h"
+#include "perco2lib.h"
+#include "perco2ws.h"
+#include "perco2chem.h"
+
+// ----------------------------------------------------------------
+int chem_dist_bin(int distance)
+{
+	return (distance == 0) ? 0 : 1 + cluster_size_bin(distance);
+}
+
+// ----------------------------------------------------------------
+// The ring is full when count is one more than mask.  Growing it unrolls it,
+// so the oldest entry goes to the front.
+static void ring_grow(site_ring_t* pring)
+{
+	int capacity = pring->mask + 1;
+	int* sites = (int*)malloc_or_die(2 * capacity * sizeof(int));
+	int k;
+
+	for (k = 0; k < pring->count; k++)
+		sites[k] = pring->sites[(pring->head + k) & pring->mask];
+	free(pring->sites);
+	pring->sites = sites;
+	pring->mask  = 2 * capacity - 1;
+	pring->head  = 0;
+}
+
+static inline void ring_push(site_ring_t* pring, int site)
+{
+	if (pring->count > pring->mask)
+		ring_grow(pring);
+	pring->sites[(pring->head + pring->count) & pring->mask] = site;
+	pring->count++;
+}
+
+static inline int ring_pop(site_ring_t* pring)
+{
+	int site = pring->sites[pring->head];
+	pring->head = (pring->head + 1) & pring->mask;
+	pring->count--;
+	return site;
+}
+
+// ----------------------------------------------------------------
+// The sites bonded to site k = i*N+j, as site numbers.  Going down or up is
+// the same with either boundary condition; going right from the last column,
+// or left from the first, differs (see wrap_site() in perco2lib.c).  Bonds
+// are looked up by row and column, so either layout may be used.
+static inline int bonded_sites(int** vbonds, int** hbonds, int M, int N,
+	int helical, int k, int nbrs[4])
+{
+	int i = k / N;
+	int j = k - i*N;
+	int ui = (i > 0) ? i - 1 : M - 1;
+	int n = 0;
+
+	if (vbonds[i][j])  // Down
+		nbrs[n++] = (i+1 < M) ? k + N : j;
+	if (hbonds[i][j])  // Right
+		nbrs[n++] = (j+1 < N) ? k + 1 : (helical ? (k+1) % (M*N) : i*N);
+	if (vbonds[ui][j]) // Up
+		nbrs[n++] = ui*N + j;
+	if (j > 0) {       // Left
+		if (hbonds[i][j-1])
+			nbrs[n++] = k - 1;
+	}
+	else if (helical) {
+		if (hbonds[ui][N-1])
+			nbrs[n++] = ui*N + N-1;
+	}
+	else {
+		if (hbonds[i][N-1])
+			nbrs[n++] = i*N + N-1;
+	}
+	return n;
+}
+
+// ----------------------------------------------------------------
+// Each step expands one whole level of the side with fewer sites queued.
+// Reaching a site the other side has reached closes a path; the shortest one
+// closed on the first level where any is closed is the shortest overall.
+int chemical_distance(int** vbonds, int** hbonds, int M, int N,
+	int A1[d], int A2[d])
+{
+	perco_ws_t* pws = perco_ws_current();
+	int helical = (get_boundary_condition() == BC_HELICAL);
+	int src[2];
+	int nbrs[4];
+	int* stamp;
+	int* dist;
+	int epoch;
+	site_ring_t* pring;
+	int best = -1;
+	int s, q, level_size, x, y, dx, n, k;
+
+	src[0] = A1[0]*N + A1[1];
+	src[1] = A2[0]*N + A2[1];
+	if (src[0] == src[1])
+		return 0;
+
+	perco_ws_start_bfs(pws, M, N);
+	stamp = pws->bfs_stamp;
+	dist  = pws->bfs_dist;
+	epoch = pws->bfs_epoch;
+	for (s = 0; s < 2; s++) {
+		stamp[src[s]] = epoch + s;
+		dist[src[s]]  = 0;
+		ring_push(&pws->rings[s], src[s]);
+	}
+
+	while ((pws->rings[0].count > 0) && (pws->rings[1].count > 0)) {
+		s = (pws->rings[0].count <= pws->rings[1].count) ? 0 : 1;
+		pring = &pws->rings[s];
+		level_size = pring->count;
+		for (q = 0; q < level_size; q++) {
+			x  = ring_pop(pring);
+			dx = dist[x] + 1;
+			n  = bonded_sites(vbonds, hbonds, M, N, helical, x, nbrs);
+			for (k = 0; k < n; k++) {
+				y = nbrs[k];
+				if (stamp[y] == epoch + s)
+					continue;
+				if (stamp[y] == epoch + 1 - s) {
+					if ((best < 0) || (dx + dist[y] < best))
+						best = dx + dist[y];
+					continue;
+				}
+				stamp[y] = epoch + s;
+				dist[y]  = dx;
+				ring_push(pring, y);
+			}
+		}
+		if (best >= 0)
+			return best;
+	}
+	return -1;
+}
+
+// ----------------------------------------------------------------
+int chemical_radius(int** vbonds, int** hbonds, int M, int N, int A[d])
+{
+	perco_ws_t* pws = perco_ws_current();
+	int helical = (get_boundary_condition() == BC_HELICAL);
+	site_ring_t* pring = &pws->rings[0];
+	int nbrs[4];
+	int* stamp;
+	int* dist;
+	int epoch;
+	int radius = 0;
+	int x, y, n, k;
+
+	perco_ws_start_bfs(pws, M, N);
+	stamp = pws->bfs_stamp;
+	dist  = pws->bfs_dist;
+	epoch = pws->bfs_epoch;
+
+	x = A[0]*N + A[1];
+	stamp[x] = epoch;
+	dist[x]  = 0;
+	ring_push(pring, x);
+	while (pring->count > 0) {
+		x = ring_pop(pring);
+		radius = dist[x]; // Nondecreasing in queue order
+		n = bonded_sites(vbonds, hbonds, M, N, helical, x, nbrs);
+		for (k = 0; k < n; k++) {
+			y = nbrs[k];
+			if (stamp[y] == epoch)
+				continue;
+			stamp[y] = epoch;
+			dist[y]  = radius + 1;
+			ring_push(pring, y);
+		}
+	}
+	return radius;
+}
+
+// ----------------------------------------------------------------
+void get_chemical_distances(int** vbonds, int** hbonds, int M, int N,
+	double p, int reps, int A1[d], int A2[d],
+	long long dist_bins[CHEM_DIST_BINS], long long radius_bins[CHEM_DIST_BINS],
+	long long* pnum_connected, double* pdist_sum, double* pradius_sum)
+{
+	int rep, distance, radius;
+
+	for (rep = 0; rep < reps; rep++) {
+		populate_bonds(vbonds, hbonds, M, N, p);
+		distance = chemical_distance(vbonds, hbonds, M, N, A1, A2);
+		if (distance >= 0) {
+			(*pnum_connected)++;
+			*pdist_sum += distance;
+			dist_bins[chem_dist_bin(distance)]++;
+		}
+		radius = chemical_radius(vbonds, hbonds, M, N, A1);
+		*pradius_sum += radius;
+		radius_bins[chem_dist_bin(radius)]++;
+	}
+}
@@ -0,0 +1,52 @@
+// ================================================================
+// PERCO2CHEM.H
+//
+// Chemical distance:  the length of the shortest path along open bonds.
+// A1_oo_A2() in perco2lib.h says only whether A1 and A2 are connected; here
+// is how far apart they are when they are, and how far A's cluster extends
+// from A.
+//
+// * chemical_distance() searches breadth-first from A1 and from A2 at once,
+//   a whole level at a time from whichever side has the smaller frontier,
+//   and stops at the first level on which the two searches meet.  Nearby
+//   points in a large cluster are then found without visiting the rest of
+//   it, and when either point's cluster is finite the search ends once that
+//   cluster is used up.
+// * chemical_radius() searches breadth-first from A through its whole
+//   cluster, and returns the distance to the farthest site:  the chemical
+//   distance from A to the edge of its cluster.
+//
+// The queues are ring buffers in the workspace (perco2ws.h) which grow to
+// the largest frontier seen and are reused, as are the visit marks, which
+// are never cleared:  each search has an epoch number of its own.  So the
+// repetition loop makes no heap calls, and a search costs only the sites it
+// reaches.  Either layout and either boundary condition may be used.
+// ================================================================
+
+#ifndef PERCO2CHEM_H
+#define PERCO2CHEM_H
+
+#include "perco2lib.h"
+
+// Distances are binned as 0, 1, 2-3, 4-7, ...:  bin b > 0 holds 2^(b-1)
+// through 2^b - 1.
+#define CHEM_DIST_BINS (CLUSTER_SIZE_BINS + 1)
+int chem_dist_bin(int distance);
+
+// The chemical distance from A1 to A2, or -1 if they are not connected.
+int chemical_distance(int** vbonds, int** hbonds, int M, int N,
+	int A1[d], int A2[d]);
+
+// The greatest chemical distance from A to a site of its cluster.
+int chemical_radius(int** vbonds, int** hbonds, int M, int N, int A[d]);
+
+// Over reps realizations:  histograms of the A1-A2 distance, over the
+// realizations in which they are connected, and of A1's chemical radius,
+// over all.  The histograms are added to, and the sums of each, and the
+// number connected, are returned through the pointers.
+void get_chemical_distances(int** vbonds, int** hbonds, int M, int N,
+	double p, int reps, int A1[d], int A2[d],
+	long long dist_bins[CHEM_DIST_BINS], long long radius_bins[CHEM_DIST_BINS],
+	long long* pnum_connected, double* pdist_sum, double* pradius_sum);
+
+#endif // PERCO2CHEM_H
@@ -0,0 +1,176 @@
+// ================================================================
+// PERCO2CTX.C
+// Please see the comments in perco2ctx.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "putil.h"
+#include "perco2ctx.h"
+
+static __thread perco_ctx_t* pbound_ctx = 0;
+
+// ----------------------------------------------------------------
+perco_ctx_t* perco_ctx_alloc(int which_rng, uint64_t seed)
+{
+	perco_ctx_t* pctx = (perco_ctx_t*)malloc_or_die(sizeof(perco_ctx_t));
+
+	rcm_state_init(&pctx->rng, which_rng, seed);
+	pctx->bc               = BC_PERIODIC;
+	pctx->layout           = LAYOUT_PLAIN;
+	pctx->labeling_threads = 1;
+	pctx->pws        = perco_ws_alloc(0, 0);
+	pctx->M          = 0;
+	pctx->N          = 0;
+	pctx->vbonds     = 0;
+	pctx->hbonds     = 0;
+	pctx->site_marks = 0;
+	return pctx;
+}
+
+void perco_ctx_free(perco_ctx_t* pctx)
+{
+	perco_ws_free(pctx->pws);
+	free(pctx);
+}
+
+void perco_ctx_seed(perco_ctx_t* pctx, uint64_t seed)
+{
+	rcm_state_init(&pctx->rng, pctx->rng.which, seed);
+}
+
+// ----------------------------------------------------------------
+perco_ctx_t* perco_ctx_bind(perco_ctx_t* pctx)
+{
+	perco_ctx_t* pprev = pbound_ctx;
+	pbound_ctx = pctx;
+	rcm_use_state(pctx ? &pctx->rng : 0);
+	return pprev;
+}
+
+perco_ctx_t* perco_ctx_current(void)
+{
+	return pbound_ctx;
+}
+
+// ----------------------------------------------------------------
+// The context is bound while the lattice is laid out, so that it is in the
+// context's layout.
+void perco_ctx_size(perco_ctx_t* pctx, int M, int N)
+{
+	perco_ctx_t* pprev = perco_ctx_bind(pctx);
+
+	perco_ws_shape(pctx->pws, M, N);
+	pctx->M = M;
+	pctx->N = N;
+	pctx->vbonds     = pctx->pws->vbonds;
+	pctx->hbonds     = pctx->pws->hbonds;
+	pctx->site_marks = pctx->pws->site_marks;
+	perco_ctx_bind(pprev);
+}
+
+// ----------------------------------------------------------------
+void populate_bonds_r(perco_ctx_t* pctx, int** vbonds, int** hbonds,
+	int M, int N, double p)
+{
+	perco_ctx_t* pprev = perco_ctx_bind(pctx);
+	populate_bonds(vbonds, hbonds, M, N, p);
+	perco_ctx_bind(pprev);
+}
+
+void mark_cluster_numbers_r(perco_ctx_t* pctx, int** site_marks,
+	int** vbonds, int** hbonds, int M, int N, int* pnum_clusters)
+{
+	perco_ctx_t* pprev = perco_ctx_bind(pctx);
+	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, pnum_clusters);
+	perco_ctx_bind(pprev);
+}
+
+// ----------------------------------------------------------------
+double perco_estimate(int which, int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, double p, int reps)
+{
+	int** vb = vbonds;
+	int** hb = hbonds;
+	int** sm = site_marks;
+	int A1[d], A2[d];
+
+	set_A1_A2(A1, A2, M, N);
+	switch (which) {
+	case PERCO_EST_P_A_IN_C:
+		return P_A_in_C(sm, vb, hb, M, N, p, reps, A1);
+	case PERCO_EST_P_A1_OR_A2_IN_C:
+		return P_A1_or_A2_in_C(sm, vb, hb, M, N, p, reps, A1, A2);
+	case PERCO_EST_P_A1_OO_A2:
+		return P_A1_oo_A2(sm, vb, hb, M, N, p, reps, A1, A2);
+	case PERCO_EST_MEAN_C0_SIZE:
+		return get_mean_C0_size(sm, vb, hb, M, N, p, reps, A1);
+	case PERCO_EST_P_A_IN_C_AVG_ALL:
+		return P_A_in_C_avg_all(sm, vb, hb, M, N, p, reps);
+	case PERCO_EST_P_A1_OR_A2_IN_C_AVG_ALL:
+		return P_A1_or_A2_in_C_avg_all(sm, vb, hb, M, N, p, reps);
+	case PERCO_EST_MEAN_C0_SIZE_AVG_ALL:
+		return get_mean_C0_size_avg_all(sm, vb, hb, M, N, p, reps);
+	default:
+		fprintf(stderr, "perco_estimate:  unknown estimator %d.\n", which);
+		exit(1);
+	}
+}
+
+// The _r estimators differ only in which estimator they run.
+static double run_estimator_r(perco_ctx_t* pctx, int which, int M, int N,
+	double p, int reps)
+{
+	perco_ctx_t* pprev;
+	double value;
+
+	perco_ctx_size(pctx, M, N);
+	pprev = perco_ctx_bind(pctx);
+	value = perco_estimate(which, pctx->site_marks, pctx->vbonds,
+		pctx->hbonds, M, N, p, reps);
+	perco_ctx_bind(pprev);
+	return value;
+}
+
+// ----------------------------------------------------------------
+double P_A_in_C_r(perco_ctx_t* pctx, int M, int N, double p, int reps)
+{
+	return run_estimator_r(pctx, PERCO_EST_P_A_IN_C, M, N, p, reps);
+}
+
+double P_A1_or_A2_in_C_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps)
+{
+	return run_estimator_r(pctx, PERCO_EST_P_A1_OR_A2_IN_C, M, N, p, reps);
+}
+
+double P_A1_oo_A2_r(perco_ctx_t* pctx, int M, int N, double p, int reps)
+{
+	return run_estimator_r(pctx, PERCO_EST_P_A1_OO_A2, M, N, p, reps);
+}
+
+double get_mean_C0_size_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps)
+{
+	return run_estimator_r(pctx, PERCO_EST_MEAN_C0_SIZE, M, N, p, reps);
+}
+
+double P_A_in_C_avg_all_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps)
+{
+	return run_estimator_r(pctx, PERCO_EST_P_A_IN_C_AVG_ALL, M, N, p, reps);
+}
+
+double P_A1_or_A2_in_C_avg_all_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps)
+{
+	return run_estimator_r(pctx, PERCO_EST_P_A1_OR_A2_IN_C_AVG_ALL, M, N, p,
+		reps);
+}
+
+double get_mean_C0_size_avg_all_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps)
+{
+	return run_estimator_r(pctx, PERCO_EST_MEAN_C0_SIZE_AVG_ALL, M, N, p,
+		reps);
+}
@@ -0,0 +1,106 @@
+// ================================================================
+// PERCO2CTX.H
+//
+// These are reentrant versions of the routines in perco2lib.h, for running
+// several simulations in one process at once:  on different threads, or
+// interleaved on one thread, as when perco2 is embedded in another program.
+//
+// The routines in perco2lib.h take their random numbers from the generator
+// of rcmrand.h, and their boundary condition, storage layout, and number of
+// labeling threads from settings shared by the whole process.  A context
+// holds its own of each of these, and a lattice workspace.  Each routine
+// below binds its context to the calling thread for the duration of the
+// call, so that everything it calls in perco2lib.h -- and in perco2tile.h,
+// including the threads of the threaded labeler -- uses the context's
+// generator stream, settings, and workspace (perco2ws.h) rather than the
+// shared ones.  Two contexts may then be used at once with no locks, so long
+// as each is used by one thread at a time.
+//
+// A context's stream depends only on its generator, its seed, and the calls
+// made with it, not on which thread makes them.  With the same generator and
+// seed, a context gives the same results as the corresponding routines in
+// perco2lib.h after rcm_select_generator() and SRANDOM().
+// ================================================================
+
+#ifndef PERCO2CTX_H
+#define PERCO2CTX_H
+
+#include <stdint.h>
+#include "fastrng.h"
+#include "perco2lib.h"
+#include "perco2ws.h"
+
+typedef struct _perco_ctx_t {
+	rcm_state_t rng;
+	int bc;                // BC_PERIODIC or BC_HELICAL
+	int layout;            // LAYOUT_PLAIN or LAYOUT_PADDED
+	int labeling_threads;  // As for set_labeling_threads()
+
+	// The workspace, which is perco_ws_current() while the context is bound,
+	// and the lattice laid out in it by the routines below.
+	perco_ws_t* pws;
+	int   M, N;
+	int** vbonds;
+	int** hbonds;
+	int** site_marks;
+} perco_ctx_t;
+
+// A context with the given generator (RCM_GEN_* from fastrng.h) and seed,
+// periodic boundary conditions, the plain layout, and one labeling thread.
+perco_ctx_t* perco_ctx_alloc(int which_rng, uint64_t seed);
+void perco_ctx_free(perco_ctx_t* pctx);
+
+// Restarts the context's stream.
+void perco_ctx_seed(perco_ctx_t* pctx, uint64_t seed);
+
+// Makes the calling thread use the context, as described above, until the
+// next call; a null pctx goes back to the shared settings.  Returns the
+// previously bound context, or null.  The routines below do this themselves;
+// it is for callers who want to call routines in perco2lib.h directly.
+perco_ctx_t* perco_ctx_bind(perco_ctx_t* pctx);
+// The context bound to the calling thread, or null.
+perco_ctx_t* perco_ctx_current(void);
+
+// Makes sure the context's workspace is for an M by N lattice.  It is
+// reallocated only if it is too small.
+void perco_ctx_size(perco_ctx_t* pctx, int M, int N);
+
+// ----------------------------------------------------------------
+// As in perco2lib.h, on caller-provided matrices.
+void populate_bonds_r(perco_ctx_t* pctx, int** vbonds, int** hbonds,
+	int M, int N, double p);
+void mark_cluster_numbers_r(perco_ctx_t* pctx, int** site_marks,
+	int** vbonds, int** hbonds, int M, int N, int* pnum_clusters);
+
+// As in perco2lib.h, on the context's workspace, with the distinguished
+// points from set_A1_A2().
+double P_A_in_C_r(perco_ctx_t* pctx, int M, int N, double p, int reps);
+double P_A1_or_A2_in_C_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps);
+double P_A1_oo_A2_r(perco_ctx_t* pctx, int M, int N, double p, int reps);
+double get_mean_C0_size_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps);
+double P_A_in_C_avg_all_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps);
+double P_A1_or_A2_in_C_avg_all_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps);
+double get_mean_C0_size_avg_all_r(perco_ctx_t* pctx, int M, int N, double p,
+	int reps);
+
+// ----------------------------------------------------------------
+// The estimators above by number, for callers which choose one at run time.
+#define PERCO_EST_P_A_IN_C                0
+#define PERCO_EST_P_A1_OR_A2_IN_C         1
+#define PERCO_EST_P_A1_OO_A2              2
+#define PERCO_EST_MEAN_C0_SIZE            3
+#define PERCO_EST_P_A_IN_C_AVG_ALL        4
+#define PERCO_EST_P_A1_OR_A2_IN_C_AVG_ALL 5
+#define PERCO_EST_MEAN_C0_SIZE_AVG_ALL    6
+#define PERCO_NUM_ESTS                    7
+
+// Runs reps of estimator number which on the given matrices, in whatever
+// context is bound, and returns the estimate.
+double perco_estimate(int which, int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, double p, int reps);
+
+#endif // PERCO2CTX_H
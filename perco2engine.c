@@ -0,0 +1,486 @@
+// ================================================================
+// PERCO2ENGINE.C
+// Please see the comments in perco2engine.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "putil.h"
+#include "perco2lib.h"
+#include "perco2fixed.h"
+#include "perco2pad.h"
+#include "perco2tile.h"
+#include "perco2engine.h"
+
+#define TUNE_LINE_MAX 1024
+
+// ----------------------------------------------------------------
+// Each of the cluster-labeling routines, with the same signature.  The
+// size-specialized kernels and the power-of-two routine only apply to some
+// lattice sizes, and some routines only to one layout or boundary condition;
+// the *_ok functions say which.  The recursive depth-first search is only
+// safe on the stack for small lattices.
+
+typedef void labeler_t(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters);
+
+static void label_fixed(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters)
+{
+	fixed_mark_cluster_numbers(site_marks, vbonds, hbonds, M, N,
+		pnum_clusters);
+}
+static int all_ok(int M, int N)
+{
+	return 1;
+}
+static int dfs_ok(int M, int N)
+{
+	return (long long)M * N <= DFS_MAX_SITES;
+}
+static int fixed_ok(int M, int N)
+{
+	return have_fixed_kernel(M, N) &&
+		(get_boundary_condition() == BC_PERIODIC);
+}
+static int pow2_ok(int M, int N)
+{
+	return is_power_of_two(M) && is_power_of_two(N) &&
+		(get_lattice_layout() == LAYOUT_PLAIN) &&
+		(get_boundary_condition() == BC_PERIODIC);
+}
+static int padded_ok(int M, int N)
+{
+	return get_lattice_layout() == LAYOUT_PADDED;
+}
+static int threads_ok(int M, int N)
+{
+	return get_labeling_threads() > 1;
+}
+static int helical_ok(int M, int N)
+{
+	return (get_lattice_layout() == LAYOUT_PLAIN) &&
+		(get_boundary_condition() == BC_HELICAL);
+}
+
+static struct {
+	char*      name;
+	labeler_t* plabeler;
+	int      (*pok)(int M, int N);
+} engines[] = {
+	{ "dfs",     mark_cluster_numbers_dfs,       dfs_ok     },
+	{ "fixed",   label_fixed,                    fixed_ok   },
+	{ "pow2",    mark_cluster_numbers_pow2,      pow2_ok    },
+	{ "padded",  mark_cluster_numbers_padded,    padded_ok  },
+	{ "helical", mark_cluster_numbers_helical,   helical_ok },
+	{ "hk",      mark_cluster_numbers_hk,        all_ok     },
+	{ "tiled",   mark_cluster_numbers_tiled,     all_ok     },
+	{ "threads", mark_cluster_numbers_threaded,  threads_ok },
+};
+#define NUM_ENGINES ((int)(sizeof(engines)/sizeof(engines[0])))
+
+// ----------------------------------------------------------------
+int num_labeling_engines(void)
+{
+	return NUM_ENGINES;
+}
+
+char* labeling_engine_name(int engine)
+{
+	if (engine == ENGINE_DEFAULT)
+		return "default";
+	if (engine == ENGINE_AUTO)
+		return "auto";
+	return engines[engine].name;
+}
+
+int labeling_engine_by_name(char* name)
+{
+	int e;
+
+	if (strcmp(name, "default") == 0)
+		return ENGINE_DEFAULT;
+	if (strcmp(name, "auto") == 0)
+		return ENGINE_AUTO;
+	for (e = 0; e < NUM_ENGINES; e++)
+		if (strcmp(name, engines[e].name) == 0)
+			return e;
+	return ENGINE_UNKNOWN;
+}
+
+int labeling_engine_applies(int engine, int M, int N)
+{
+	return engines[engine].pok(M, N);
+}
+
+void run_labeling_engine(int engine, int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters)
+{
+	engines[engine].plabeler(site_marks, vbonds, hbonds, M, N,
+		pnum_clusters);
+}
+
+// ----------------------------------------------------------------
+static int labeling_engine = ENGINE_DEFAULT;
+
+void set_labeling_engine(int engine)
+{
+	labeling_engine = engine;
+}
+
+int get_labeling_engine(void)
+{
+	return labeling_engine;
+}
+
+// ================================================================
+// TUNING
+
+#define CHOICE_TUNING (-1) // Engine not yet chosen
+#define CHOICE_UNUSED 0    // Read from the file, not used in this run
+#define CHOICE_READ   1    // Read from the file, used in this run
+#define CHOICE_TIMED  2    // Timed in this run
+
+typedef struct _engine_choice_t {
+	char*  key;
+	int    engine;         // CHOICE_TUNING until chosen
+	int    how;            // CHOICE_* above
+	int    tune_reps;
+	double seconds[NUM_ENGINES];
+} engine_choice_t;
+
+// The choices, read from the file and made since, are shared by all threads
+// under the lock.
+static pthread_mutex_t  choices_lock = PTHREAD_MUTEX_INITIALIZER;
+static engine_choice_t* choices      = 0;
+static int              num_choices  = 0;
+static int              max_choices  = 0;
+static int              choices_read = 0;
+static char*            tuning_file  = DEFAULT_TUNING_FILE;
+static char             cpu_model[256] = "";
+
+// Each thread remembers its last lattice and the engine chosen for it, so
+// that the lock is taken only when the lattice changes or while tuning.
+typedef struct _engine_params_t {
+	int M, N, p100, layout, bc, threads;
+} engine_params_t;
+
+static __thread engine_params_t last_params;
+static __thread int             last_engine = CHOICE_TUNING;
+
+// ----------------------------------------------------------------
+void set_tuning_file(char* path)
+{
+	tuning_file = path;
+}
+
+// ----------------------------------------------------------------
+// The "model name" line of /proc/cpuinfo, with blanks made underscores so
+// that the key stays one word per field.
+static void read_cpu_model(void)
+{
+	char line[TUNE_LINE_MAX];
+	char* pvalue;
+	char* pc;
+	FILE* fp = fopen("/proc/cpuinfo", "r");
+
+	strcpy(cpu_model, "unknown");
+	if (fp == 0)
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, "model name", 10) != 0)
+			continue;
+		pvalue = strchr(line, ':');
+		if (pvalue == 0)
+			break;
+		pvalue++;
+		while (*pvalue == ' ' || *pvalue == '\t')
+			pvalue++;
+		pvalue[strcspn(pvalue, "\n")] = 0;
+		if (*pvalue == 0)
+			break;
+		snprintf(cpu_model, sizeof(cpu_model), "%s", pvalue);
+		for (pc = cpu_model; *pc; pc++)
+			if ((*pc == ' ') || (*pc == '\t') || (*pc == '='))
+				*pc = '_';
+		break;
+	}
+	fclose(fp);
+}
+
+// ----------------------------------------------------------------
+static void add_choice(char* key, int engine, int how)
+{
+	engine_choice_t* pchoice;
+	int e;
+
+	if (num_choices == max_choices) {
+		max_choices = max_choices ? 2 * max_choices : 16;
+		choices = (engine_choice_t*)realloc(choices,
+			max_choices * sizeof(engine_choice_t));
+		if (choices == 0) {
+			fprintf(stderr, "engine tuning:  out of memory.\n");
+			exit(1);
+		}
+	}
+	pchoice = &choices[num_choices++];
+	pchoice->key       = strdup(key);
+	pchoice->engine    = engine;
+	pchoice->how       = how;
+	pchoice->tune_reps = 0;
+	for (e = 0; e < NUM_ENGINES; e++)
+		pchoice->seconds[e] = 0.0;
+}
+
+// ----------------------------------------------------------------
+// Lines naming an engine this build does not have are skipped, so that the
+// key is tuned again.
+static void read_tuning_file(void)
+{
+	char line[TUNE_LINE_MAX];
+	char* pengine;
+	int lineno = 0;
+	int engine;
+	FILE* fp;
+
+	read_cpu_model();
+	choices_read = 1;
+
+	fp = fopen(tuning_file, "r");
+	if (fp == 0) {
+		if (errno == ENOENT)
+			return;
+		fprintf(stderr, "engine tuning:  couldn't open \"%s\".\n",
+			tuning_file);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		line[strcspn(line, "\n")] = 0;
+		pengine = strstr(line, " engine=");
+		engine = pengine ? labeling_engine_by_name(pengine + 8)
+			: ENGINE_UNKNOWN;
+		if (engine < 0) {
+			fprintf(stderr, "engine tuning:  skipping line %d of \"%s\".\n",
+				lineno, tuning_file);
+			continue;
+		}
+		*pengine = 0;
+		add_choice(line, engine, CHOICE_UNUSED);
+	}
+	fclose(fp);
+}
+
+// ----------------------------------------------------------------
+static void append_tuning_file(engine_choice_t* pchoice)
+{
+	char line[TUNE_LINE_MAX];
+	int len, fd;
+
+	len = snprintf(line, sizeof(line), "%s engine=%s\n", pchoice->key,
+		engines[pchoice->engine].name);
+	fd = open(tuning_file, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "engine tuning:  couldn't open \"%s\".\n",
+			tuning_file);
+		exit(1);
+	}
+	if (write(fd, line, len) != len) {
+		fprintf(stderr, "engine tuning:  couldn't write \"%s\".\n",
+			tuning_file);
+		exit(1);
+	}
+	close(fd);
+}
+
+// ----------------------------------------------------------------
+// Called with the lock held.  Returns an index rather than a pointer, since
+// another thread may add a choice, and move the array, while this one tunes.
+// The first line for a key wins.
+static int find_choice(engine_params_t* pparams)
+{
+	char key[TUNE_LINE_MAX];
+	int k;
+
+	if (!choices_read)
+		read_tuning_file();
+
+	snprintf(key, sizeof(key),
+		"cpu=%s M=%d N=%d p=%d.%02d layout=%s bc=%s threads=%d",
+		cpu_model, pparams->M, pparams->N,
+		pparams->p100 / 100, pparams->p100 % 100,
+		(pparams->layout == LAYOUT_PADDED) ? "padded" : "plain",
+		(pparams->bc == BC_HELICAL) ? "helical" : "periodic",
+		pparams->threads);
+	for (k = 0; k < num_choices; k++)
+		if (strcmp(choices[k].key, key) == 0)
+			return k;
+	add_choice(key, CHOICE_TUNING, CHOICE_TIMED);
+	return num_choices - 1;
+}
+
+// ----------------------------------------------------------------
+// Tuning goes on until every engine has been timed on TUNE_REPS
+// realizations, and for at least TUNE_SECONDS in all so that the timer's
+// resolution does not decide small lattices, or for TUNE_MAX_REPS.
+#define TUNE_SECONDS  0.002
+#define TUNE_MAX_REPS 1000
+
+static int tuning_done(engine_choice_t* pchoice, int M, int N)
+{
+	int e;
+
+	if (pchoice->tune_reps < TUNE_REPS)
+		return 0;
+	if (pchoice->tune_reps >= TUNE_MAX_REPS)
+		return 1;
+	for (e = 0; e < NUM_ENGINES; e++)
+		if (engines[e].pok(M, N) && (pchoice->seconds[e] < TUNE_SECONDS))
+			return 0;
+	return 1;
+}
+
+// ----------------------------------------------------------------
+// Labels the lattice with each engine in turn, starting from a different one
+// each time so that none always has the others' cache leftovers.  Called,
+// and returns, with the lock held, but releases it while timing.
+static void tune(int which, int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters)
+{
+	engine_choice_t* pchoice;
+	double seconds[NUM_ENGINES];
+	int start = choices[which].tune_reps;
+	int best = -1;
+	int k, e;
+	double t0;
+
+	pthread_mutex_unlock(&choices_lock);
+	for (k = 0; k < NUM_ENGINES; k++) {
+		e = (start + k) % NUM_ENGINES;
+		seconds[e] = 0.0;
+		if (!engines[e].pok(M, N))
+			continue;
+		t0 = get_sys_time_float();
+		engines[e].plabeler(site_marks, vbonds, hbonds, M, N,
+			pnum_clusters);
+		seconds[e] = get_sys_time_float() - t0;
+	}
+	pthread_mutex_lock(&choices_lock);
+
+	pchoice = &choices[which];
+	if (pchoice->engine != CHOICE_TUNING) // Another thread finished first
+		return;
+	for (e = 0; e < NUM_ENGINES; e++)
+		pchoice->seconds[e] += seconds[e];
+	pchoice->tune_reps++;
+	if (!tuning_done(pchoice, M, N))
+		return;
+
+	for (e = 0; e < NUM_ENGINES; e++) {
+		if (!engines[e].pok(M, N))
+			continue;
+		if ((best < 0) || (pchoice->seconds[e] < pchoice->seconds[best]))
+			best = e;
+	}
+	pchoice->engine = best;
+	append_tuning_file(pchoice);
+}
+
+// ----------------------------------------------------------------
+// The p is that of the last populate_bonds() on this thread.  A lattice
+// loaded from a file has none, and its density of open bonds stands in.
+static double current_p(int** vbonds, int** hbonds, int M, int N)
+{
+	double p = get_realization_p();
+	int i, j;
+	long long num_open = 0;
+
+	if (p >= 0.0)
+		return p;
+	for (i = 0; i < M; i++)
+		for (j = 0; j < N; j++)
+			num_open += vbonds[i][j] + hbonds[i][j];
+	return (double)num_open / (2.0 * M * N);
+}
+
+// Returns the engine to use, or CHOICE_TUNING if the lattice has been
+// labeled already, while tuning.
+static int auto_engine(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters)
+{
+	engine_params_t params;
+	int which, engine;
+	int labeled = 0;
+
+	params.M       = M;
+	params.N       = N;
+	params.p100    = (int)(100.0 * current_p(vbonds, hbonds, M, N) + 0.5);
+	params.layout  = get_lattice_layout();
+	params.bc      = get_boundary_condition();
+	params.threads = get_labeling_threads();
+	if ((last_engine >= 0) &&
+		(memcmp(&params, &last_params, sizeof(params)) == 0))
+		return last_engine;
+
+	pthread_mutex_lock(&choices_lock);
+	which = find_choice(&params);
+	if (choices[which].engine == CHOICE_TUNING) {
+		tune(which, site_marks, vbonds, hbonds, M, N, pnum_clusters);
+		labeled = 1;
+	}
+	else if (choices[which].how == CHOICE_UNUSED) {
+		choices[which].how = CHOICE_READ;
+	}
+	engine = choices[which].engine;
+	pthread_mutex_unlock(&choices_lock);
+
+	last_params = params;
+	last_engine = engine;
+	return labeled ? CHOICE_TUNING : engine;
+}
+
+// ----------------------------------------------------------------
+int mark_cluster_numbers_by_engine(int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters)
+{
+	int engine = labeling_engine;
+
+	if (engine == ENGINE_DEFAULT)
+		return 0;
+	if (engine == ENGINE_AUTO) {
+		engine = auto_engine(site_marks, vbonds, hbonds, M, N,
+			pnum_clusters);
+		if (engine == CHOICE_TUNING)
+			return 1;
+	}
+	if (!engines[engine].pok(M, N))
+		return 0;
+	engines[engine].plabeler(site_marks, vbonds, hbonds, M, N,
+		pnum_clusters);
+	return 1;
+}
+
+// ----------------------------------------------------------------
+void print_engine_choices(FILE* fp)
+{
+	int k;
+
+	pthread_mutex_lock(&choices_lock);
+	for (k = 0; k < num_choices; k++) {
+		if (choices[k].how == CHOICE_UNUSED)
+			continue;
+		if (choices[k].engine == CHOICE_TUNING)
+			fprintf(fp, "%s engine=(tuning unfinished after %d reps)\n",
+				choices[k].key, choices[k].tune_reps);
+		else
+			fprintf(fp, "%s engine=%s (%s)\n", choices[k].key,
+				engines[choices[k].engine].name,
+				(choices[k].how == CHOICE_TIMED) ? "timed" : "from file");
+	}
+	pthread_mutex_unlock(&choices_lock);
+}
@@ -0,0 +1,85 @@
+// ================================================================
+// PERCO2ENGINE.H
+//
+// The cluster-labeling routines as a table of engines, so that one may be
+// chosen by name, and engine=auto, which chooses one by timing them.
+//
+// mark_cluster_numbers() in perco2lib.h picks its labeler by a fixed rule of
+// lattice size, layout, and boundary condition.  Which is fastest also
+// depends on p and on the machine:  below p_c the clusters are small and the
+// depth-first search stays in cache, while above it the one big cluster
+// favors the raster scans.  So with set_labeling_engine() given an engine
+// number, mark_cluster_numbers() uses that engine wherever it applies; given
+// ENGINE_AUTO, it tunes.
+//
+// TUNING
+//
+// The first realizations seen for a given lattice size, p (to two places),
+// layout, boundary condition, and number of labeling threads are labeled by
+// every engine which applies, in turn, each timed:  at least TUNE_REPS of
+// them, and more for small lattices, until each engine's times add up to
+// enough for the timer to resolve.  All engines give the same cluster
+// numbers, so this costs time but not results, and no extra random numbers
+// are drawn.  The fastest is then used for the rest of the run, and is
+// recorded in the tuning file, one line per choice:
+//
+//   cpu=Intel(R)_Xeon(R)_CPU_E5-2680 M=64 N=64 p=0.50 layout=plain bc=periodic threads=1 engine=pow2
+//
+// Everything before " engine=" is the key.  The CPU model, from
+// /proc/cpuinfo, is part of it, so that one file may be shared by several
+// machines.  A later run finding its key in the file uses that engine
+// without timing.  Lines are appended with a single write() to a file opened
+// with O_APPEND, as in perco2cache.h; if two processes tune the same key at
+// once, the earlier line wins.
+//
+// The engine setting is shared by the whole process, including contexts
+// (perco2ctx.h), as is the table of choices, which is safe to use from
+// several threads.
+// ================================================================
+
+#ifndef PERCO2ENGINE_H
+#define PERCO2ENGINE_H
+
+#include <stdio.h>
+
+#define ENGINE_DEFAULT (-1) // mark_cluster_numbers()'s own rule
+#define ENGINE_AUTO    (-2) // Chosen by timing, as above
+#define ENGINE_UNKNOWN (-3) // From labeling_engine_by_name() only
+
+#define TUNE_REPS 5
+#define DEFAULT_TUNING_FILE "perco2.tune"
+
+// Engines are numbered from 0.  labeling_engine_by_name() also knows
+// "default" and "auto".
+int   num_labeling_engines(void);
+char* labeling_engine_name(int engine);
+int   labeling_engine_by_name(char* name);
+
+// Whether the engine can label an M by N lattice with the current layout,
+// boundary condition, and number of labeling threads.
+int labeling_engine_applies(int engine, int M, int N);
+
+// Labels the lattice as mark_cluster_numbers() does, with the given engine,
+// which must apply.
+void run_labeling_engine(int engine, int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters);
+
+// ENGINE_DEFAULT, ENGINE_AUTO, or an engine number.
+void set_labeling_engine(int engine);
+int  get_labeling_engine(void);
+
+// The tuning file for ENGINE_AUTO, which need not exist yet.  It is read on
+// first use.  The default is DEFAULT_TUNING_FILE in the current directory.
+void set_tuning_file(char* path);
+
+// For mark_cluster_numbers():  labels the lattice with the engine chosen by
+// get_labeling_engine(), returning 1, or returns 0 if that is ENGINE_DEFAULT
+// or does not apply.
+int mark_cluster_numbers_by_engine(int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters);
+
+// Prints one line per ENGINE_AUTO choice used so far in this run, as in the
+// tuning file, saying whether it was timed or read from the file.
+void print_engine_choices(FILE* fp);
+
+#endif // PERCO2ENGINE_H
@@ -0,0 +1,267 @@
+// ================================================================
+// PERCO2FIXED.C
+// Please see the comments in perco2fixed.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "perco2lib.h"
+#include "perco2fixed.h"
+
+// Each kernel below is written once, with MN as an ordinary argument, and
+// forced inline into one wrapper function per lattice size.  Inside each
+// wrapper MN is a constant, so the compiler sees fixed loop bounds, constant
+// neighbor offsets, and fixed-size stack arrays.
+#define FIXED_INLINE static inline __attribute__((always_inline))
+
+// ----------------------------------------------------------------
+// Copies the int** bond matrices into flat byte arrays.
+FIXED_INLINE void fixed_copy_bonds(int MN, int** vbonds, int** hbonds,
+	unsigned char* vb, unsigned char* hb)
+{
+	int i, j;
+	for (i = 0; i < MN; i++) {
+		for (j = 0; j < MN; j++) {
+			vb[i*MN+j] = vbonds[i][j];
+			hb[i*MN+j] = hbonds[i][j];
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+// Union-find with the smaller site index always as the root.  Thus each
+// cluster's root is its first site in row-major order, and parent[k] <= k for
+// all k.
+FIXED_INLINE int fixed_find(int* parent, int k)
+{
+	while (parent[k] != k) {
+		parent[k] = parent[parent[k]];
+		k = parent[k];
+	}
+	return k;
+}
+
+FIXED_INLINE void fixed_union(int* parent, int a, int b)
+{
+	a = fixed_find(parent, a);
+	b = fixed_find(parent, b);
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+}
+
+// ----------------------------------------------------------------
+// Labels all clusters, writing cluster numbers to labels[] and returning the
+// number of clusters.  Clusters are numbered in order of their first site,
+// which is the order in which mark_cluster_numbers() numbers them.
+FIXED_INLINE int fixed_label(int MN, unsigned char* vb, unsigned char* hb,
+	int* parent, int* labels)
+{
+	int i, j, k, r;
+	int num_clusters = 0;
+
+	for (k = 0; k < MN*MN; k++)
+		parent[k] = k;
+
+	for (i = 0; i < MN-1; i++) {
+		// Interior:  no bond wraps around.
+		for (j = 0; j < MN-1; j++) {
+			k = i*MN + j;
+			if (hb[k])
+				fixed_union(parent, k, k+1);
+			if (vb[k])
+				fixed_union(parent, k, k+MN);
+		}
+		// Last column:  the right bond wraps to column 0.
+		k = i*MN + MN-1;
+		if (hb[k])
+			fixed_union(parent, k, i*MN);
+		if (vb[k])
+			fixed_union(parent, k, k+MN);
+	}
+
+	// Last row:  the down bond wraps to row 0.
+	for (j = 0; j < MN-1; j++) {
+		k = (MN-1)*MN + j;
+		if (hb[k])
+			fixed_union(parent, k, k+1);
+		if (vb[k])
+			fixed_union(parent, k, j);
+	}
+	// Bottom-right corner:  both bonds wrap.
+	k = MN*MN - 1;
+	if (hb[k])
+		fixed_union(parent, k, (MN-1)*MN);
+	if (vb[k])
+		fixed_union(parent, k, MN-1);
+
+	// Since parent[k] <= k, by the time we reach k its parent has already
+	// been pointed directly at the root.  So one pass suffices both to
+	// flatten the trees and to number the roots.
+	for (k = 0; k < MN*MN; k++) {
+		r = parent[parent[k]];
+		parent[k] = r;
+		labels[k] = (r == k) ? num_clusters++ : labels[r];
+	}
+	return num_clusters;
+}
+
+// ----------------------------------------------------------------
+// This visits sites in exactly the order that the recursive A1_oo_A2_aux() in
+// perco2lib.c does:  each stack frame holds a site and the next of its four
+// directions (down, right, up, left) to try.  Thus the set of visited sites on
+// return, and not just the yes/no answer, matches the generic routine.
+FIXED_INLINE int fixed_dfs(int MN, unsigned char* vb, unsigned char* hb,
+	unsigned char* visited, int* frame_sites, unsigned char* frame_dirs,
+	int x, int y)
+{
+	int sp = 0;
+
+	if (x == y)
+		return 1;
+	visited[x] = 1;
+	frame_sites[sp] = x;
+	frame_dirs[sp] = 0;
+	sp++;
+
+	while (sp > 0) {
+		int k   = frame_sites[sp-1];
+		int dir = frame_dirs[sp-1];
+		int j   = k % MN;
+		int nbr = -1;
+
+		if (dir >= 4) {
+			sp--;
+			continue;
+		}
+		frame_dirs[sp-1] = dir + 1;
+
+		switch (dir) {
+		case 0: // Down
+			if (vb[k])
+				nbr = (k >= MN*MN-MN) ? k+MN-MN*MN : k+MN;
+			break;
+		case 1: // Right
+			if (hb[k])
+				nbr = (j == MN-1) ? k-(MN-1) : k+1;
+			break;
+		case 2: // Up
+			nbr = (k < MN) ? k-MN+MN*MN : k-MN;
+			if (!vb[nbr])
+				nbr = -1;
+			break;
+		case 3: // Left
+			nbr = (j == 0) ? k+(MN-1) : k-1;
+			if (!hb[nbr])
+				nbr = -1;
+			break;
+		}
+
+		if ((nbr < 0) || visited[nbr])
+			continue;
+		if (nbr == y)
+			return 1;
+		visited[nbr] = 1;
+		frame_sites[sp] = nbr;
+		frame_dirs[sp] = 0;
+		sp++;
+	}
+	return 0;
+}
+
+// ----------------------------------------------------------------
+// One labeling wrapper and one connectivity wrapper per lattice size.  The
+// stack arrays are sized by the constant MN.
+
+#define DEFINE_FIXED_KERNELS(MN) \
+static int fixed_mark_cluster_numbers_##MN(int** site_marks, \
+	int** vbonds, int** hbonds) \
+{ \
+	unsigned char vb[MN*MN], hb[MN*MN]; \
+	int parent[MN*MN], labels[MN*MN]; \
+	int i, num_clusters; \
+	fixed_copy_bonds(MN, vbonds, hbonds, vb, hb); \
+	num_clusters = fixed_label(MN, vb, hb, parent, labels); \
+	for (i = 0; i < MN; i++) \
+		memcpy(site_marks[i], &labels[i*MN], MN*sizeof(int)); \
+	return num_clusters; \
+} \
+static int fixed_A1_oo_A2_##MN(int** site_marks, \
+	int** vbonds, int** hbonds, int x, int y) \
+{ \
+	unsigned char vb[MN*MN], hb[MN*MN], visited[MN*MN]; \
+	unsigned char frame_dirs[MN*MN]; \
+	int frame_sites[MN*MN]; \
+	int i, j, ctd; \
+	fixed_copy_bonds(MN, vbonds, hbonds, vb, hb); \
+	memset(visited, 0, sizeof(visited)); \
+	ctd = fixed_dfs(MN, vb, hb, visited, frame_sites, frame_dirs, x, y); \
+	for (i = 0; i < MN; i++) \
+		for (j = 0; j < MN; j++) \
+			site_marks[i][j] = visited[i*MN+j] ? VISITEDCHAR : SITECHAR; \
+	return ctd; \
+}
+
+PERCO2_FIXED_SIZES(DEFINE_FIXED_KERNELS)
+
+// ================================================================
+// Runtime dispatch on the lattice size.
+
+#define FIXED_HAVE_CASE(MN) case MN:
+
+int have_fixed_kernel(int M, int N)
+{
+	if (M != N)
+		return 0;
+	switch (M) {
+	PERCO2_FIXED_SIZES(FIXED_HAVE_CASE)
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+// ----------------------------------------------------------------
+#define FIXED_LABEL_CASE(MN) \
+	case MN: \
+		num_clusters = fixed_mark_cluster_numbers_##MN(site_marks, \
+			vbonds, hbonds); \
+		break;
+
+int fixed_mark_cluster_numbers(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters)
+{
+	int num_clusters;
+	if (M != N)
+		return 0;
+	switch (M) {
+	PERCO2_FIXED_SIZES(FIXED_LABEL_CASE)
+	default:
+		return 0;
+	}
+	if (pnum_clusters)
+		*pnum_clusters = num_clusters;
+	return 1;
+}
+
+// ----------------------------------------------------------------
+#define FIXED_CTD_CASE(MN) \
+	case MN: \
+		*pctd = fixed_A1_oo_A2_##MN(site_marks, vbonds, hbonds, \
+			A1[0]*MN + A1[1], A2[0]*MN + A2[1]); \
+		break;
+
+int fixed_A1_oo_A2(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d], int* pctd)
+{
+	if (M != N)
+		return 0;
+	switch (M) {
+	PERCO2_FIXED_SIZES(FIXED_CTD_CASE)
+	default:
+		return 0;
+	}
+	return 1;
+}
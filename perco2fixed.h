@@ -0,0 +1,51 @@
+// ================================================================
+// PERCO2FIXED.H
+//
+// These are versions of mark_cluster_numbers() and A1_oo_A2() from
+// perco2lib.h which are specialized at compile time for particular square
+// lattice sizes M = N = MN.  With MN a constant:
+//
+// * The lattice is copied into fixed-size arrays on the stack, indexed flat as
+//   k = i*MN + j, so each neighbor is a constant offset away.
+// * The periodic wraparound is peeled out of the inner loops:  the interior
+//   of the lattice is scanned with no boundary checks at all, and the last
+//   column and last row (whose bonds wrap around the torus) each get their own
+//   loop.
+//
+// The results are identical to those of the generic routines:  the same
+// cluster numbers, and the same visited marks from A1_oo_A2().
+//
+// mark_cluster_numbers() and A1_oo_A2() in perco2lib.c call these routines
+// first; for any other lattice size, these return 0 and the generic routines
+// do the work.
+// ================================================================
+
+#ifndef PERCO2FIXED_H
+#define PERCO2FIXED_H
+
+#include "perco2lib.h"
+
+// ================================================================
+// Here is where one specifies the lattice sizes to specialize.  The default
+// list is the MNs from greeks.sh.  Each size costs a few kilobytes of code,
+// and up to about 10*MN*MN bytes of stack per call.
+#define PERCO2_FIXED_SIZES(X) \
+	X(20) X(30) X(40) X(50) X(60) X(70) X(80) X(90) X(100)
+
+// ----------------------------------------------------------------
+// Returns 1 if there is a specialized kernel for an MxN lattice, else 0.
+int have_fixed_kernel(int M, int N);
+
+// If there is a specialized kernel for an MxN lattice, does the same as
+// mark_cluster_numbers() and returns 1.  Otherwise returns 0 without doing
+// anything.
+int fixed_mark_cluster_numbers(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters);
+
+// If there is a specialized kernel for an MxN lattice, does the same as
+// A1_oo_A2(), writing the result to *pctd, and returns 1.  Otherwise returns 0
+// without doing anything.
+int fixed_A1_oo_A2(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d], int* pctd);
+
+#endif // PERCO2FIXED_H
@@ -0,0 +1,210 @@
+// ================================================================
+// PERCO2IO.C
+// Please see the comments in perco2io.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "putil.h"
+#include "perco2lib.h"
+#include "perco2io.h"
+
+// ----------------------------------------------------------------
+// Bytes for M*N bits, rounded up to a multiple of 8.
+static size_t bit_plane_bytes(int M, int N)
+{
+	size_t nbits = (size_t)M * N;
+	return ((nbits + 63) / 64) * 8;
+}
+
+// ----------------------------------------------------------------
+static void pack_bits(int** matrix, int M, int N, unsigned char* bits)
+{
+	size_t k = 0;
+	int i, j;
+
+	memset(bits, 0, bit_plane_bytes(M, N));
+	for (i = 0; i < M; i++)
+		for (j = 0; j < N; j++, k++)
+			if (matrix[i][j])
+				bits[k >> 3] |= 1 << (k & 7);
+}
+
+// ----------------------------------------------------------------
+static void write_or_die(FILE* fp, void* data, size_t nbytes,
+	char* file_name)
+{
+	if (fwrite(data, 1, nbytes, fp) != nbytes) {
+		fprintf(stderr, "Couldn't write \"%s\".\n", file_name);
+		exit(1);
+	}
+}
+
+// ----------------------------------------------------------------
+void save_lattice_file(char* file_name, int** vbonds, int** hbonds,
+	int** site_marks, int M, int N, double p,
+	unsigned long long seed, unsigned long long rep)
+{
+	perco2_file_header_t header;
+	size_t nbytes = bit_plane_bytes(M, N);
+	unsigned char* bits = (unsigned char*)malloc_or_die(nbytes);
+	FILE* fp = fopen(file_name, "wb");
+	int num_clusters = 0;
+	int i, j;
+
+	if (fp == 0) {
+		fprintf(stderr, "Couldn't open \"%s\" for write.\n", file_name);
+		exit(1);
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic   = PERCO2_FILE_MAGIC;
+	header.version = PERCO2_FILE_VERSION;
+	header.flags   = 0;
+	if (site_marks)
+		header.flags |= PERCO2_FILE_HAS_LABELS;
+	if (get_boundary_condition() == BC_HELICAL)
+		header.flags |= PERCO2_FILE_HELICAL;
+	header.M    = M;
+	header.N    = N;
+	header.p    = p;
+	header.seed = seed;
+	header.rep  = rep;
+	if (site_marks)
+		for (i = 0; i < M; i++)
+			for (j = 0; j < N; j++)
+				if (site_marks[i][j] >= num_clusters)
+					num_clusters = site_marks[i][j] + 1;
+	header.num_clusters = num_clusters;
+	write_or_die(fp, &header, sizeof(header), file_name);
+
+	pack_bits(vbonds, M, N, bits);
+	write_or_die(fp, bits, nbytes, file_name);
+	pack_bits(hbonds, M, N, bits);
+	write_or_die(fp, bits, nbytes, file_name);
+
+	// Matrix rows are not contiguous in the padded layout, so write a row
+	// at a time.
+	if (site_marks) {
+		for (i = 0; i < M; i++) {
+			if (sizeof(int) == sizeof(int32_t)) {
+				write_or_die(fp, site_marks[i], N * sizeof(int32_t),
+					file_name);
+			}
+			else {
+				for (j = 0; j < N; j++) {
+					int32_t label = site_marks[i][j];
+					write_or_die(fp, &label, sizeof(label), file_name);
+				}
+			}
+		}
+	}
+
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "Couldn't close \"%s\".\n", file_name);
+		exit(1);
+	}
+	free(bits);
+}
+
+// ----------------------------------------------------------------
+perco2_mapped_file_t* map_lattice_file(char* file_name)
+{
+	perco2_mapped_file_t* pmap;
+	perco2_file_header_t* pheader;
+	struct stat statbuf;
+	size_t nbytes, expected;
+	unsigned char* base;
+	int fd;
+
+	fd = open(file_name, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Couldn't open \"%s\" for read.\n", file_name);
+		exit(1);
+	}
+	if (fstat(fd, &statbuf) != 0) {
+		fprintf(stderr, "Couldn't stat \"%s\".\n", file_name);
+		exit(1);
+	}
+	if (statbuf.st_size < sizeof(perco2_file_header_t)) {
+		fprintf(stderr, "\"%s\" is too short to be a lattice file.\n",
+			file_name);
+		exit(1);
+	}
+	base = (unsigned char*)mmap(0, statbuf.st_size, PROT_READ, MAP_PRIVATE,
+		fd, 0);
+	if (base == (unsigned char*)MAP_FAILED) {
+		fprintf(stderr, "Couldn't mmap \"%s\".\n", file_name);
+		exit(1);
+	}
+	close(fd);
+
+	pheader = (perco2_file_header_t*)base;
+	if (pheader->magic != PERCO2_FILE_MAGIC) {
+		fprintf(stderr, "\"%s\" is not a lattice file, or is from a machine "
+			"with different byte order.\n", file_name);
+		exit(1);
+	}
+	if (pheader->version != PERCO2_FILE_VERSION) {
+		fprintf(stderr, "\"%s\" has version %u; expected %d.\n",
+			file_name, (unsigned)pheader->version, PERCO2_FILE_VERSION);
+		exit(1);
+	}
+	if ((pheader->M < 1) || (pheader->N < 1)) {
+		fprintf(stderr, "\"%s\" has bad dimensions %d x %d.\n",
+			file_name, (int)pheader->M, (int)pheader->N);
+		exit(1);
+	}
+
+	nbytes = bit_plane_bytes(pheader->M, pheader->N);
+	expected = sizeof(perco2_file_header_t) + 2 * nbytes;
+	if (pheader->flags & PERCO2_FILE_HAS_LABELS)
+		expected += (size_t)pheader->M * pheader->N * sizeof(int32_t);
+	if (statbuf.st_size != expected) {
+		fprintf(stderr, "\"%s\" has size %lld; expected %lld.\n",
+			file_name, (long long)statbuf.st_size, (long long)expected);
+		exit(1);
+	}
+
+	pmap = (perco2_mapped_file_t*)malloc_or_die(sizeof(perco2_mapped_file_t));
+	pmap->pheader = pheader;
+	pmap->vbits   = base + sizeof(perco2_file_header_t);
+	pmap->hbits   = pmap->vbits + nbytes;
+	if (pheader->flags & PERCO2_FILE_HAS_LABELS)
+		pmap->labels = (int32_t*)(pmap->hbits + nbytes);
+	else
+		pmap->labels = 0;
+	pmap->base = base;
+	pmap->size = statbuf.st_size;
+	return pmap;
+}
+
+// ----------------------------------------------------------------
+void unmap_lattice_file(perco2_mapped_file_t* pmap)
+{
+	munmap(pmap->base, pmap->size);
+	free(pmap);
+}
+
+// ----------------------------------------------------------------
+void unpack_lattice_bonds(perco2_mapped_file_t* pmap,
+	int** vbonds, int** hbonds)
+{
+	int M = pmap->pheader->M;
+	int N = pmap->pheader->N;
+	int i, j;
+
+	for (i = 0; i < M; i++) {
+		for (j = 0; j < N; j++) {
+			vbonds[i][j] = PERCO2_FILE_BIT(pmap->vbits, N, i, j);
+			hbonds[i][j] = PERCO2_FILE_BIT(pmap->hbits, N, i, j);
+		}
+	}
+	refresh_matrix_halo(vbonds, M, N);
+	refresh_matrix_halo(hbonds, M, N);
+}
@@ -0,0 +1,86 @@
+// ================================================================
+// PERCO2IO.H
+//
+// These are routines for saving a lattice realization -- its bonds, and
+// optionally its cluster numbers -- to a binary file, and for loading it
+// back.  Files are read through mmap(), so the bond bits and cluster numbers
+// may be accessed in place with no copying or parsing.
+//
+// ================================================================
+// FILE FORMAT
+//
+// All integers are in the byte order of the machine which wrote the file;
+// the magic number lets a reader detect a mismatch.
+//
+// * A 64-byte header, perco2_file_header_t below.
+// * The vertical bonds, as M*N bits in row-major order, vbonds[i][j] being
+//   bit (i*N+j)%8 of byte (i*N+j)/8.  The length in bytes is rounded up to a
+//   multiple of 8, so that what follows is 8-byte aligned.
+// * The horizontal bonds, in the same way.
+// * If the header's flags include PERCO2_FILE_HAS_LABELS:  the cluster
+//   numbers, as M*N 32-bit ints in row-major order.
+//
+// The bond conventions are those of perco2lib.h:  vbonds[i][j] is the bond
+// below site (i,j), and hbonds[i][j] is the bond right of it.
+// ================================================================
+
+#ifndef PERCO2IO_H
+#define PERCO2IO_H
+
+#include <stdint.h>
+#include "perco2lib.h"
+
+#define PERCO2_FILE_MAGIC   0x314f494f43524550ULL // "PERCOIO1" little-endian
+#define PERCO2_FILE_VERSION 1
+
+// Flag bits.
+#define PERCO2_FILE_HAS_LABELS 0x1 // Cluster numbers follow the bonds.
+#define PERCO2_FILE_HELICAL    0x2 // Realized with BC_HELICAL.
+
+typedef struct _perco2_file_header_t {
+	uint64_t magic;        // PERCO2_FILE_MAGIC
+	uint32_t version;      // PERCO2_FILE_VERSION
+	uint32_t flags;        // PERCO2_FILE_* bits
+	int32_t  M;            // Lattice height
+	int32_t  N;            // Lattice width
+	double   p;            // Bond probability
+	uint64_t seed;         // RNG seed the realization was drawn from
+	uint64_t rep;          // Which realization after seeding, from 0
+	int32_t  num_clusters; // If labels are present, else 0
+	int32_t  pad[3];
+} perco2_file_header_t;
+
+// A file mapped into memory.  The pointers point into the mapping.
+typedef struct _perco2_mapped_file_t {
+	perco2_file_header_t* pheader;
+	unsigned char* vbits;
+	unsigned char* hbits;
+	int32_t* labels;  // Null if the file has no labels
+	void*  base;
+	size_t size;
+} perco2_mapped_file_t;
+
+// Bond (i,j) from a bit array in the above format.
+#define PERCO2_FILE_BIT(bits, N, i, j) \
+	(((bits)[((i)*(N)+(j)) >> 3] >> (((i)*(N)+(j)) & 7)) & 1)
+
+// ----------------------------------------------------------------
+// Writes the realization to the file.  If site_marks is non-null, it must
+// hold cluster numbers from mark_cluster_numbers(), and they are written as
+// well.  Aborts the process on I/O error.
+void save_lattice_file(char* file_name, int** vbonds, int** hbonds,
+	int** site_marks, int M, int N, double p,
+	unsigned long long seed, unsigned long long rep);
+
+// Maps the file read-only, checks its header and size, and returns pointers
+// into it.  Aborts the process if the file is missing or malformed.
+perco2_mapped_file_t* map_lattice_file(char* file_name);
+void unmap_lattice_file(perco2_mapped_file_t* pmap);
+
+// Copies the bonds from a mapped file into vbonds and hbonds, which must be
+// pmap->pheader->M by pmap->pheader->N matrices from allocate_matrix().  For
+// padded matrices the halo is refreshed.
+void unpack_lattice_bonds(perco2_mapped_file_t* pmap,
+	int** vbonds, int** hbonds);
+
+#endif // PERCO2IO_H
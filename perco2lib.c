@@ -12,32 +12,196 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <math.h>
 #include "putil.h"
 #include "perco2lib.h"
 #include "rcmrand.h"
 #include "perco2print.h"
+#include "perco2fixed.h"
+#include "perco2pad.h"
+#include "perco2tile.h"
+#include "perco2ctx.h"
+#include "perco2ws.h"
+#include "perco2engine.h"
+#include "perco2mem.h"
 
 // ----------------------------------------------------------------
+// Scratch arrays of at least M*N elements from the current workspace, so
+// that the repetition loops below make no heap calls.
+static int* scratch_cluster_sizes(int M, int N)
+{
+	perco_ws_t* pws = perco_ws_current();
+	perco_ws_reserve(pws, M, N);
+	return pws->cluster_sizes;
+}
+
+static int* scratch_stack(int M, int N)
+{
+	perco_ws_t* pws = perco_ws_current();
+	perco_ws_reserve(pws, M, N);
+	return pws->stack;
+}
+
+// ----------------------------------------------------------------
+// These settings are shared by the whole process, except on a thread with a
+// context from perco2ctx.h bound to it, which uses the context's.
+static int lattice_layout = LAYOUT_PLAIN;
+
+void set_lattice_layout(int layout)
+{
+	lattice_layout = layout;
+}
+
+int get_lattice_layout(void)
+{
+	perco_ctx_t* pctx = perco_ctx_current();
+	return pctx ? pctx->layout : lattice_layout;
+}
+
+// ----------------------------------------------------------------
+static int boundary_condition = BC_PERIODIC;
+
+void set_boundary_condition(int bc)
+{
+	boundary_condition = bc;
+}
+
+int get_boundary_condition(void)
+{
+	perco_ctx_t* pctx = perco_ctx_current();
+	return pctx ? pctx->bc : boundary_condition;
+}
+
+// ----------------------------------------------------------------
+void wrap_site(int M, int N, int i, int j, int ij[d])
+{
+	if (get_boundary_condition() == BC_HELICAL) {
+		int MN = M*N;
+		int k  = ((i*N + j) % MN + MN) % MN;
+		ij[0] = k / N;
+		ij[1] = k % N;
+	}
+	else {
+		ij[0] = (i + M) % M;
+		ij[1] = (j + N) % N;
+	}
+}
+
+// ----------------------------------------------------------------
+// The elements are in one contiguous block, with matrix[i] pointing at row i
+// of it, so that &matrix[0][0] may also be used as a flat array.
+//
+// The row-pointer array always has M+2 entries, with matrix[-1] and matrix[M]
+// being the halo rows in the padded layout.  In the plain layout matrix[-1]
+// is null, which is how matrix_is_padded() tells the two apart.
 int** allocate_matrix(int M, int N, int fill)
+{
+	int** rows;
+	int* block;
+
+	check_lattice_size(M, N);
+	rows  = malloc_or_die((M+2) * sizeof(int*));
+	block = large_alloc_or_die(matrix_block_size(M, N) * sizeof(int));
+	return shape_matrix(rows, block, M, N, fill);
+}
+
+// ----------------------------------------------------------------
+int** shape_matrix(int** rows, int* block, int M, int N, int fill)
 {
 	int i, j;
-	int** matrix = malloc_or_die(M * sizeof(int*));
-	for (i = 0; i < M; i++)
-		matrix[i] = malloc_or_die(N * sizeof(int));
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			matrix[i][j] = fill;
+	int** matrix = rows + 1;
+
+	if (get_lattice_layout() == LAYOUT_PADDED) {
+		int S = N + 2;
+		for (i = -1; i <= M; i++)
+			matrix[i] = block + (i+1)*S + 1;
+		for (i = -1; i <= M; i++)
+			for (j = -1; j <= N; j++)
+				matrix[i][j] = fill;
+	}
+	else {
+		matrix[-1] = 0;
+		matrix[0] = block;
+		for (i = 1; i < M; i++)
+			matrix[i] = matrix[0] + i*N;
+		matrix[M] = 0;
+		for (i = 0; i < M; i++)
+			for (j = 0; j < N; j++)
+				matrix[i][j] = fill;
+	}
 	return matrix;
 }
 
+// ----------------------------------------------------------------
+size_t matrix_block_size(int M, int N)
+{
+	if (get_lattice_layout() == LAYOUT_PADDED)
+		return (size_t)(M+2) * (N+2);
+	else
+		return (size_t)M * N;
+}
+
+// ----------------------------------------------------------------
+// Both layouts are checked, since the layout may change after allocation.
+int lattice_size_ok(int M, int N)
+{
+	return (M >= 0) && (N >= 0) && (M <= INT_MAX - 2) && (N <= INT_MAX - 2) &&
+		((long long)(M+2) * (N+2) <= INT_MAX);
+}
+
+void check_lattice_size(int M, int N)
+{
+	if (!lattice_size_ok(M, N)) {
+		fprintf(stderr, "Lattice of %d by %d sites is too large:  at most "
+			"%d sites with the halo.\n", M, N, INT_MAX);
+		exit(1);
+	}
+}
+
 // ----------------------------------------------------------------
 void free_matrix(int** matrix, int M, int N)
 {
-	int i;
-	for (i = 0; i < M; i++)
-		free(matrix[i]);
-	free(matrix);
+	if (matrix_is_padded(matrix))
+		large_free(&matrix[-1][-1]);
+	else
+		large_free(matrix[0]);
+	free(matrix - 1);
+}
+
+// ----------------------------------------------------------------
+int matrix_is_padded(int** matrix)
+{
+	return matrix[-1] != 0;
+}
+
+// ----------------------------------------------------------------
+void refresh_matrix_halo(int** matrix, int M, int N)
+{
+	int i, j;
+	int ij[d];
+
+	if (!matrix_is_padded(matrix))
+		return;
+
+	if (get_boundary_condition() == BC_HELICAL) {
+		for (i = -1; i <= M; i++) {
+			for (j = -1; j <= N; j++) {
+				if ((0 <= i) && (i < M) && (0 <= j) && (j < N))
+					continue;
+				wrap_site(M, N, i, j, ij);
+				matrix[i][j] = matrix[ij[0]][ij[1]];
+			}
+		}
+		return;
+	}
+
+	for (i = 0; i < M; i++) {
+		matrix[i][-1] = matrix[i][N-1];
+		matrix[i][N]  = matrix[i][0];
+	}
+	memcpy(&matrix[-1][-1], &matrix[M-1][-1], (N+2) * sizeof(int));
+	memcpy(&matrix[M][-1],  &matrix[0][-1],   (N+2) * sizeof(int));
 }
 
 // ----------------------------------------------------------------
@@ -50,15 +214,34 @@ void fill_matrix(int** matrix, int M, int N, int value)
 }
 
 // ----------------------------------------------------------------
+// The uniforms are drawn in bulk, a chunk of sites at a time, but in the same
+// order as one URANDOM() per bond would draw them:  vertical then horizontal,
+// site by site.
+#define POPULATE_CHUNK 256
+static __thread double realization_p = -1.0;
+
 void populate_bonds(int** vbonds, int** hbonds, int M, int N, double p)
 {
-	int i, j;
+	double u[2*POPULATE_CHUNK];
+	int i, j, j0, nj;
+	realization_p = p;
 	for (i = 0; i < M; i++) {
-		for (j = 0; j < N; j++) {
-			vbonds[i][j] = (URANDOM() < p) ? 1 : 0;
-			hbonds[i][j] = (URANDOM() < p) ? 1 : 0;
+		for (j0 = 0; j0 < N; j0 += nj) {
+			nj = (N - j0 < POPULATE_CHUNK) ? N - j0 : POPULATE_CHUNK;
+			URANDOM_FILL(u, 2*nj);
+			for (j = 0; j < nj; j++) {
+				vbonds[i][j0+j] = (u[2*j]   < p) ? 1 : 0;
+				hbonds[i][j0+j] = (u[2*j+1] < p) ? 1 : 0;
+			}
 		}
 	}
+	refresh_matrix_halo(vbonds, M, N);
+	refresh_matrix_halo(hbonds, M, N);
+}
+
+double get_realization_p(void)
+{
+	return realization_p;
 }
 
 // ----------------------------------------------------------------
@@ -77,6 +260,52 @@ void set_A1_A2(int A1[d], int A2[d], int M, int N)
 	A2[1] = N/2+1;
 }
 
+// ----------------------------------------------------------------
+// With helical boundary conditions, site (i,j) is number k = i*N+j along the
+// helix, and its neighbors are k+1, k-1, k+N, and k-N mod M*N.  Going down or
+// up is the same as with periodic boundary conditions.  Going right from the
+// last column leads to the first column of the next row, and going left from
+// the first column leads to the last column of the previous row.
+
+static void get_bonded_neighbors_helical(int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int neighbors[MAXNEI][d], int* pnumnei)
+{
+	int numnei = 0;
+	int A1i    = A1[0];
+	int A1j    = A1[1];
+	int up[d], right[d], left[d];
+
+	wrap_site(M, N, A1i-1, A1j,   up);
+	wrap_site(M, N, A1i,   A1j+1, right);
+	wrap_site(M, N, A1i,   A1j-1, left);
+
+	if (vbonds[A1i  ][A1j  ]) { // Down  bond
+		neighbors[numnei][0] = (A1i+1 == M) ? 0 : A1i+1;
+		neighbors[numnei][1] = A1j;
+		numnei++;
+	}
+
+	if (hbonds[A1i  ][A1j  ]) { // Right bond
+		neighbors[numnei][0] = right[0];
+		neighbors[numnei][1] = right[1];
+		numnei++;
+	}
+
+	if (vbonds[up[0]][up[1]]) { // Up    bond
+		neighbors[numnei][0] = up[0];
+		neighbors[numnei][1] = up[1];
+		numnei++;
+	}
+
+	if (hbonds[left[0]][left[1]]) { // Left  bond
+		neighbors[numnei][0] = left[0];
+		neighbors[numnei][1] = left[1];
+		numnei++;
+	}
+
+	*pnumnei = numnei;
+}
+
 // ----------------------------------------------------------------
 //     Col j=0        Col j=3
 //
@@ -97,11 +326,23 @@ void get_bonded_neighbors(int** vbonds, int** hbonds, int M, int N,
 	int numnei = 0;
 	int A1i    = A1[0];
 	int A1j    = A1[1];
+	int A1im1, A1jm1, A1ip1, A1jp1;
 
-	int A1im1 = A1i - 1;
-	int A1jm1 = A1j - 1;
-	int A1ip1 = A1i + 1;
-	int A1jp1 = A1j + 1;
+	if (matrix_is_padded(vbonds)) {
+		get_bonded_neighbors_padded(vbonds, hbonds, M, N, A1, neighbors,
+			pnumnei);
+		return;
+	}
+	if (get_boundary_condition() == BC_HELICAL) {
+		get_bonded_neighbors_helical(vbonds, hbonds, M, N, A1, neighbors,
+			pnumnei);
+		return;
+	}
+
+	A1im1 = A1i - 1;
+	A1jm1 = A1j - 1;
+	A1ip1 = A1i + 1;
+	A1jp1 = A1j + 1;
 
 	if (A1im1 <  0) A1im1 += M;
 	if (A1jm1 <  0) A1jm1 += N;
@@ -157,6 +398,11 @@ int get_num_neighbors(int** vbonds, int** hbonds, int M, int N, int A1[d])
 void mark_one_cluster(int** site_marks, int** vbonds, int** hbonds,
 	int M, int N, int A1[d], int mark_value)
 {
+	if (matrix_is_padded(site_marks)) {
+		mark_one_cluster_padded(site_marks, vbonds, hbonds, M, N, A1,
+			mark_value);
+		return;
+	}
 	fill_matrix(site_marks, M, N, SITECHAR);
 	mark_one_cluster_aux(site_marks, vbonds, hbonds, M, N, A1,
 		mark_value);
@@ -217,7 +463,7 @@ double get_mean_finite_C0_size(
 	int M, int N, double p, int reps, int A1[d])
 {
 	int num_clusters;
-	int* cluster_sizes;
+	int* cluster_sizes = scratch_cluster_sizes(M, N);
 	double mean_finite_C0_size = 0.0;
 	int A_cluster_size;
 	int rep;
@@ -228,7 +474,6 @@ double get_mean_finite_C0_size(
 	for (rep = 0; rep < reps; rep++) {
 		populate_bonds(vbonds, hbonds, M, N, p);
 		mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, &num_clusters);
-		cluster_sizes = (int*)malloc_or_die(sizeof(int) * num_clusters);
 		get_cluster_sizes(site_marks, M, N, num_clusters, cluster_sizes,
 			&largest_clno);
 		A_clno = site_marks[A1[0]][A1[1]];
@@ -251,8 +496,6 @@ double get_mean_finite_C0_size(
 			num_finite++;
 		}
 #endif
-
-		free(cluster_sizes);
 	}
 	if (num_finite == 0)
 		mean_finite_C0_size = 0.0;
@@ -316,8 +559,7 @@ double get_corrlen(int** site_marks, int** vbonds, int** hbonds,
 	double upper_sum = 0.0;
 	double lower_sum = 0.0;
 	double upper_term, lower_term;
-	int max_num_clusters = M*N; // p=0 case
-	int* cluster_sizes = (int*)malloc_or_die(sizeof(int) * max_num_clusters);
+	int* cluster_sizes = scratch_cluster_sizes(M, N); // M*N when p=0
 	double corrlen;
 
 	for (rep = 0; rep < reps; rep++) {
@@ -354,7 +596,6 @@ double get_corrlen(int** site_marks, int** vbonds, int** hbonds,
 		lower_sum += lower_term;
 	}
 
-	free(cluster_sizes);
 
 	if (lower_sum == 0.0)
 		corrlen = 0.0;
@@ -387,6 +628,18 @@ int A1_oo_A2_aux(int** site_marks, int** vbonds, int** hbonds,
 
 int A1_oo_A2(int** site_marks, int** vbonds, int** hbonds,
 	int M, int N, int A1[d], int A2[d])
+{
+	int ctd;
+	if ((get_boundary_condition() == BC_PERIODIC) &&
+		fixed_A1_oo_A2(site_marks, vbonds, hbonds, M, N, A1, A2, &ctd))
+		return ctd;
+	if (matrix_is_padded(site_marks))
+		return A1_oo_A2_padded(site_marks, vbonds, hbonds, M, N, A1, A2);
+	return A1_oo_A2_dfs(site_marks, vbonds, hbonds, M, N, A1, A2);
+}
+
+int A1_oo_A2_dfs(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d])
 {
 	fill_matrix(site_marks, M, N, SITECHAR);
 	return A1_oo_A2_aux(site_marks, vbonds, hbonds, M, N, A1, A2);
@@ -409,6 +662,39 @@ double P_A1_oo_A2(int** site_marks, int** vbonds, int** hbonds,
 // ----------------------------------------------------------------
 void mark_cluster_numbers(int** site_marks, int** vbonds, int** hbonds,
 	int M, int N, int* pnum_clusters)
+{
+	if (mark_cluster_numbers_by_engine(site_marks, vbonds, hbonds, M, N,
+		pnum_clusters))
+		return;
+	if ((get_boundary_condition() == BC_PERIODIC) &&
+		fixed_mark_cluster_numbers(site_marks, vbonds, hbonds, M, N,
+		pnum_clusters))
+		return;
+	if ((M*N >= TILED_MIN_SITES) && (get_labeling_threads() > 1))
+		mark_cluster_numbers_threaded(site_marks, vbonds, hbonds, M, N,
+			pnum_clusters);
+	else if (M*N >= TILED_MIN_SITES)
+		mark_cluster_numbers_hk(site_marks, vbonds, hbonds, M, N,
+			pnum_clusters);
+	else if (matrix_is_padded(site_marks))
+		mark_cluster_numbers_padded(site_marks, vbonds, hbonds, M, N,
+			pnum_clusters);
+	else if (get_boundary_condition() == BC_HELICAL)
+		mark_cluster_numbers_helical(site_marks, vbonds, hbonds, M, N,
+			pnum_clusters);
+	else if (is_power_of_two(M) && is_power_of_two(N))
+		mark_cluster_numbers_pow2(site_marks, vbonds, hbonds, M, N,
+			pnum_clusters);
+	else if (M*N <= DFS_MAX_SITES)
+		mark_cluster_numbers_dfs(site_marks, vbonds, hbonds, M, N,
+			pnum_clusters);
+	else
+		mark_cluster_numbers_hk(site_marks, vbonds, hbonds, M, N,
+			pnum_clusters);
+}
+
+void mark_cluster_numbers_dfs(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters)
 {
 	int neighbors[MAXNEI][d];
 	int numnei;
@@ -443,6 +729,136 @@ void mark_cluster_numbers(int** site_marks, int** vbonds, int** hbonds,
 		*pnum_clusters = cluster_number;
 }
 
+// ----------------------------------------------------------------
+int is_power_of_two(int n)
+{
+	return (n > 0) && ((n & (n-1)) == 0);
+}
+
+// ----------------------------------------------------------------
+// With N a power of two, site (i,j) is at flat index k = i*N + j, and j is the
+// low bits of k.  Stepping right or left within a row changes only the low
+// bits, so the column wraps by masking them; stepping down or up changes k by
+// N, and with M*N also a power of two, the row wraps by masking all of k.
+// This replaces the four compare-and-adjust branches in
+// get_bonded_neighbors() with four ANDs.
+//
+// The traversal is an iterative depth-first search.  Its visiting order
+// differs from that of mark_one_cluster_aux(), but since clusters are
+// numbered in order of their first site, the cluster numbers are the same.
+
+void mark_cluster_numbers_pow2(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters)
+{
+	int* marks = &site_marks[0][0];
+	int* vb    = &vbonds[0][0];
+	int* hb    = &hbonds[0][0];
+	int MN     = M*N;
+	int maskMN = MN - 1;
+	int maskN  = N - 1;
+	int* stack = scratch_stack(M, N);
+	int cluster_number = 0;
+	int k, x, y, row, sp;
+
+	for (k = 0; k < MN; k++)
+		marks[k] = -1;
+
+	for (k = 0; k < MN; k++) {
+		if (marks[k] >= 0) // Already marked
+			continue;
+
+		sp = 0;
+		marks[k] = cluster_number;
+		stack[sp++] = k;
+		while (sp > 0) {
+			x = stack[--sp];
+			row = x & ~maskN;
+
+			y = (x + N) & maskMN;            // Down
+			if (vb[x] && (marks[y] < 0)) {
+				marks[y] = cluster_number;
+				stack[sp++] = y;
+			}
+			y = row | ((x + 1) & maskN);     // Right
+			if (hb[x] && (marks[y] < 0)) {
+				marks[y] = cluster_number;
+				stack[sp++] = y;
+			}
+			y = (x - N) & maskMN;            // Up
+			if (vb[y] && (marks[y] < 0)) {
+				marks[y] = cluster_number;
+				stack[sp++] = y;
+			}
+			y = row | ((x - 1) & maskN);     // Left
+			if (hb[y] && (marks[y] < 0)) {
+				marks[y] = cluster_number;
+				stack[sp++] = y;
+			}
+		}
+		cluster_number++;
+	}
+
+	if (pnum_clusters)
+		*pnum_clusters = cluster_number;
+}
+
+// ----------------------------------------------------------------
+// With helical boundary conditions, the lattice is a single helix of M*N
+// sites, and each neighbor step is one add modulo M*N on the flat index.  The
+// compare against M*N (or 0) in each step is a conditional move, not a branch.
+
+void mark_cluster_numbers_helical(int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters)
+{
+	int* marks = &site_marks[0][0];
+	int* vb    = &vbonds[0][0];
+	int* hb    = &hbonds[0][0];
+	int MN     = M*N;
+	int* stack = scratch_stack(M, N);
+	int cluster_number = 0;
+	int k, x, y, sp;
+
+	for (k = 0; k < MN; k++)
+		marks[k] = -1;
+
+	for (k = 0; k < MN; k++) {
+		if (marks[k] >= 0) // Already marked
+			continue;
+
+		sp = 0;
+		marks[k] = cluster_number;
+		stack[sp++] = k;
+		while (sp > 0) {
+			x = stack[--sp];
+
+			y = x + N;  y = (y >= MN) ? y - MN : y;  // Down
+			if (vb[x] && (marks[y] < 0)) {
+				marks[y] = cluster_number;
+				stack[sp++] = y;
+			}
+			y = x + 1;  y = (y >= MN) ? y - MN : y;  // Right
+			if (hb[x] && (marks[y] < 0)) {
+				marks[y] = cluster_number;
+				stack[sp++] = y;
+			}
+			y = x - N;  y = (y < 0) ? y + MN : y;    // Up
+			if (vb[y] && (marks[y] < 0)) {
+				marks[y] = cluster_number;
+				stack[sp++] = y;
+			}
+			y = x - 1;  y = (y < 0) ? y + MN : y;    // Left
+			if (hb[y] && (marks[y] < 0)) {
+				marks[y] = cluster_number;
+				stack[sp++] = y;
+			}
+		}
+		cluster_number++;
+	}
+
+	if (pnum_clusters)
+		*pnum_clusters = cluster_number;
+}
+
 // ----------------------------------------------------------------
 void sanity_check_cluster_numbers(int** site_marks, int** vbonds, int** hbonds,
 	int M, int N)
@@ -517,7 +933,7 @@ double P_A_in_C(int** site_marks, int** vbonds, int** hbonds, int M, int N,
 {
 	int k;
 	int num_A_in_C = 0;
-	int* cluster_sizes = (int*)malloc_or_die(sizeof(int) *M*N);
+	int* cluster_sizes = scratch_cluster_sizes(M, N);
 
 	for (k = 0; k < reps; k++) {
 		populate_bonds(vbonds, hbonds, M, N, p);
@@ -525,10 +941,52 @@ double P_A_in_C(int** site_marks, int** vbonds, int** hbonds, int M, int N,
 			cluster_sizes);
 	}
 
-	free(cluster_sizes);
 	return (double)num_A_in_C/(double)reps;
 }
 
+// ----------------------------------------------------------------
+int cluster_size_bin(int size)
+{
+	int b = 0;
+	while (size > 1) {
+		size >>= 1;
+		b++;
+	}
+	return b;
+}
+
+// The sizes come from the same labeling pass as the other estimators use;
+// only the binning is extra.
+void add_cluster_size_histogram(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* cluster_sizes, long long bins[CLUSTER_SIZE_BINS],
+	long long largest_bins[CLUSTER_SIZE_BINS])
+{
+	int num_clusters;
+	int C_clno; // Number of largest cluster
+	int k;
+
+	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, &num_clusters);
+	get_cluster_sizes(site_marks, M, N, num_clusters, cluster_sizes,
+		&C_clno);
+	for (k = 0; k < num_clusters; k++)
+		bins[cluster_size_bin(cluster_sizes[k])]++;
+	largest_bins[cluster_size_bin(cluster_sizes[C_clno])]++;
+}
+
+void get_cluster_size_histogram(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps, long long bins[CLUSTER_SIZE_BINS],
+	long long largest_bins[CLUSTER_SIZE_BINS])
+{
+	int k;
+	int* cluster_sizes = scratch_cluster_sizes(M, N);
+
+	for (k = 0; k < reps; k++) {
+		populate_bonds(vbonds, hbonds, M, N, p);
+		add_cluster_size_histogram(site_marks, vbonds, hbonds, M, N,
+			cluster_sizes, bins, largest_bins);
+	}
+}
+
 // ----------------------------------------------------------------
 int A1_or_A2_in_C(int** site_marks, int** vbonds, int** hbonds, int M, int N,
 	double p, int A1[d], int A2[d], int* cluster_sizes)
@@ -556,7 +1014,7 @@ double P_A1_or_A2_in_C(int** site_marks,
 {
 	int k;
 	int num_A1_or_A2_in_C = 0;
-	int* cluster_sizes = (int*)malloc_or_die(sizeof(int) *M*N);
+	int* cluster_sizes = scratch_cluster_sizes(M, N);
 
 	for (k = 0; k < reps; k++) {
 		populate_bonds(vbonds, hbonds, M, N, p);
@@ -564,6 +1022,126 @@ double P_A1_or_A2_in_C(int** site_marks,
 			M, N, p, A1, A2, cluster_sizes);
 	}
 
-	free(cluster_sizes);
 	return (double)num_A1_or_A2_in_C/(double)reps;
 }
+
+// ================================================================
+// TRANSLATION-AVERAGED ESTIMATORS
+//
+// With periodic or helical boundary conditions every site is equivalent, so
+// the single-origin indicators above have the same expectation when averaged
+// over all MN choices of origin.  One labeling gives all MN of them:
+//
+// * The fraction of origins A in C is #C / MN.
+// * The fraction of diagonal pairs (A, A+(1,1)) with either end in C is a
+//   count over sites.
+// * The mean over origins A of #C(A) is sum_k #C_k^2 / MN, the size-weighted
+//   mean cluster size.
+//
+// The MN terms are correlated, so the variance drops by less than a factor
+// of MN; "./perco2 benchavg" measures by how much.
+
+// ----------------------------------------------------------------
+double A_in_C_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* cluster_sizes)
+{
+	int num_clusters;
+	int C_clno;
+
+	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, &num_clusters);
+	get_cluster_sizes(site_marks, M, N, num_clusters, cluster_sizes, &C_clno);
+	return (double)cluster_sizes[C_clno] / ((double)M * N);
+}
+
+// ----------------------------------------------------------------
+double A1_or_A2_in_C_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* cluster_sizes)
+{
+	int num_clusters;
+	int C_clno;
+	int i, j;
+	int A2[d];
+	int count = 0;
+
+	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, &num_clusters);
+	get_cluster_sizes(site_marks, M, N, num_clusters, cluster_sizes, &C_clno);
+	for (i = 0; i < M; i++) {
+		for (j = 0; j < N; j++) {
+			if (site_marks[i][j] == C_clno) {
+				count++;
+				continue;
+			}
+			wrap_site(M, N, i+1, j+1, A2);
+			if (site_marks[A2[0]][A2[1]] == C_clno)
+				count++;
+		}
+	}
+	return (double)count / ((double)M * N);
+}
+
+// ----------------------------------------------------------------
+double C0_size_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* cluster_sizes)
+{
+	int num_clusters;
+	int C_clno;
+	int k;
+	double sum_squares = 0.0;
+
+	mark_cluster_numbers(site_marks, vbonds, hbonds, M, N, &num_clusters);
+	get_cluster_sizes(site_marks, M, N, num_clusters, cluster_sizes, &C_clno);
+	for (k = 0; k < num_clusters; k++)
+		sum_squares += (double)cluster_sizes[k] * cluster_sizes[k];
+	return sum_squares / ((double)M * N);
+}
+
+// ----------------------------------------------------------------
+double P_A_in_C_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps)
+{
+	int k;
+	double sum = 0.0;
+	int* cluster_sizes = scratch_cluster_sizes(M, N);
+
+	for (k = 0; k < reps; k++) {
+		populate_bonds(vbonds, hbonds, M, N, p);
+		sum += A_in_C_avg_all(site_marks, vbonds, hbonds, M, N,
+			cluster_sizes);
+	}
+
+	return sum/reps;
+}
+
+// ----------------------------------------------------------------
+double P_A1_or_A2_in_C_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps)
+{
+	int k;
+	double sum = 0.0;
+	int* cluster_sizes = scratch_cluster_sizes(M, N);
+
+	for (k = 0; k < reps; k++) {
+		populate_bonds(vbonds, hbonds, M, N, p);
+		sum += A1_or_A2_in_C_avg_all(site_marks, vbonds, hbonds, M, N,
+			cluster_sizes);
+	}
+
+	return sum/reps;
+}
+
+// ----------------------------------------------------------------
+double get_mean_C0_size_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps)
+{
+	int k;
+	double sum = 0.0;
+	int* cluster_sizes = scratch_cluster_sizes(M, N);
+
+	for (k = 0; k < reps; k++) {
+		populate_bonds(vbonds, hbonds, M, N, p);
+		sum += C0_size_avg_all(site_marks, vbonds, hbonds, M, N,
+			cluster_sizes);
+	}
+
+	return sum/reps;
+}
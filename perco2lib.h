@@ -45,6 +45,10 @@
 // Each of these routines is tested in perco2.c.  So, please see perco2.c
 // for examples of how to use these routines.
 //
+// The boundary condition, the layout, and the random-number generator are
+// settings for the whole process.  For running several simulations with
+// different settings at once, please see the contexts in perco2ctx.h.
+//
 // ================================================================
 // John Kerl
 // kerl.john.r@gmail.com
@@ -54,10 +58,13 @@
 #ifndef PERCO2LIB_H
 #define PERCO2LIB_H
 
+#include <stddef.h>
+
 // ----------------------------------------------------------------
 // Two-dimensional percolation.  Leaving this as 'd' rather than hard-coding
 // '2' throughout simplified the port to 3D percolation (which I am not
-// presenting for my computational exam).
+// presenting for my computational exam).  The routines in percod.h handle
+// d = 2 and d = 3 with the dimension fixed at compile time.
 #define d 2
 
 // A macro for comparing points in 2D:
@@ -73,21 +80,83 @@
 // Critical bond density for 2D:
 #define P_C 0.5
 
+// ----------------------------------------------------------------
+// Boundary conditions.  The default, BC_PERIODIC, wraps rows and columns
+// around independently, making the lattice a torus.  With BC_HELICAL, site
+// (i,j) is number k = i*N+j along a single helix, and its neighbors are k+1,
+// k-1, k+N, and k-N, mod M*N:  going right from the last column leads to the
+// first column of the next row.  Vertical neighbors are the same as with
+// BC_PERIODIC.  Bulk behavior is the same; finite-size effects differ
+// slightly.  All the routines in this file honor the boundary condition.
+#define BC_PERIODIC 0
+#define BC_HELICAL  1
+
+void set_boundary_condition(int bc);
+int  get_boundary_condition(void);
+
+// Maps site (i,j), which may be up to one site outside the lattice on any
+// side, to the same site within the lattice, according to the boundary
+// condition.  The result is written to ij[].
+void wrap_site(int M, int N, int i, int j, int ij[d]);
+
+// ----------------------------------------------------------------
+// Lattice storage layouts.  With LAYOUT_PADDED, allocate_matrix() surrounds
+// the M by N matrix with a one-site halo, so that matrix[i][j] is valid for
+// i = -1 .. M and j = -1 .. N.  populate_bonds() copies each edge row and
+// column into the halo on the opposite side, after which no bond lookup needs
+// to wrap around.  The routines below give the same results with either
+// layout; for padded matrices they call the routines in perco2pad.h.
+#define LAYOUT_PLAIN  0
+#define LAYOUT_PADDED 1
+
+// Sets the layout used by subsequent calls to allocate_matrix().  The default
+// is LAYOUT_PLAIN.
+void set_lattice_layout(int layout);
+int  get_lattice_layout(void);
+
+// Returns 1 if the matrix was allocated with the padded layout, else 0.
+int  matrix_is_padded(int** matrix);
+
+// Copies each edge row and column of the matrix into the halo on the opposite
+// side.  populate_bonds() does this; callers which set bonds some other way
+// should call it afterward.  Does nothing for unpadded matrices.
+void refresh_matrix_halo(int** matrix, int M, int N);
+
 // ----------------------------------------------------------------
 // Allocates an M by N matrix of integers, e.g. vbonds[][], hbonds[][], or
 // site_marks[][].  The caller should use free_matrix() to release the
-// dynamically allocated memory.
+// dynamically allocated memory.  The elements are stored contiguously in
+// row-major order.  In the plain layout &matrix[0][0] is a flat array with
+// element (i,j) at index i*N+j; in the padded layout &matrix[-1][-1] is a
+// flat array with element (i,j) at index (i+1)*(N+2)+(j+1).
 int** allocate_matrix(int M, int N, int fill);
 
 // Frees the memory obtained by allocate_matrix().
 void free_matrix(int** matrix, int M, int N);
 
+// As allocate_matrix(), but in storage of the caller's, which is not freed
+// with free_matrix():  rows must have at least M+2 entries, and block at
+// least matrix_block_size(M, N) elements.  Used by the workspace of
+// perco2ws.h to lay out lattices of different sizes in the same storage.
+int** shape_matrix(int** rows, int* block, int M, int N, int fill);
+// The number of elements allocate_matrix() needs in the current layout.
+size_t matrix_block_size(int M, int N);
+
+// Site numbers i*N+j, and the padded layout's flat indices, are ints, so a
+// lattice may have at most INT_MAX elements with its halo.  The first says
+// whether M by N is within that; the second exits with a message if not.
+// allocate_matrix() and the workspace of perco2ws.h check.
+int  lattice_size_ok(int M, int N);
+void check_lattice_size(int M, int N);
+
 // Sets all elements of the matrix to the same value.  Other ways to populate
 // the matrix elements are left to the caller's imagination.
 void fill_matrix(int** matrix, int M, int N, int value);
 
 // Populates lattice bonds, IID and open (connected) with probability p.
 void populate_bonds(int** vbonds, int** hbonds, int M, int N, double p);
+// The p of the calling thread's last populate_bonds(), or -1 if none.
+double get_realization_p(void);
 
 // ----------------------------------------------------------------
 // Various routines have one or two distinguished points on the lattice.
@@ -158,8 +227,14 @@ double get_corrlen(int** site_marks, int** vbonds, int** hbonds,
 // * site_marks[][] is a caller-provided MxN workspace.
 // Returns 1 if there is a path from point A1 to point A2, else 0.
 // populate_bonds() must have been called first.
+// For the square lattice sizes listed in perco2fixed.h, with periodic boundary
+// conditions, this uses a kernel specialized for that size; otherwise it
+// calls A1_oo_A2_dfs().
 int A1_oo_A2(int** site_marks, int** vbonds, int** hbonds,
 	int M, int N, int A1[d], int A2[d]);
+// The generic depth-first search, for any lattice size.
+int A1_oo_A2_dfs(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d]);
 
 // Over a specified number of repetitions (the reps argument), populates
 // lattices and finds the fraction of those in which there is a path from point
@@ -171,8 +246,40 @@ double P_A1_oo_A2(int** site_marks, int** vbonds, int** hbonds,
 // * site_marks[][] is a caller-provided MxN workspace.
 // * Upon return, the reference argument *pnum_clusters contains the number
 //   of clusters in the lattice.
+// * Clusters are numbered 0, 1, 2, ... in order of their first site in
+//   row-major order.
+// For the square lattice sizes listed in perco2fixed.h, with periodic boundary
+// conditions, this uses a kernel specialized for that size.  Otherwise, for
+// lattices of TILED_MIN_SITES or more sites, whose matrices no longer fit in
+// L2 cache, this calls mark_cluster_numbers_hk() from perco2tile.h, or
+// mark_cluster_numbers_threaded() if set_labeling_threads() was given more
+// than one thread; for padded matrices, this calls
+// mark_cluster_numbers_padded(); with helical boundary conditions it calls
+// mark_cluster_numbers_helical(); if M and N are both powers of two, it calls
+// mark_cluster_numbers_pow2(); else it calls mark_cluster_numbers_dfs() if
+// the lattice has at most DFS_MAX_SITES sites, or mark_cluster_numbers_hk().
+// All of this is overridden by set_labeling_engine() in perco2engine.h.
 void mark_cluster_numbers(int** site_marks, int** vbonds, int** hbonds,
 	int M, int N, int* pnum_clusters);
+#define TILED_MIN_SITES (256*256)
+// The generic depth-first-search labeling, for any lattice size.  It
+// recurses once per site of a cluster, so on a default 8 MB stack it is only
+// safe for lattices of up to DFS_MAX_SITES sites.
+#define DFS_MAX_SITES (128*256)
+void mark_cluster_numbers_dfs(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters);
+// The same, for M and N both powers of two.  Sites are indexed flat, and the
+// periodic wraparound is done with bit masks rather than compares.  The
+// matrices must have come from allocate_matrix() with the plain layout.
+void mark_cluster_numbers_pow2(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters);
+// The same, for helical boundary conditions.  Sites are indexed flat, and
+// each neighbor step is one add modulo M*N.  The matrices must have come from
+// allocate_matrix() with the plain layout.
+void mark_cluster_numbers_helical(int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters);
+// Returns 1 if n is a positive power of two, else 0.
+int is_power_of_two(int n);
 
 // * vbonds, hbond, M, and N represent the lattice.
 // * site_marks[][] must have already been populated by calling
@@ -230,4 +337,52 @@ double P_A1_or_A2_in_C(int** site_marks,
 	int** vbonds, int** hbonds, int M, int N,
 	double p, int reps, int A1[d], int A2[d]);
 
+// ----------------------------------------------------------------
+// Log-binned cluster-size histograms, for the cluster-number distribution
+// n_s(p):  bin b counts clusters with 2^b <= size < 2^(b+1).
+#define CLUSTER_SIZE_BINS 32
+int cluster_size_bin(int size);
+
+// For one populated realization:  labels the clusters, then adds one to the
+// bin of each cluster's size in bins[], and to the bin of the largest
+// cluster's size in largest_bins[], so that the finite clusters may be
+// counted as the difference.  cluster_sizes[] is as for A_in_C().
+void add_cluster_size_histogram(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* cluster_sizes, long long bins[CLUSTER_SIZE_BINS],
+	long long largest_bins[CLUSTER_SIZE_BINS]);
+// Over a specified number of repetitions, populates lattices and adds their
+// clusters to the histograms.
+void get_cluster_size_histogram(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps, long long bins[CLUSTER_SIZE_BINS],
+	long long largest_bins[CLUSTER_SIZE_BINS]);
+
+// ----------------------------------------------------------------
+// Translation-averaged versions of the above, selected by "avg=all" in
+// perco2.c.  Since all sites are equivalent under periodic or helical
+// boundary conditions, each realization is scored by averaging over every
+// site as the origin, rather than only the center site from set_A1().  The
+// expectations are the same; the variances are smaller.  Please see the
+// comments above A_in_C_avg_all() in perco2lib.c.
+//
+// For one populated realization, these return:  the fraction of sites in the
+// largest cluster; the fraction of sites A such that A or A+(1,1) is in the
+// largest cluster; and the mean over sites A of the size of the cluster
+// containing A.  cluster_sizes[] is as for A_in_C().
+double A_in_C_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* cluster_sizes);
+double A1_or_A2_in_C_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* cluster_sizes);
+double C0_size_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* cluster_sizes);
+
+// Over a specified number of repetitions, populates lattices and returns the
+// mean of the above:  estimates of the same quantities as P_A_in_C(),
+// P_A1_or_A2_in_C(), and get_mean_C0_size().
+double P_A_in_C_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps);
+double P_A1_or_A2_in_C_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps);
+double get_mean_C0_size_avg_all(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, double p, int reps);
+
 #endif // PERCO2LIB_H
@@ -0,0 +1,244 @@
+// ================================================================
+// PERCO2MEM.C
+// Please see the comments in perco2mem.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "putil.h"
+#include "perco2mem.h"
+
+// The ways an array may be obtained, for the report.  PATH_MMAP is MEM_THP
+// when madvise() failed.
+#define PATH_MALLOC  0
+#define PATH_MMAP    1
+#define PATH_THP     2
+#define PATH_HUGETLB 3
+#define NUM_PATHS    4
+
+static char* path_names[NUM_PATHS] = {
+	"malloc", "mmap (madvise failed)", "thp", "hugetlb"
+};
+
+// Each array is preceded by a header, one cache line long so as to keep the
+// array aligned, saying how to release it.
+typedef struct _large_header_t {
+	void*  base;      // What malloc() or mmap() returned
+	size_t map_bytes; // For munmap()
+	int    path;
+	char   pad[64 - sizeof(void*) - sizeof(size_t) - sizeof(int)];
+} large_header_t;
+
+static int mem_policy = MEM_MALLOC;
+
+static long long path_counts[NUM_PATHS];
+static long long path_bytes[NUM_PATHS];
+static long long hugetlb_fallbacks = 0;
+static long long peak_anon_huge_kb = 0;
+static long long peak_hugetlb_kb   = 0;
+
+// ----------------------------------------------------------------
+int mem_policy_by_name(char* name)
+{
+	if (strcmp(name, "malloc") == 0)
+		return MEM_MALLOC;
+	if (strcmp(name, "thp") == 0)
+		return MEM_THP;
+	if (strcmp(name, "hugetlb") == 0)
+		return MEM_HUGETLB;
+	return -1;
+}
+
+char* mem_policy_name(int policy)
+{
+	switch (policy) {
+	case MEM_THP:     return "thp";
+	case MEM_HUGETLB: return "hugetlb";
+	default:          return "malloc";
+	}
+}
+
+void set_mem_policy(int policy)
+{
+	mem_policy = policy;
+}
+
+int get_mem_policy(void)
+{
+	return mem_policy;
+}
+
+// ----------------------------------------------------------------
+// The process's huge-page usage so far, kept as a running peak since the
+// arrays are mostly gone by the time the report is printed.  Only the
+// mmap()ed paths call this, and only when releasing, which is rare.
+static void sample_huge_usage(void)
+{
+	char line[256];
+	long long kb;
+	FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+
+	if (fp == 0)
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "AnonHugePages: %lld", &kb) == 1) {
+			if (kb > __atomic_load_n(&peak_anon_huge_kb, __ATOMIC_RELAXED))
+				__atomic_store_n(&peak_anon_huge_kb, kb, __ATOMIC_RELAXED);
+		}
+		else if (sscanf(line, "Private_Hugetlb: %lld", &kb) == 1) {
+			if (kb > __atomic_load_n(&peak_hugetlb_kb, __ATOMIC_RELAXED))
+				__atomic_store_n(&peak_hugetlb_kb, kb, __ATOMIC_RELAXED);
+		}
+	}
+	fclose(fp);
+}
+
+// ----------------------------------------------------------------
+// Maps at least num_bytes, starting on a huge-page boundary, by mapping a
+// huge page more than needed and unmapping the ends.  Returns 0 on failure.
+static void* map_aligned(size_t num_bytes)
+{
+	size_t span = num_bytes + HUGE_PAGE_SIZE;
+	char* raw = (char*)mmap(0, span, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	char* aligned;
+	size_t head, tail;
+
+	if (raw == MAP_FAILED)
+		return 0;
+	aligned = (char*)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1)
+		& ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+	head = aligned - raw;
+	tail = span - head - num_bytes;
+	if (head > 0)
+		munmap(raw, head);
+	if (tail > 0)
+		munmap(aligned + num_bytes, tail);
+	return aligned;
+}
+
+// ----------------------------------------------------------------
+void* large_alloc_or_die(size_t num_bytes)
+{
+	size_t total = num_bytes + sizeof(large_header_t);
+	size_t map_bytes = (total + HUGE_PAGE_SIZE - 1)
+		& ~(size_t)(HUGE_PAGE_SIZE - 1);
+	large_header_t* phdr = 0;
+	void* base = MAP_FAILED;
+	int path = PATH_MALLOC;
+
+	if ((mem_policy != MEM_MALLOC) && (num_bytes >= LARGE_ALLOC_MIN)) {
+		if (mem_policy == MEM_HUGETLB) {
+			base = mmap(0, map_bytes, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (base != MAP_FAILED)
+				path = PATH_HUGETLB;
+			else
+				__atomic_fetch_add(&hugetlb_fallbacks, 1, __ATOMIC_RELAXED);
+		}
+		if (base == MAP_FAILED) {
+			base = map_aligned(map_bytes);
+			if (base == 0) {
+				fprintf(stderr, "mmap(%lu) failed.\n",
+					(unsigned long)map_bytes);
+				exit(1);
+			}
+			path = (madvise(base, map_bytes, MADV_HUGEPAGE) == 0)
+				? PATH_THP : PATH_MMAP;
+		}
+		// Only the header's page is touched here.
+		phdr = (large_header_t*)base;
+		phdr->map_bytes = map_bytes;
+	}
+	else {
+		// Not malloc_or_die(), whose int may be too small.
+		phdr = (large_header_t*)malloc(total);
+		if (phdr == 0) {
+			fprintf(stderr, "malloc(%lu) failed.\n", (unsigned long)total);
+			exit(1);
+		}
+		phdr->map_bytes = 0;
+		base = phdr;
+	}
+	count_heap_call();
+
+	phdr->base = base;
+	phdr->path = path;
+	__atomic_fetch_add(&path_counts[path], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&path_bytes[path], (long long)num_bytes,
+		__ATOMIC_RELAXED);
+	return phdr + 1;
+}
+
+// ----------------------------------------------------------------
+void large_free(void* p)
+{
+	large_header_t* phdr;
+
+	if (p == 0)
+		return;
+	phdr = (large_header_t*)p - 1;
+	if (phdr->path == PATH_MALLOC) {
+		free(phdr->base);
+	}
+	else {
+		sample_huge_usage();
+		munmap(phdr->base, phdr->map_bytes);
+	}
+}
+
+// ----------------------------------------------------------------
+// /sys lists the online nodes as ranges, e.g. "0-1" or "0,2-3".
+static int count_numa_nodes(void)
+{
+	char buf[256];
+	char* s;
+	int lo, hi, n, count = 0;
+	FILE* fp = fopen("/sys/devices/system/node/online", "r");
+
+	if (fp == 0)
+		return 1;
+	if (fgets(buf, sizeof(buf), fp) == 0) {
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+	for (s = buf; *s && (*s != '\n'); ) {
+		if (sscanf(s, "%d-%d%n", &lo, &hi, &n) == 2)
+			count += hi - lo + 1;
+		else if (sscanf(s, "%d%n", &lo, &n) == 1)
+			count++;
+		else
+			break;
+		s += n;
+		if (*s == ',')
+			s++;
+	}
+	return (count > 0) ? count : 1;
+}
+
+// ----------------------------------------------------------------
+void print_mem_report(FILE* fp)
+{
+	int k;
+
+	sample_huge_usage();
+	fprintf(fp, "mem=%s: arrays:", mem_policy_name(mem_policy));
+	for (k = 0; k < NUM_PATHS; k++) {
+		if (path_counts[k] == 0)
+			continue;
+		fprintf(fp, " %s %lld (%.1lf MB)", path_names[k], path_counts[k],
+			path_bytes[k] / 1048576.0);
+	}
+	fprintf(fp, "\n");
+	if (hugetlb_fallbacks > 0)
+		fprintf(fp, "mem=%s: %lld arrays fell back to thp:  too few "
+			"huge pages in /proc/sys/vm/nr_hugepages\n",
+			mem_policy_name(mem_policy), hugetlb_fallbacks);
+	fprintf(fp, "mem=%s: peak AnonHugePages=%lld kB Private_Hugetlb=%lld kB "
+		"numa_nodes=%d\n", mem_policy_name(mem_policy), peak_anon_huge_kb,
+		peak_hugetlb_kb, count_numa_nodes());
+}
@@ -0,0 +1,64 @@
+// ================================================================
+// PERCO2MEM.H
+//
+// Allocation of the large arrays:  the lattice matrices, the workspace's
+// scratch arrays (perco2ws.h), and the tiled labeler's label arrays
+// (perco2tile.h).
+//
+// With lattices of hundreds of megabytes, the depth-first search's scattered
+// reads of site_marks miss the TLB on most steps with 4 KB pages; with 2 MB
+// pages the TLB covers 512 times as much.  set_mem_policy() chooses how
+// arrays of LARGE_ALLOC_MIN bytes or more are obtained:
+//
+// * MEM_MALLOC:   from malloc(), as are smaller ones.  This is the default.
+// * MEM_THP:      mmap()ed, aligned to HUGE_PAGE_SIZE, and madvise()d
+//                 MADV_HUGEPAGE, so that the kernel backs them with
+//                 transparent huge pages if it can.  If madvise() fails
+//                 they are left with small pages.
+// * MEM_HUGETLB:  mmap()ed MAP_HUGETLB, from the pool of explicit huge pages
+//                 (/proc/sys/vm/nr_hugepages).  If the pool is too small,
+//                 they are obtained as for MEM_THP instead.
+//
+// NUMA:  the mmap()ed arrays are not touched when allocated, so each page is
+// placed on the NUMA node of the thread which first writes it.  The sweep's
+// workers (perco2sweep.h) create and lay out their own workspaces, so theirs
+// are on their own nodes, as are the strips of the label arrays which the
+// threaded labeler's threads fill.  malloc() instead may hand back memory
+// first touched by another thread, on another node.
+//
+// print_mem_report() says which way each array was actually obtained, and
+// how much of the process the kernel has backed with huge pages.
+// ================================================================
+
+#ifndef PERCO2MEM_H
+#define PERCO2MEM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define MEM_MALLOC  0
+#define MEM_THP     1
+#define MEM_HUGETLB 2
+
+#define HUGE_PAGE_SIZE  (2 << 20)
+#define LARGE_ALLOC_MIN HUGE_PAGE_SIZE
+
+// "malloc", "thp", or "hugetlb"; -1 for any other name.
+int   mem_policy_by_name(char* name);
+char* mem_policy_name(int policy);
+void  set_mem_policy(int policy);
+int   get_mem_policy(void);
+
+// As malloc_or_die() in putil.h, following the policy.  The array must be
+// released with large_free(), not free().  Either may be called from any
+// thread.
+void* large_alloc_or_die(size_t num_bytes);
+void  large_free(void* p);
+
+// For each way of obtaining arrays:  the number obtained and their total
+// size.  Then the most memory the kernel was seen to have backed with
+// transparent and with explicit huge pages, from /proc/self/smaps_rollup,
+// and the number of NUMA nodes.
+void print_mem_report(FILE* fp);
+
+#endif // PERCO2MEM_H
@@ -0,0 +1,251 @@
+// ================================================================
+// PERCO2PAD.C
+// Please see the comments in perco2pad.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "putil.h"
+#include "perco2lib.h"
+#include "perco2pad.h"
+#include "perco2ws.h"
+
+// ----------------------------------------------------------------
+// Lookup tables for an M by N padded lattice.  These depend only on M, N, and
+// the boundary condition, so they are kept in the workspace from one call to
+// the next and rebuilt only when one of those changes.  Being in the
+// workspace, they are per thread, so that threads may work on lattices of
+// different sizes at once, and are freed with it.
+//
+// * canon[k], for k a flat index into the (M+2) by (N+2) padded array, is the
+//   flat index of the same site in the interior.  For interior k, canon[k] is
+//   k.
+// * row_of[k] and col_of[k] are the lattice coordinates of that site.
+
+static void make_padded_tables(perco_ws_t* pws, int M, int N)
+{
+	int S  = N + 2;
+	int bc = get_boundary_condition();
+	int i, j, k;
+	int ij[d];
+
+	if ((M == pws->pad_M) && (N == pws->pad_N) && (bc == pws->pad_bc))
+		return;
+	perco_ws_reserve_padded(pws, M, N);
+
+	for (i = -1; i <= M; i++) {
+		for (j = -1; j <= N; j++) {
+			k = (i+1)*S + (j+1);
+			wrap_site(M, N, i, j, ij);
+			pws->pad_canon[k]  = (ij[0]+1)*S + (ij[1]+1);
+			pws->pad_row_of[k] = ij[0];
+			pws->pad_col_of[k] = ij[1];
+		}
+	}
+
+	pws->pad_M  = M;
+	pws->pad_N  = N;
+	pws->pad_bc = bc;
+}
+
+// The current workspace, with scratch and tables for an M by N lattice.
+static perco_ws_t* scratch(int M, int N)
+{
+	perco_ws_t* pws = perco_ws_current();
+	perco_ws_reserve(pws, M, N);
+	make_padded_tables(pws, M, N);
+	return pws;
+}
+
+// ----------------------------------------------------------------
+void get_bonded_neighbors_padded(int** vbonds, int** hbonds, int M, int N,
+	int A1[d], int neighbors[MAXNEI][d], int* pnumnei)
+{
+	int numnei = 0;
+	int A1i    = A1[0];
+	int A1j    = A1[1];
+	int S      = N + 2;
+	int k      = (A1i+1)*S + (A1j+1);
+	perco_ws_t* pws = perco_ws_current();
+	int* row_of;
+	int* col_of;
+
+	make_padded_tables(pws, M, N);
+	row_of = pws->pad_row_of;
+	col_of = pws->pad_col_of;
+
+	if (vbonds[A1i  ][A1j  ]) { // Down  bond
+		neighbors[numnei][0] = row_of[k+S];
+		neighbors[numnei][1] = col_of[k+S];
+		numnei++;
+	}
+
+	if (hbonds[A1i  ][A1j  ]) { // Right bond
+		neighbors[numnei][0] = row_of[k+1];
+		neighbors[numnei][1] = col_of[k+1];
+		numnei++;
+	}
+
+	if (vbonds[A1i-1][A1j  ]) { // Up    bond
+		neighbors[numnei][0] = row_of[k-S];
+		neighbors[numnei][1] = col_of[k-S];
+		numnei++;
+	}
+
+	if (hbonds[A1i  ][A1j-1]) { // Left  bond
+		neighbors[numnei][0] = row_of[k-1];
+		neighbors[numnei][1] = col_of[k-1];
+		numnei++;
+	}
+
+	*pnumnei = numnei;
+}
+
+// ----------------------------------------------------------------
+// Marks the cluster containing flat index x with mark_value, using an
+// iterative depth-first search.  Sites are marked when pushed.  Unmarked
+// sites are those whose mark is not mark_value; stack must have room for M*N
+// entries, and canon is the table above.
+static void mark_from_padded(int* marks, int* vb, int* hb, int* canon,
+	int S, int x, int mark_value, int* stack)
+{
+	int sp = 0;
+	int y;
+
+	marks[x] = mark_value;
+	stack[sp++] = x;
+	while (sp > 0) {
+		x = stack[--sp];
+
+		y = canon[x+S];                    // Down
+		if (vb[x] && (marks[y] != mark_value)) {
+			marks[y] = mark_value;
+			stack[sp++] = y;
+		}
+		y = canon[x+1];                    // Right
+		if (hb[x] && (marks[y] != mark_value)) {
+			marks[y] = mark_value;
+			stack[sp++] = y;
+		}
+		y = canon[x-S];                    // Up
+		if (vb[x-S] && (marks[y] != mark_value)) {
+			marks[y] = mark_value;
+			stack[sp++] = y;
+		}
+		y = canon[x-1];                    // Left
+		if (hb[x-1] && (marks[y] != mark_value)) {
+			marks[y] = mark_value;
+			stack[sp++] = y;
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+void mark_one_cluster_padded(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int mark_value)
+{
+	int S = N + 2;
+	perco_ws_t* pws = scratch(M, N);
+
+	fill_matrix(site_marks, M, N, SITECHAR);
+	mark_from_padded(&site_marks[-1][-1], &vbonds[-1][-1], &hbonds[-1][-1],
+		pws->pad_canon, S, (A1[0]+1)*S + (A1[1]+1), mark_value, pws->stack);
+}
+
+// ----------------------------------------------------------------
+// As in perco2fixed.c, each stack frame holds a site and the next of its four
+// directions to try, so that sites are visited in the same order as by the
+// recursive A1_oo_A2_aux() in perco2lib.c.
+int A1_oo_A2_padded(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d])
+{
+	int S = N + 2;
+	int* marks = &site_marks[-1][-1];
+	int* vb    = &vbonds[-1][-1];
+	int* hb    = &hbonds[-1][-1];
+	int x = (A1[0]+1)*S + (A1[1]+1);
+	int y = (A2[0]+1)*S + (A2[1]+1);
+	perco_ws_t* pws = scratch(M, N);
+	int* canon = pws->pad_canon;
+	int* frame_sites = pws->frame_sites;
+	unsigned char* frame_dirs = pws->frame_dirs;
+	int sp = 0;
+	int ctd = 0;
+
+	fill_matrix(site_marks, M, N, SITECHAR);
+
+	if (x == y) {
+		ctd = 1;
+		sp = 0;
+	}
+	else {
+		marks[x] = VISITEDCHAR;
+		frame_sites[sp] = x;
+		frame_dirs[sp] = 0;
+		sp++;
+	}
+
+	while (sp > 0) {
+		int k   = frame_sites[sp-1];
+		int dir = frame_dirs[sp-1];
+		int nbr = -1;
+
+		if (dir >= 4) {
+			sp--;
+			continue;
+		}
+		frame_dirs[sp-1] = dir + 1;
+
+		switch (dir) {
+		case 0: if (vb[k])   nbr = canon[k+S]; break; // Down
+		case 1: if (hb[k])   nbr = canon[k+1]; break; // Right
+		case 2: if (vb[k-S]) nbr = canon[k-S]; break; // Up
+		case 3: if (hb[k-1]) nbr = canon[k-1]; break; // Left
+		}
+
+		if ((nbr < 0) || (marks[nbr] == VISITEDCHAR))
+			continue;
+		if (nbr == y) {
+			ctd = 1;
+			break;
+		}
+		marks[nbr] = VISITEDCHAR;
+		frame_sites[sp] = nbr;
+		frame_dirs[sp] = 0;
+		sp++;
+	}
+
+	return ctd;
+}
+
+// ----------------------------------------------------------------
+void mark_cluster_numbers_padded(int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters)
+{
+	int S = N + 2;
+	int* marks = &site_marks[-1][-1];
+	int* vb    = &vbonds[-1][-1];
+	int* hb    = &hbonds[-1][-1];
+	perco_ws_t* pws = scratch(M, N);
+	int* canon = pws->pad_canon;
+	int* stack = pws->stack;
+	int cluster_number = 0;
+	int i, j, k;
+
+	fill_matrix(site_marks, M, N, -1);
+
+	for (i = 1; i <= M; i++) {
+		for (j = 1; j <= N; j++) {
+			k = i*S + j;
+			if (marks[k] >= 0) // Already marked
+				continue;
+			mark_from_padded(marks, vb, hb, canon, S, k, cluster_number,
+				stack);
+			cluster_number++;
+		}
+	}
+
+	if (pnum_clusters)
+		*pnum_clusters = cluster_number;
+}
@@ -0,0 +1,45 @@
+// ================================================================
+// PERCO2PAD.H
+//
+// These are versions of the perco2lib.h traversal routines for lattices
+// stored in the padded layout (see set_lattice_layout() in perco2lib.h).
+//
+// In the padded layout each matrix has a one-site halo:  matrix[i][j] is valid
+// for i = -1 .. M and j = -1 .. N, and after populate_bonds() the halo holds
+// copies of the opposite edge.  So the bond up from site (0,j) is
+// vbonds[-1][j], a copy of vbonds[M-1][j], and the bond left from (i,0) is
+// hbonds[i][-1], a copy of hbonds[i][N-1].  No bond lookup needs to wrap.
+//
+// Taking the halo into account, the rows are N+2 ints apart, so with
+// &matrix[-1][-1] as a flat array the four neighbors of flat index k are
+// k+(N+2), k+1, k-(N+2), and k-1.  When one of those lands in the halo, a
+// lookup table canon[] gives the flat index of the same site in the interior.
+// Thus a neighbor step is an add and a table lookup, with no wrap branches.
+//
+// With helical boundary conditions (see set_boundary_condition() in
+// perco2lib.h), the halo and canon[] follow the helical wrap instead, so these
+// routines handle either boundary condition with no changes to the traversal.
+//
+// Each routine here gives exactly the same results as its generic
+// counterpart in perco2lib.c.  The generic routines call these when they are
+// handed padded matrices, so callers need not call these directly.
+// ================================================================
+
+#ifndef PERCO2PAD_H
+#define PERCO2PAD_H
+
+#include "perco2lib.h"
+
+void get_bonded_neighbors_padded(int** vbonds, int** hbonds, int M, int N,
+	int A1[d], int neighbors[MAXNEI][d], int* pnumnei);
+
+void mark_one_cluster_padded(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int mark_value);
+
+int A1_oo_A2_padded(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d]);
+
+void mark_cluster_numbers_padded(int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters);
+
+#endif // PERCO2PAD_H
@@ -12,9 +12,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "putil.h"
 #include "perco2lib.h"
+#include "perco2mem.h"
 #include "rgb_matrix.h"
+#include "psdes.h"
 #include "rcmrand.h"
 
 #define WHITE_R 0xff
@@ -37,359 +41,638 @@
 #define BLUE_G  0x00
 #define BLUE_B  0xff
 
-static void plot_site(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b);
-static void maybe_plot_site(rgb_matrix_t* pixels, int i, int j,
-	int M, int N, int r, int g, int b);
-static void plot_hbond(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b);
-static void plot_vbond(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b);
-void plot_gap(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b);
-static void plot_block(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b);
+// ----------------------------------------------------------------
+// The five plot routines share one rasterizer.  Each pixel is written exactly
+// once, in a single pass over the image:  for each pixel row, the colors of
+// the sites, bonds, and blocks which the old layer-by-layer drawing would
+// have left on top are computed directly.  The image is split into bands of
+// pixel rows, one per thread; bands touch disjoint rows of the contiguous
+// pixel buffer, so the threads need no locking.
+
+#define STYLE_LATTICE          0 // Sites, A1 and A2, and bonds
+#define STYLE_ONE_CLUSTER      1 // Blocks in the visited cluster, bonds, sites
+#define STYLE_ONE_COMPACT      2 // One pixel per site, visited cluster only
+#define STYLE_ALL_CLUSTERS     3 // Blocks colored by cluster, bonds, sites
+#define STYLE_ALL_COMPACT      4 // One pixel per site, colored by cluster
+
+typedef struct _raster_job_t {
+	int style;
+	int** site_marks;
+	int** vbonds;
+	int** hbonds;
+	int M;
+	int N;
+	int* A1;
+	int* A2;
+	rgb_pixel_t* palette; // Indexed by cluster number, for STYLE_ALL_*;
+	                      // if null, colors are hashed from cluster numbers
+	int width;            // Image width in pixels
+	rgb_pixel_t* band;    // Output for pixel rows band_y0, band_y0+1, ...
+	int band_y0;
+	int row_start;        // Pixel rows [row_start, row_end) for one thread
+	int row_end;
+} raster_job_t;
+
+static const rgb_pixel_t white = { WHITE_R, WHITE_G, WHITE_B };
+static const rgb_pixel_t grey  = { GREY_R,  GREY_G,  GREY_B  };
+static const rgb_pixel_t black = { BLACK_R, BLACK_G, BLACK_B };
+static const rgb_pixel_t red   = { RED_R,   RED_G,   RED_B   };
+static const rgb_pixel_t blue  = { BLUE_R,  BLUE_G,  BLUE_B  };
 
 // ----------------------------------------------------------------
-// Write a PPM file.  Use 3x3 pixels for each site and two bonds:
+// Without a palette, which needs memory proportional to the number of
+// clusters, each cluster's color is a hash of its cluster number.  The
+// channels are in the same ranges as make_cluster_palette() uses.  Since
+// neighboring sites are usually in the same cluster, the last color is
+// remembered.
+typedef struct _color_cache_t {
+	int clno;
+	rgb_pixel_t color;
+} color_cache_t;
+
+static rgb_pixel_t hashed_cluster_color(int clno, int dark_and_light)
+{
+	unsigned word0, word1;
+	rgb_pixel_t color;
+
+	if (clno == 0)
+		return grey;
+	word0 = clno;
+	word1 = 0x9e3779b9;
+	psdes_hash_64(&word0, &word1);
+	if (dark_and_light) {
+		color.r = ( word0        & 0xff) % 255;
+		color.g = ((word0 >>  8) & 0xff) % 255;
+		color.b = ((word0 >> 16) & 0xff) % 255;
+	}
+	else {
+		color.r = 32 + ( word1        & 0xff) * 192 / 256;
+		color.g = 32 + ((word1 >>  8) & 0xff) * 192 / 256;
+		color.b = 32 + ((word1 >> 16) & 0xff) * 192 / 256;
+	}
+	return color;
+}
 
-// o - -
-// | . .
-// | . .
+static rgb_pixel_t cluster_color(raster_job_t* pjob, int clno,
+	color_cache_t* pcache)
+{
+	if (pjob->palette)
+		return pjob->palette[clno];
+	if (clno == pcache->clno)
+		return pcache->color;
+
+	pcache->clno  = clno;
+	pcache->color = hashed_cluster_color(clno,
+		pjob->style == STYLE_ALL_COMPACT);
+	return pcache->color;
+}
 
-// o - - o - - o . . o
-// | . . . . . | . . .
-// | . . . . . | . . .
-// o . . o - - o . . o
-// . . . | . . . . . .
-// . . . | . . . . . .
-// o - - o - - o - - o
-// . . . | . . . . . .
-// . . . | . . . . . .
-// o . . o . . o . . o
+// ----------------------------------------------------------------
+// One pixel row of a 3x3-per-site image.  Row u (0, 1, or 2) of site row i
+// is, for each site, one of:
+//
+//   u = 0:  site  hbond hbond
+//   u > 0:  vbond block block
+//
+// where the block color shows through wherever there is no bond.
+static void raster_row_3x3(raster_job_t* pjob, int y, rgb_pixel_t* out)
+{
+	color_cache_t cache = { -1, { 0, 0, 0 } };
+	int N = pjob->N;
+	int i = y / 3;
+	int u = y % 3;
+	int* marks = (i < pjob->M) ? pjob->site_marks[i] : 0;
+	int* vrow  = (i < pjob->M) ? pjob->vbonds[i]     : 0;
+	int* hrow  = (i < pjob->M) ? pjob->hbonds[i]     : 0;
+	rgb_pixel_t block, site;
+	int j;
+
+	// The bottom pixel row is below the last row of sites.
+	if (i == pjob->M) {
+		for (j = 0; j <= 3*N; j++)
+			out[j] = white;
+		return;
+	}
 
-// Fill the background in white.
-// Plot sites in blue.
-// Plot A1, A2 in red.
-// Plot bonds in black.
+	for (j = 0; j < N; j++, out += 3) {
+		switch (pjob->style) {
+		case STYLE_LATTICE:
+			block = white;
+			site  = blue;
+			if (((i == pjob->A1[0]) && (j == pjob->A1[1])) ||
+				((i == pjob->A2[0]) && (j == pjob->A2[1])))
+				site = red;
+			break;
+		case STYLE_ONE_CLUSTER:
+			block = (marks[j] == VISITEDCHAR) ? blue : white;
+			site  = black;
+			break;
+		default: // STYLE_ALL_CLUSTERS
+			block = cluster_color(pjob, marks[j], &cache);
+			site  = black;
+			break;
+		}
 
-void plot_lattice(int** site_marks, int** vbonds, int** hbonds,
-	int M, int N, int A1[d], int A2[d], char* image_file_name)
+		if (u == 0) {
+			out[0] = site;
+			out[1] = hrow[j] ? black : block;
+			out[2] = out[1];
+		}
+		else {
+			out[0] = vrow[j] ? black : block;
+			out[1] = block;
+			out[2] = block;
+		}
+	}
+	// The rightmost pixel column is right of the last column of sites.
+	out[0] = white;
+}
+
+// ----------------------------------------------------------------
+// One pixel row of a 1x1-per-site image.
+static void raster_row_compact(raster_job_t* pjob, int y, rgb_pixel_t* out)
 {
-	int i, j;
-	int pixel_height = 3*M+1;
-	int pixel_width  = 3*N+1;
-	rgb_matrix_t* pixels = allocate_rgb_matrix(pixel_height, pixel_width,
-		WHITE_R, WHITE_G, WHITE_B);
+	color_cache_t cache = { -1, { 0, 0, 0 } };
+	int N = pjob->N;
+	int* marks;
+	int j;
+
+	if (y == pjob->M) {
+		for (j = 0; j <= N; j++)
+			out[j] = white;
+		return;
+	}
 
-	// Plot sites in blue.
-	for (i = 0; i < M; i++)
+	marks = pjob->site_marks[y];
+	if (pjob->style == STYLE_ONE_COMPACT) {
+		for (j = 0; j < N; j++)
+			out[j] = (marks[j] == VISITEDCHAR) ? blue : white;
+	}
+	else {
 		for (j = 0; j < N; j++)
-			plot_site(pixels, i, j, BLUE_R, BLUE_G, BLUE_B);
+			out[j] = cluster_color(pjob, marks[j], &cache);
+	}
+	out[N] = white;
+}
 
-	// Plot A1, A2 in red.
-	maybe_plot_site(pixels, A1[0], A1[1], M, N, RED_R, RED_G, RED_B);
-	maybe_plot_site(pixels, A2[0], A2[1], M, N, RED_R, RED_G, RED_B);
+// ----------------------------------------------------------------
+static void* raster_band(void* pvjob)
+{
+	raster_job_t* pjob = (raster_job_t*)pvjob;
+	rgb_pixel_t* out = pjob->band +
+		(size_t)(pjob->row_start - pjob->band_y0) * pjob->width;
+	int y;
+
+	if ((pjob->style == STYLE_ONE_COMPACT) ||
+		(pjob->style == STYLE_ALL_COMPACT))
+	{
+		for (y = pjob->row_start; y < pjob->row_end; y++, out += pjob->width)
+			raster_row_compact(pjob, y, out);
+	}
+	else {
+		for (y = pjob->row_start; y < pjob->row_end; y++, out += pjob->width)
+			raster_row_3x3(pjob, y, out);
+	}
+	return 0;
+}
 
-	// Plot bonds in black.
-	// Horizontal bonds are indexed by the site left of them.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			if (hbonds[i][j])
-				plot_hbond(pixels, i, j, BLACK_R, BLACK_G, BLACK_B);
+// ----------------------------------------------------------------
+// Rasterizes pixel rows [y0, y1) into ptemplate->band, which holds pixel rows
+// starting at ptemplate->band_y0, using one thread per online CPU (but no
+// more threads than there are bands of a reasonable size).
+#define MAX_RASTER_THREADS 64
+#define MIN_RASTER_BAND    64
 
-	// Plot bonds in black.
-	// Vertical bonds are indexed by the site above them.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			if (vbonds[i][j])
-				plot_vbond(pixels, i, j, BLACK_R, BLACK_G, BLACK_B);
+static void raster_rows(raster_job_t* ptemplate, int y0, int y1)
+{
+	raster_job_t jobs   [MAX_RASTER_THREADS];
+	pthread_t    threads[MAX_RASTER_THREADS];
+	int nrows = y1 - y0;
+	int nthreads = num_online_cpus();
+	int t;
+
+	if (nthreads > MAX_RASTER_THREADS)
+		nthreads = MAX_RASTER_THREADS;
+	if (nthreads > nrows / MIN_RASTER_BAND)
+		nthreads = nrows / MIN_RASTER_BAND;
+	if (nthreads < 1)
+		nthreads = 1;
+
+	for (t = 0; t < nthreads; t++) {
+		jobs[t] = *ptemplate;
+		jobs[t].row_start = y0 + (int)((long long)nrows *  t    / nthreads);
+		jobs[t].row_end   = y0 + (int)((long long)nrows * (t+1) / nthreads);
+	}
 
-	write_rgb_matrix_to_ppm(pixels, image_file_name);
-	free_rgb_matrix(pixels);
+	// The calling thread does the last band itself.
+	for (t = 0; t < nthreads-1; t++) {
+		if (pthread_create(&threads[t], 0, raster_band, &jobs[t]) != 0) {
+			fprintf(stderr, "raster_rows:  pthread_create failed.\n");
+			exit(1);
+		}
+	}
+	raster_band(&jobs[nthreads-1]);
+	for (t = 0; t < nthreads-1; t++)
+		pthread_join(threads[t], 0);
 }
 
 // ----------------------------------------------------------------
-void plot_lattice_and_one_cluster(int** site_marks, int** vbonds, int** hbonds,
-	int M, int N, int A1[d], int A2[d], char* image_file_name)
+static void get_image_size(raster_job_t* pjob, int* pheight, int* pwidth)
 {
-	int i, j;
-	int pixel_height = 3*M+1;
-	int pixel_width  = 3*N+1;
-	rgb_matrix_t* pixels = allocate_rgb_matrix(pixel_height, pixel_width,
-		WHITE_R, WHITE_G, WHITE_B);
-
-	// Plot the cluster.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			if (site_marks[i][j] == VISITEDCHAR)
-				plot_block(pixels, i, j, BLUE_R, BLUE_G, BLUE_B);
+	int compact = (pjob->style == STYLE_ONE_COMPACT) ||
+		(pjob->style == STYLE_ALL_COMPACT);
+	*pheight = compact ? pjob->M+1 : 3*pjob->M+1;
+	*pwidth  = compact ? pjob->N+1 : 3*pjob->N+1;
+}
 
-	// Plot bonds in black.
-	// Horizontal bonds are indexed by the site left of them.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			if (hbonds[i][j])
-				plot_hbond(pixels, i, j, BLACK_R, BLACK_G, BLACK_B);
+// ----------------------------------------------------------------
+// Rasterizes the whole image in memory and writes it out.
+static void render_and_write(raster_job_t* ptemplate, char* image_file_name)
+{
+	rgb_matrix_t* pixels;
+	int height, width;
 
-	// Plot bonds in black.
-	// Vertical bonds are indexed by the site above them.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			if (vbonds[i][j])
-				plot_vbond(pixels, i, j, BLACK_R, BLACK_G, BLACK_B);
+	get_image_size(ptemplate, &height, &width);
+	pixels = allocate_rgb_matrix_unfilled(height, width);
+	ptemplate->width   = width;
+	ptemplate->band    = pixels->data[0];
+	ptemplate->band_y0 = 0;
 
-	// Plot sites.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			plot_site(pixels, i, j, BLACK_R, BLACK_G, BLACK_B);
+	raster_rows(ptemplate, 0, height);
 
 	write_rgb_matrix_to_ppm(pixels, image_file_name);
 	free_rgb_matrix(pixels);
 }
 
 // ----------------------------------------------------------------
-void plot_one_cluster_compactly(int** site_marks, int** vbonds, int** hbonds,
-	int M, int N, int A1[d], int A2[d], char* image_file_name)
+// Rasterizes the image one band of STREAM_BAND_ROWS pixel rows at a time,
+// writing each band out before doing the next, so that the memory used is
+// proportional to the image width and not to its height.
+#define STREAM_BAND_ROWS 192
+
+static void render_and_stream(raster_job_t* ptemplate, char* image_file_name)
 {
-	int i, j;
-	int pixel_height = M+1;
-	int pixel_width  = N+1;
-	rgb_matrix_t* pixels = allocate_rgb_matrix(pixel_height, pixel_width,
-		WHITE_R, WHITE_G, WHITE_B);
-
-	// Plot the clusters.
-	for (i = 0; i < M; i++) {
-		for (j = 0; j < N; j++) {
-			if (site_marks[i][j] == VISITEDCHAR) {
-				pixels->data[i][j].r = BLUE_R;
-				pixels->data[i][j].g = BLUE_G;
-				pixels->data[i][j].b = BLUE_B;
-			}
-		}
+	rgb_pixel_t* band;
+	FILE* fp;
+	int height, width, y0, y1;
+
+	get_image_size(ptemplate, &height, &width);
+	band = (rgb_pixel_t*)malloc_or_die(
+		(size_t)STREAM_BAND_ROWS * width * sizeof(rgb_pixel_t));
+	fp = begin_ppm_stream(image_file_name, height, width);
+	ptemplate->width = width;
+	ptemplate->band  = band;
+
+	for (y0 = 0; y0 < height; y0 = y1) {
+		y1 = y0 + STREAM_BAND_ROWS;
+		if (y1 > height)
+			y1 = height;
+		ptemplate->band_y0 = y0;
+		raster_rows(ptemplate, y0, y1);
+		write_ppm_stream_rows(fp, band, y1 - y0, width, image_file_name);
 	}
 
-	write_rgb_matrix_to_ppm(pixels, image_file_name);
-	free_rgb_matrix(pixels);
+	end_ppm_stream(fp, image_file_name);
+	free(band);
 }
 
 // ----------------------------------------------------------------
-void plot_lattice_and_all_clusters(int** site_marks, int** vbonds, int** hbonds,
-	int M, int N, int A1[d], int A2[d], char* image_file_name)
+static void init_raster_job(raster_job_t* pjob, int style,
+	int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d])
+{
+	pjob->style      = style;
+	pjob->site_marks = site_marks;
+	pjob->vbonds     = vbonds;
+	pjob->hbonds     = hbonds;
+	pjob->M          = M;
+	pjob->N          = N;
+	pjob->A1         = A1;
+	pjob->A2         = A2;
+	pjob->palette    = 0;
+	pjob->width      = 0;
+	pjob->band       = 0;
+	pjob->band_y0    = 0;
+}
+
+// ----------------------------------------------------------------
+// Random colors for each cluster number.  Cluster number 0 is drawn in grey.
+// The random numbers are drawn serially, in the same order as always, so a
+// given seed gives the same picture.
+static rgb_pixel_t* make_cluster_palette(int** site_marks, int M, int N,
+	int dark_and_light)
 {
-	int i, j;
-	int pixel_height = 3*M+1;
-	int pixel_width  = 3*N+1;
-	rgb_matrix_t* pixels = allocate_rgb_matrix(pixel_height, pixel_width,
-		WHITE_R, WHITE_G, WHITE_B);
 	int max_clno = 0;
-	int* reds;
-	int* greens;
-	int* blues;
+	rgb_pixel_t* palette;
+	int i, j;
 
 	// Find the number of clusters.
 	for (i = 0; i < M; i++)
 		for (j = 0; j < N; j++)
 			if (site_marks[i][j] > max_clno)
 				max_clno = site_marks[i][j];
-	reds   = (int *)malloc_or_die((max_clno+1)*sizeof(int));
-	greens = (int *)malloc_or_die((max_clno+1)*sizeof(int));
-	blues  = (int *)malloc_or_die((max_clno+1)*sizeof(int));
+	palette = (rgb_pixel_t*)malloc_or_die((max_clno+1)*sizeof(rgb_pixel_t));
 
+	palette[0] = grey;
 	for (i = 1; i <= max_clno; i++) {
-#if 0
-		reds  [i] = IMODRANDOM(255);
-		greens[i] = IMODRANDOM(255);
-		blues [i] = IMODRANDOM(255);
-#else
-		reds  [i] = (unsigned char)RANDRANGE(32,224);
-		greens[i] = (unsigned char)RANDRANGE(32,224);
-		blues [i] = (unsigned char)RANDRANGE(32,224);
-#endif
-	}
-
-	// Plot the clusters.
-	for (i = 0; i < M; i++) {
-		for (j = 0; j < N; j++) {
-			if (site_marks[i][j] == 0) {
-				plot_block(pixels, i, j, GREY_R, GREY_G, GREY_B);
-			}
-			else {
-				int clno = site_marks[i][j];
-				plot_block(pixels, i, j, reds[clno], greens[clno], blues[clno]);
-			}
+		if (dark_and_light) {
+			palette[i].r = IMODRANDOM(255);
+			palette[i].g = IMODRANDOM(255);
+			palette[i].b = IMODRANDOM(255);
+		}
+		else {
+			palette[i].r = (unsigned char)RANDRANGE(32,224);
+			palette[i].g = (unsigned char)RANDRANGE(32,224);
+			palette[i].b = (unsigned char)RANDRANGE(32,224);
 		}
 	}
+	return palette;
+}
 
-	// Plot bonds in black.
-	// Horizontal bonds are indexed by the site left of them.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			if (hbonds[i][j])
-				plot_hbond(pixels, i, j, BLACK_R, BLACK_G, BLACK_B);
+// ----------------------------------------------------------------
+// Write a PPM file.  Use 3x3 pixels for each site and two bonds:
 
-	// Plot bonds in black.
-	// Vertical bonds are indexed by the site above them.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			if (vbonds[i][j])
-				plot_vbond(pixels, i, j, BLACK_R, BLACK_G, BLACK_B);
+// o - -
+// | . .
+// | . .
 
-	// Plot sites.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			plot_site(pixels, i, j, BLACK_R, BLACK_G, BLACK_B);
+// o - - o - - o . . o
+// | . . . . . | . . .
+// | . . . . . | . . .
+// o . . o - - o . . o
+// . . . | . . . . . .
+// . . . | . . . . . .
+// o - - o - - o - - o
+// . . . | . . . . . .
+// . . . | . . . . . .
+// o . . o . . o . . o
 
-	write_rgb_matrix_to_ppm(pixels, image_file_name);
-	free_rgb_matrix(pixels);
-	free(reds);
-	free(greens);
-	free(blues);
+// Fill the background in white.
+// Plot sites in blue.
+// Plot A1, A2 in red.
+// Plot bonds in black.
+
+void plot_lattice(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d], char* image_file_name)
+{
+	raster_job_t job;
+	init_raster_job(&job, STYLE_LATTICE, site_marks, vbonds, hbonds,
+		M, N, A1, A2);
+	render_and_write(&job, image_file_name);
 }
 
 // ----------------------------------------------------------------
-void plot_all_clusters_compactly(int** site_marks, int** vbonds, int** hbonds,
+// Plot the cluster marked VISITEDCHAR in blue blocks, on white.
+// Plot bonds and sites in black.
+void plot_lattice_and_one_cluster(int** site_marks, int** vbonds, int** hbonds,
 	int M, int N, int A1[d], int A2[d], char* image_file_name)
 {
-	int i, j;
-	int pixel_height = M+1;
-	int pixel_width  = N+1;
-	rgb_matrix_t* pixels = allocate_rgb_matrix(pixel_height, pixel_width,
-		WHITE_R, WHITE_G, WHITE_B);
-	int max_clno = 0;
-	int* reds;
-	int* greens;
-	int* blues;
-
-	// Find the number of clusters.
-	for (i = 0; i < M; i++)
-		for (j = 0; j < N; j++)
-			if (site_marks[i][j] > max_clno)
-				max_clno = site_marks[i][j];
-	reds   = (int *)malloc_or_die((max_clno+1)*sizeof(int));
-	greens = (int *)malloc_or_die((max_clno+1)*sizeof(int));
-	blues  = (int *)malloc_or_die((max_clno+1)*sizeof(int));
+	raster_job_t job;
+	init_raster_job(&job, STYLE_ONE_CLUSTER, site_marks, vbonds, hbonds,
+		M, N, A1, A2);
+	render_and_write(&job, image_file_name);
+}
 
-	for (i = 1; i <= max_clno; i++) {
-#if 1
-		reds  [i] = IMODRANDOM(255);
-		greens[i] = IMODRANDOM(255);
-		blues [i] = IMODRANDOM(255);
-#else
-		reds  [i] = (unsigned char)RANDRANGE(32,224);
-		greens[i] = (unsigned char)RANDRANGE(32,224);
-		blues [i] = (unsigned char)RANDRANGE(32,224);
-#endif
-	}
+// ----------------------------------------------------------------
+void plot_one_cluster_compactly(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d], char* image_file_name)
+{
+	raster_job_t job;
+	init_raster_job(&job, STYLE_ONE_COMPACT, site_marks, vbonds, hbonds,
+		M, N, A1, A2);
+	render_and_write(&job, image_file_name);
+}
 
-	// Plot the clusters.
-	for (i = 0; i < M; i++) {
-		for (j = 0; j < N; j++) {
-			if (site_marks[i][j] == 0) {
-				pixels->data[i][j].r = GREY_R;
-				pixels->data[i][j].g = GREY_G;
-				pixels->data[i][j].b = GREY_B;
-			}
-			else {
-				int clno = site_marks[i][j];
-				pixels->data[i][j].r = reds  [clno];
-				pixels->data[i][j].g = greens[clno];
-				pixels->data[i][j].b = blues [clno];
-			}
-		}
-	}
+// ----------------------------------------------------------------
+// Plot each cluster in blocks of a random color.
+// Plot bonds and sites in black.
+void plot_lattice_and_all_clusters(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d], char* image_file_name)
+{
+	raster_job_t job;
+	init_raster_job(&job, STYLE_ALL_CLUSTERS, site_marks, vbonds, hbonds,
+		M, N, A1, A2);
+	job.palette = make_cluster_palette(site_marks, M, N, 0);
+	render_and_write(&job, image_file_name);
+	free(job.palette);
+}
 
-	write_rgb_matrix_to_ppm(pixels, image_file_name);
-	free_rgb_matrix(pixels);
-	free(reds);
-	free(greens);
-	free(blues);
+// ----------------------------------------------------------------
+void plot_all_clusters_compactly(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int A1[d], int A2[d], char* image_file_name)
+{
+	raster_job_t job;
+	init_raster_job(&job, STYLE_ALL_COMPACT, site_marks, vbonds, hbonds,
+		M, N, A1, A2);
+	job.palette = make_cluster_palette(site_marks, M, N, 1);
+	render_and_write(&job, image_file_name);
+	free(job.palette);
 }
 
 // ----------------------------------------------------------------
-static void plot_site(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b)
+// The streaming versions.  Cluster colors are hashed from cluster numbers
+// rather than drawn at random, so these use no memory proportional to the
+// lattice size beyond the caller's matrices.
+void plot_lattice_and_all_clusters_streaming(int** site_marks,
+	int** vbonds, int** hbonds, int M, int N, int A1[d], int A2[d],
+	char* image_file_name)
 {
-	pixels->data[3*i][3*j].r = r;
-	pixels->data[3*i][3*j].g = g;
-	pixels->data[3*i][3*j].b = b;
+	raster_job_t job;
+	init_raster_job(&job, STYLE_ALL_CLUSTERS, site_marks, vbonds, hbonds,
+		M, N, A1, A2);
+	render_and_stream(&job, image_file_name);
 }
 
 // ----------------------------------------------------------------
-static void maybe_plot_site(rgb_matrix_t* pixels, int i, int j,
-	int M, int N, int r, int g, int b)
+void plot_all_clusters_compactly_streaming(int** site_marks,
+	int** vbonds, int** hbonds, int M, int N, int A1[d], int A2[d],
+	char* image_file_name)
 {
-	if ((0 <= i) && (i < M)) {
-		if ((0 <= j) && (j < M)) {
-			pixels->data[3*i][3*j].r = r;
-			pixels->data[3*i][3*j].g = g;
-			pixels->data[3*i][3*j].b = b;
-		}
-	}
+	raster_job_t job;
+	init_raster_job(&job, STYLE_ALL_COMPACT, site_marks, vbonds, hbonds,
+		M, N, A1, A2);
+	render_and_stream(&job, image_file_name);
+}
+
+// ================================================================
+// Downsampled overview images.  Each level summarizes blocks of side b, with
+// b = k at level 0 and doubling at each level after.  Level 0 is computed in
+// one pass over the lattice, block by block; each later level is computed
+// from the one before it, each cell from the (up to) 2x2 cells under it.
+
+typedef struct _pyramid_cell_t {
+	int clno;    // Majority (plurality) cluster number
+	int clcount; // Number of the block's sites in that cluster
+	int largest; // Number of the block's sites in the largest cluster
+	int bonds;   // Number of open bonds indexed by the block's sites
+	int sites;   // Number of sites in the block
+} pyramid_cell_t;
+
+static int compare_ints(const void* pva, const void* pvb)
+{
+	int a = *(const int*)pva;
+	int b = *(const int*)pvb;
+	return (a < b) ? -1 : (a > b) ? 1 : 0;
 }
 
 // ----------------------------------------------------------------
-// Horizontal bonds are indexed by the site left of them.
-static void plot_hbond(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b)
+static void make_pyramid_level_0(pyramid_cell_t* cells, int rows, int cols,
+	int** site_marks, int** vbonds, int** hbonds, int M, int N,
+	int C_clno, int k)
 {
-	int ti = 3*i;
-	int tj = 3*j;
-	int v;
-
-	for (v = 1; v <= 2; v++) {
-		pixels->data[ti][tj+v].r = r;
-		pixels->data[ti][tj+v].g = g;
-		pixels->data[ti][tj+v].b = b;
+	// A block has at most k by k sites, and no more than the lattice.
+	int* labels = (int*)large_alloc_or_die((size_t)(k < M ? k : M) *
+		(k < N ? k : N) * sizeof(int));
+	int bi, bj, i, j, n, run, m;
+
+	for (bi = 0; bi < rows; bi++) {
+		for (bj = 0; bj < cols; bj++) {
+			pyramid_cell_t* pcell = &cells[bi*cols + bj];
+			pcell->largest = 0;
+			pcell->bonds   = 0;
+			n = 0;
+			for (i = bi*k; (i < (bi+1)*k) && (i < M); i++) {
+				for (j = bj*k; (j < (bj+1)*k) && (j < N); j++) {
+					labels[n++] = site_marks[i][j];
+					if (site_marks[i][j] == C_clno)
+						pcell->largest++;
+					pcell->bonds += vbonds[i][j] + hbonds[i][j];
+				}
+			}
+			pcell->sites = n;
+
+			// The plurality label is the longest run after sorting.
+			qsort(labels, n, sizeof(int), compare_ints);
+			pcell->clno    = labels[0];
+			pcell->clcount = 0;
+			for (m = 0; m < n; m += run) {
+				for (run = 1; (m+run < n) && (labels[m+run] == labels[m]); run++)
+					;
+				if (run > pcell->clcount) {
+					pcell->clno    = labels[m];
+					pcell->clcount = run;
+				}
+			}
+		}
 	}
+	large_free(labels);
 }
 
 // ----------------------------------------------------------------
-// Vertical bonds are indexed by the site above them.
-static void plot_vbond(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b)
+// The sums are exact.  The majority cluster of a cell is taken to be the one
+// with the most sites among its children's majority clusters, which is
+// usually but not always the true plurality over the whole block.
+static void make_pyramid_level(pyramid_cell_t* cells, int rows, int cols,
+	pyramid_cell_t* below, int brows, int bcols)
 {
-	int ti = 3*i;
-	int tj = 3*j;
-	int u;
-
-	for (u = 1; u <= 2; u++) {
-		pixels->data[ti+u][tj].r = r;
-		pixels->data[ti+u][tj].g = g;
-		pixels->data[ti+u][tj].b = b;
+	int bi, bj, u, v, w, nkids;
+	pyramid_cell_t* kids[4];
+
+	for (bi = 0; bi < rows; bi++) {
+		for (bj = 0; bj < cols; bj++) {
+			pyramid_cell_t* pcell = &cells[bi*cols + bj];
+			nkids = 0;
+			for (u = 2*bi; (u < 2*bi+2) && (u < brows); u++)
+				for (v = 2*bj; (v < 2*bj+2) && (v < bcols); v++)
+					kids[nkids++] = &below[u*bcols + v];
+
+			pcell->largest = pcell->bonds = pcell->sites = 0;
+			pcell->clno    = kids[0]->clno;
+			pcell->clcount = 0;
+			for (u = 0; u < nkids; u++) {
+				int count = 0;
+				pcell->largest += kids[u]->largest;
+				pcell->bonds   += kids[u]->bonds;
+				pcell->sites   += kids[u]->sites;
+				for (w = 0; w < nkids; w++)
+					if (kids[w]->clno == kids[u]->clno)
+						count += kids[w]->clcount;
+				if (count > pcell->clcount) {
+					pcell->clno    = kids[u]->clno;
+					pcell->clcount = count;
+				}
+			}
+		}
 	}
 }
 
 // ----------------------------------------------------------------
-void plot_gap(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b)
+// The three images for one level:  majority cluster, in the same colors as
+// plot_all_clusters_compactly_streaming(); fraction of sites in the largest
+// cluster, from white (none) to blue (all); and bond density, from white (no
+// open bonds) to black (all open).
+static void write_pyramid_level(pyramid_cell_t* cells, int rows, int cols,
+	int b, char* prefix)
 {
-	int ti = 3*i;
-	int tj = 3*j;
-	int u, v;
-
-	for (u = 1; u <= 2; u++) {
-		for (v = 1; v <= 2; v++) {
-			pixels->data[ti+u][tj+v].r = r;
-			pixels->data[ti+u][tj+v].g = g;
-			pixels->data[ti+u][tj+v].b = b;
+	char* names[3] = { "majority", "largest", "bonds" };
+	char file_name[1024];
+	rgb_matrix_t* pixels = allocate_rgb_matrix_unfilled(rows, cols);
+	int kind, i, j;
+
+	for (kind = 0; kind < 3; kind++) {
+		for (i = 0; i < rows; i++) {
+			for (j = 0; j < cols; j++) {
+				pyramid_cell_t* pcell = &cells[i*cols + j];
+				rgb_pixel_t* ppixel = &pixels->data[i][j];
+				int level;
+				if (kind == 0) {
+					*ppixel = hashed_cluster_color(pcell->clno, 1);
+				}
+				else if (kind == 1) {
+					level = 255 - 255 * pcell->largest / pcell->sites;
+					ppixel->r = level;
+					ppixel->g = level;
+					ppixel->b = 255;
+				}
+				else {
+					level = 255 - 255 * pcell->bonds / (2 * pcell->sites);
+					ppixel->r = level;
+					ppixel->g = level;
+					ppixel->b = level;
+				}
+			}
 		}
+		snprintf(file_name, sizeof(file_name), "%s_b%d_%s.ppm",
+			prefix, b, names[kind]);
+		write_rgb_matrix_to_ppm(pixels, file_name);
+		printf("Wrote %s (%dx%d).\n", file_name, cols, rows);
 	}
+	free_rgb_matrix(pixels);
 }
 
 // ----------------------------------------------------------------
-static void plot_block(rgb_matrix_t* pixels, int i, int j,
-	int r, int g, int b)
+// With small k on a giant lattice, level 0 may have more cells than
+// malloc_or_die() can ask for, so the levels come from large_alloc_or_die().
+void plot_pyramid(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int C_clno, int k, int levels, char* prefix)
 {
-	int ti = 3*i;
-	int tj = 3*j;
-	int u, v;
-
-	for (u = 0; u <= 2; u++) {
-		for (v = 0; v <= 2; v++) {
-			pixels->data[ti+u][tj+v].r = r;
-			pixels->data[ti+u][tj+v].g = g;
-			pixels->data[ti+u][tj+v].b = b;
-		}
+	int rows = (M + k - 1) / k;
+	int cols = (N + k - 1) / k;
+	int b = k;
+	int level, brows, bcols;
+	pyramid_cell_t* cells;
+	pyramid_cell_t* below;
+
+	cells = (pyramid_cell_t*)large_alloc_or_die(
+		(size_t)rows * cols * sizeof(pyramid_cell_t));
+	make_pyramid_level_0(cells, rows, cols, site_marks, vbonds, hbonds,
+		M, N, C_clno, k);
+	write_pyramid_level(cells, rows, cols, b, prefix);
+
+	for (level = 1; level < levels; level++) {
+		if ((rows == 1) && (cols == 1))
+			break;
+		below = cells;
+		brows = rows;
+		bcols = cols;
+		rows  = (brows + 1) / 2;
+		cols  = (bcols + 1) / 2;
+		b    *= 2;
+		cells = (pyramid_cell_t*)large_alloc_or_die(
+			(size_t)rows * cols * sizeof(pyramid_cell_t));
+		make_pyramid_level(cells, rows, cols, below, brows, bcols);
+		large_free(below);
+		write_pyramid_level(cells, rows, cols, b, prefix);
 	}
+	large_free(cells);
 }
@@ -38,4 +38,36 @@ void plot_all_clusters_compactly(int** site_marks, int** vbonds, int** hbonds,
 	int M, int N, int A1[d], int A2[d],
 	char* image_file_name);
 
+// These are the same as plot_lattice_and_all_clusters() and
+// plot_all_clusters_compactly(), except that the image is never held in
+// memory all at once:  it is produced a band of rows at a time, each band
+// being written to the file before the next is drawn.  The memory used is
+// proportional to the image width, whatever the image height.  Cluster colors
+// are a fixed hash of the cluster number rather than random.
+void plot_lattice_and_all_clusters_streaming(int** site_marks,
+	int** vbonds, int** hbonds, int M, int N, int A1[d], int A2[d],
+	char* image_file_name);
+
+void plot_all_clusters_compactly_streaming(int** site_marks,
+	int** vbonds, int** hbonds, int M, int N, int A1[d], int A2[d],
+	char* image_file_name);
+
+// Writes downsampled overview images of a labeled lattice.  At level 0 each
+// pixel summarizes a k by k block of sites; each level after that halves the
+// image in each direction, up to the given number of levels or until the
+// image is one pixel.  For each level with block side b, three images are
+// written:
+//
+// * {prefix}_b{b}_majority.ppm:  each block in the color of its majority
+//   cluster.  (Above level 0, this is the majority among the majority
+//   clusters of the blocks under it, which is nearly always the same.)
+// * {prefix}_b{b}_largest.ppm:  the fraction of the block's sites which are
+//   in the largest cluster, cluster number C_clno, from white to blue.
+// * {prefix}_b{b}_bonds.ppm:  the fraction of the block's bonds which are
+//   open, from white to black.
+//
+// mark_cluster_numbers() and get_cluster_sizes() must have been called first.
+void plot_pyramid(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int C_clno, int k, int levels, char* prefix);
+
 #endif // PERCO2PLOT_H
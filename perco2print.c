@@ -161,7 +161,6 @@ void print_lattice_and_cluster_numbers(int** site_marks,
 	int** vbonds, int** hbonds, int M, int N)
 {
 	int i, j;
-	int ij[d];
 
 	for (j = 0; j < N; j++)
 		printf("oooo");
@@ -180,9 +179,6 @@ void print_lattice_and_cluster_numbers(int** site_marks,
 		// Horizontal bonds are indexed by the site left of them.
 		// Indices are [0..M][0..N-1]
 		for (j = 0; j < N; j++) {
-			ij[0] = i;
-			ij[1] = j;
-
 			printf("%d", site_marks[i][j]);
 			if (j < N) {
 				if (hbonds[i][j])
@@ -0,0 +1,297 @@
+// ================================================================
+// PERCO2SWEEP.C
+// Please see the comments in perco2sweep.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "putil.h"
+#include "perco2lib.h"
+#include "perco2sweep.h"
+#include "perco2ws.h"
+#include "rcmrand.h"
+
+// ----------------------------------------------------------------
+typedef struct _sweep_task_t {
+	int point;
+	int chunk;
+	int reps;
+} sweep_task_t;
+
+typedef struct _task_deque_t {
+	pthread_mutex_t mutex;
+	int* tasks;
+	int  head;  // The owner takes from here
+	int  tail;  // Thieves take from tail-1
+} task_deque_t;
+
+typedef struct _sweep_t {
+	sweep_point_t*     points;
+	int                num_points;
+	int                max_M, max_N;  // Over all the points
+	sweep_task_t*      tasks;
+	task_deque_t*      deques;
+	int                num_workers;
+	unsigned long long seed;
+	sweep_estimator_t* pestimator;
+	sweep_emitter_t*   pemitter;
+	void*              parg;
+	perco_ctx_t*       ptemplate;
+	pthread_mutex_t    results_mutex;
+	int                next_to_emit;
+} sweep_t;
+
+typedef struct _sweep_worker_t {
+	sweep_t* psweep;
+	int      w;
+	int      tasks_run;
+	int      steals;
+} sweep_worker_t;
+
+// ----------------------------------------------------------------
+// The generator seed for one chunk of one point:  SplitMix64 of the three
+// together, so that nearby seeds and chunk numbers give unrelated streams.
+static uint64_t task_seed(unsigned long long seed, int point, int chunk)
+{
+	uint64_t z = (uint64_t)seed + 0x9e3779b97f4a7c15ULL *
+		(((uint64_t)point << 32) + (uint64_t)chunk + 1);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// ----------------------------------------------------------------
+static int take_own_task(task_deque_t* pdeque)
+{
+	int task = -1;
+	pthread_mutex_lock(&pdeque->mutex);
+	if (pdeque->head < pdeque->tail)
+		task = pdeque->tasks[pdeque->head++];
+	pthread_mutex_unlock(&pdeque->mutex);
+	return task;
+}
+
+static int steal_task(task_deque_t* pdeque)
+{
+	int task = -1;
+	pthread_mutex_lock(&pdeque->mutex);
+	if (pdeque->head < pdeque->tail)
+		task = pdeque->tasks[--pdeque->tail];
+	pthread_mutex_unlock(&pdeque->mutex);
+	return task;
+}
+
+// ----------------------------------------------------------------
+// Adds one chunk's result to its point, then emits every complete point not
+// yet emitted which has no incomplete point before it.
+static void record_result(sweep_t* psweep, sweep_task_t* ptask, double value)
+{
+	sweep_point_t* ppoint = &psweep->points[ptask->point];
+
+	pthread_mutex_lock(&psweep->results_mutex);
+	ppoint->sum       += value * ptask->reps;
+	ppoint->reps_done += ptask->reps;
+	ppoint->chunks_left--;
+	while ((psweep->next_to_emit < psweep->num_points) &&
+		(psweep->points[psweep->next_to_emit].chunks_left == 0))
+	{
+		if (psweep->pemitter)
+			psweep->pemitter(&psweep->points[psweep->next_to_emit],
+				psweep->parg);
+		psweep->next_to_emit++;
+	}
+	pthread_mutex_unlock(&psweep->results_mutex);
+}
+
+// ----------------------------------------------------------------
+static void* sweep_worker(void* pvworker)
+{
+	sweep_worker_t* pworker = (sweep_worker_t*)pvworker;
+	sweep_t* psweep = pworker->psweep;
+	int W = psweep->num_workers;
+	perco_ws_t* pws;
+	sweep_task_t*  ptask;
+	sweep_point_t* ppoint;
+	perco_ctx_t* pctx = 0;
+	double value;
+	int task, v, k;
+
+	if (psweep->ptemplate) {
+		pctx = perco_ctx_alloc(psweep->ptemplate->rng.which, 0);
+		pctx->bc               = psweep->ptemplate->bc;
+		pctx->layout           = psweep->ptemplate->layout;
+		pctx->labeling_threads = psweep->ptemplate->labeling_threads;
+		perco_ctx_bind(pctx);
+	}
+
+	// The workspace is the context's, if any, else the thread's own.  It is
+	// sized once for the largest lattice of the sweep, so that no task
+	// reallocates it.
+	pws = perco_ws_current();
+	perco_ws_shape(pws, psweep->max_M, psweep->max_N);
+
+	for (;;) {
+		task = take_own_task(&psweep->deques[pworker->w]);
+
+		// Look for a victim, starting with the next worker over so that
+		// thieves spread out.  There are no new tasks once the sweep starts,
+		// so if every deque is empty the worker is done.
+		for (k = 1; (task < 0) && (k < W); k++) {
+			v = (pworker->w + k) % W;
+			task = steal_task(&psweep->deques[v]);
+			if (task >= 0)
+				pworker->steals++;
+		}
+		if (task < 0)
+			break;
+
+		ptask  = &psweep->tasks[task];
+		ppoint = &psweep->points[ptask->point];
+
+		perco_ws_shape(pws, ppoint->M, ppoint->N);
+
+		SRANDOM(task_seed(psweep->seed, ptask->point, ptask->chunk));
+		value = psweep->pestimator(pws->site_marks, pws->vbonds, pws->hbonds,
+			ppoint->M, ppoint->N, ppoint->p, ptask->reps, psweep->parg);
+		record_result(psweep, ptask, value);
+		pworker->tasks_run++;
+	}
+
+	if (pctx) {
+		perco_ctx_bind(0);
+		perco_ctx_free(pctx);
+	}
+	return 0;
+}
+
+// ----------------------------------------------------------------
+void run_workers(int num_workers, void* (*pworker)(void*), void* args,
+	int arg_bytes)
+{
+	pthread_t* threads;
+	pthread_attr_t attr;
+	int w;
+
+	if (num_workers < 1)
+		num_workers = num_online_cpus();
+	threads = (pthread_t*)malloc_or_die(num_workers * sizeof(pthread_t));
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, SWEEP_STACK_BYTES);
+	for (w = 0; w < num_workers; w++) {
+		if (pthread_create(&threads[w], &attr, pworker,
+			(char*)args + (size_t)w * arg_bytes) != 0)
+		{
+			fprintf(stderr, "run_workers:  pthread_create failed.\n");
+			exit(1);
+		}
+	}
+	for (w = 0; w < num_workers; w++)
+		pthread_join(threads[w], 0);
+	pthread_attr_destroy(&attr);
+	free(threads);
+}
+
+// ----------------------------------------------------------------
+void run_sweep(sweep_point_t* points, int num_points, int chunk_reps,
+	int num_workers, unsigned long long seed, perco_ctx_t* ptemplate,
+	sweep_estimator_t* pestimator, sweep_emitter_t* pemitter, void* parg,
+	sweep_stats_t* pstats)
+{
+	sweep_t sweep;
+	sweep_worker_t* workers;
+	int num_tasks = 0;
+	int i, w, t, chunk, reps_left;
+	int total_steals = 0;
+	double t0 = get_sys_time_float();
+
+	if (chunk_reps < 1)
+		chunk_reps = 1;
+	if (num_workers < 1)
+		num_workers = num_online_cpus();
+
+	// Cut each point's reps into tasks, in grid order.
+	sweep.max_M = 0;
+	sweep.max_N = 0;
+	for (i = 0; i < num_points; i++) {
+		num_tasks += (points[i].reps + chunk_reps - 1) / chunk_reps;
+		if (points[i].M > sweep.max_M)
+			sweep.max_M = points[i].M;
+		if (points[i].N > sweep.max_N)
+			sweep.max_N = points[i].N;
+	}
+	sweep.tasks = (sweep_task_t*)malloc_or_die(
+		num_tasks * sizeof(sweep_task_t));
+	for (i = 0, t = 0; i < num_points; i++) {
+		points[i].sum         = 0.0;
+		points[i].reps_done   = 0;
+		points[i].chunks_left = 0;
+		for (chunk = 0, reps_left = points[i].reps; reps_left > 0;
+			chunk++, t++)
+		{
+			sweep.tasks[t].point = i;
+			sweep.tasks[t].chunk = chunk;
+			sweep.tasks[t].reps  =
+				(reps_left < chunk_reps) ? reps_left : chunk_reps;
+			reps_left -= sweep.tasks[t].reps;
+			points[i].chunks_left++;
+		}
+	}
+	if (num_workers > num_tasks)
+		num_workers = (num_tasks < 1) ? 1 : num_tasks;
+
+	sweep.points       = points;
+	sweep.num_points   = num_points;
+	sweep.num_workers  = num_workers;
+	sweep.seed         = seed;
+	sweep.pestimator   = pestimator;
+	sweep.pemitter     = pemitter;
+	sweep.parg         = parg;
+	sweep.ptemplate    = ptemplate;
+	sweep.next_to_emit = 0;
+	pthread_mutex_init(&sweep.results_mutex, 0);
+
+	// Deal the tasks out in contiguous runs.
+	sweep.deques = (task_deque_t*)malloc_or_die(
+		num_workers * sizeof(task_deque_t));
+	for (w = 0; w < num_workers; w++) {
+		int t0w = (int)((long long)num_tasks *  w    / num_workers);
+		int t1w = (int)((long long)num_tasks * (w+1) / num_workers);
+		task_deque_t* pdeque = &sweep.deques[w];
+		pthread_mutex_init(&pdeque->mutex, 0);
+		pdeque->tasks = (int*)malloc_or_die((t1w - t0w + 1) * sizeof(int));
+		for (t = t0w; t < t1w; t++)
+			pdeque->tasks[t - t0w] = t;
+		pdeque->head = 0;
+		pdeque->tail = t1w - t0w;
+	}
+
+	workers = (sweep_worker_t*)malloc_or_die(
+		num_workers * sizeof(sweep_worker_t));
+	for (w = 0; w < num_workers; w++) {
+		workers[w].psweep    = &sweep;
+		workers[w].w         = w;
+		workers[w].tasks_run = 0;
+		workers[w].steals    = 0;
+	}
+	run_workers(num_workers, sweep_worker, workers, sizeof(sweep_worker_t));
+	for (w = 0; w < num_workers; w++)
+		total_steals += workers[w].steals;
+
+	if (pstats) {
+		pstats->num_tasks   = num_tasks;
+		pstats->num_workers = num_workers;
+		pstats->steals      = total_steals;
+		pstats->seconds     = get_sys_time_float() - t0;
+	}
+
+	for (w = 0; w < num_workers; w++) {
+		pthread_mutex_destroy(&sweep.deques[w].mutex);
+		free(sweep.deques[w].tasks);
+	}
+	pthread_mutex_destroy(&sweep.results_mutex);
+	free(sweep.deques);
+	free(sweep.tasks);
+	free(workers);
+}
@@ -0,0 +1,84 @@
+// ================================================================
+// PERCO2SWEEP.H
+//
+// This is a work-stealing scheduler for sweeping an estimator over a grid of
+// parameter points (M, N, p), such as the grid in greeks.sh, on all cores of
+// one machine.
+//
+// The cost of a point varies by orders of magnitude:  with M*N, and with p,
+// since the cluster labeling does much more work above p_c.  So the grid is
+// not split statically.  Instead, each point's reps are cut into chunks, and
+// each chunk is a task.  Each worker thread starts with a contiguous run of
+// the tasks, in grid order, in its own deque.  It takes tasks from the front
+// of its own deque; when that is empty it steals from the back of another
+// worker's.  Stealing from the back takes the work farthest from what the
+// owner is about to do.
+//
+// Each point's chunk results are combined (weighted by reps) as chunks
+// finish, and points are emitted strictly in grid order, each as soon as it
+// and all the points before it are complete.
+//
+// Each task seeds the random-number generator from the sweep seed, its point
+// index, and its chunk index.  So the results depend on the seed and the
+// chunk size, but not on the number of workers nor on which worker ran which
+// task.
+//
+// The sweep may run in the process-wide settings of perco2lib.h, or in those
+// of a context from perco2ctx.h, so that a library caller's sweep does not
+// depend on, nor disturb, anything else in the process.
+// ================================================================
+
+#ifndef PERCO2SWEEP_H
+#define PERCO2SWEEP_H
+
+#include "perco2ctx.h"
+
+typedef struct _sweep_point_t {
+	int    M, N;
+	double p;
+	int    try_number;  // For repeated points, as in greeks.sh
+	int    reps;        // Requested
+	double sum;         // Sum over chunks of chunk value * chunk reps
+	int    reps_done;
+	int    chunks_left;
+} sweep_point_t;
+
+// Runs reps repetitions of an estimator on a lattice of the given size,
+// using site_marks, vbonds, and hbonds from allocate_matrix() as workspace,
+// and returns the estimate.  It must be a mean over reps, e.g. P_A_in_C() or
+// get_mean_C0_size(), so that chunks may be combined by weighting with reps.
+typedef double sweep_estimator_t(int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, double p, int reps, void* parg);
+
+// Called for each completed point in grid order, one at a time.  The
+// estimate is ppoint->sum / ppoint->reps_done.
+typedef void sweep_emitter_t(sweep_point_t* ppoint, void* parg);
+
+typedef struct _sweep_stats_t {
+	int    num_tasks;
+	int    num_workers;
+	int    steals;
+	double seconds;
+} sweep_stats_t;
+
+// Runs pworker on num_workers threads at once, the kth being passed the kth
+// of num_workers records of arg_bytes bytes each, starting at args, and waits
+// for them all to finish.  The recursive depth-first searches in perco2lib.c
+// can go deep above p_c, so the threads get SWEEP_STACK_BYTES of stack rather
+// than the pthreads default.  num_workers < 1 means one per online CPU.
+#define SWEEP_STACK_BYTES (64 * 1024 * 1024)
+void run_workers(int num_workers, void* (*pworker)(void*), void* args,
+	int arg_bytes);
+
+// Fills in the sums for all the points, calling pemitter (if non-null) as
+// they complete.  num_workers < 1 means one per online CPU.  If
+// ptemplate is non-null, each worker runs in a context of its own with the
+// template's generator, boundary condition, layout, and labeling threads;
+// else in the process-wide settings.  If pstats is non-null, statistics are
+// written there.
+void run_sweep(sweep_point_t* points, int num_points, int chunk_reps,
+	int num_workers, unsigned long long seed, perco_ctx_t* ptemplate,
+	sweep_estimator_t* pestimator, sweep_emitter_t* pemitter, void* parg,
+	sweep_stats_t* pstats);
+
+#endif // PERCO2SWEEP_H
@@ -0,0 +1,718 @@
+// ================================================================
+// PERCO2TILE.C
+// Please see the comments in perco2tile.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include "putil.h"
+#include "perco2lib.h"
+#include "perco2tile.h"
+#include "perco2ctx.h"
+#include "perco2ws.h"
+#include "perco2mem.h"
+
+#define TILE_SITES (TILE_SIDE * TILE_SIDE)
+
+// ----------------------------------------------------------------
+tile_labeling_t* tile_labeling_alloc(int M, int N)
+{
+	tile_labeling_t* plab =
+		(tile_labeling_t*)malloc_or_die(sizeof(tile_labeling_t));
+
+	plab->local  = 0;
+	plab->base   = 0;
+	plab->parent = 0;
+	plab->canon  = 0;
+	plab->first  = 0;
+	plab->max_sites   = 0;
+	plab->max_tiles   = 0;
+	plab->max_threads = 0;
+	plab->jobs    = 0;
+	plab->threads = 0;
+	tile_labeling_size(plab, M, N);
+	return plab;
+}
+
+// ----------------------------------------------------------------
+void tile_labeling_free(tile_labeling_t* plab)
+{
+	large_free(plab->local);
+	free(plab->base);
+	large_free(plab->parent);
+	large_free(plab->canon);
+	large_free(plab->first);
+	free(plab->jobs);
+	free(plab->threads);
+	free(plab);
+}
+
+// ----------------------------------------------------------------
+void tile_labeling_size(tile_labeling_t* plab, int M, int N)
+{
+	int MN = M*N;
+
+	plab->M = M;
+	plab->N = N;
+	plab->tiles_down   = (M + TILE_SIDE - 1) / TILE_SIDE;
+	plab->tiles_across = (N + TILE_SIDE - 1) / TILE_SIDE;
+	plab->num_labels   = 0;
+	plab->num_clusters = 0;
+
+	if (MN > plab->max_sites) {
+		large_free(plab->local);
+		large_free(plab->parent);
+		large_free(plab->canon);
+		large_free(plab->first);
+		plab->local  = (uint16_t*)large_alloc_or_die(MN * sizeof(uint16_t));
+		plab->parent = (int*)large_alloc_or_die(MN * sizeof(int));
+		plab->canon  = (int*)large_alloc_or_die(MN * sizeof(int));
+		plab->first  = (int*)large_alloc_or_die(MN * sizeof(int));
+		plab->max_sites = MN;
+	}
+	if (plab->tiles_down * plab->tiles_across > plab->max_tiles) {
+		plab->max_tiles = plab->tiles_down * plab->tiles_across;
+		free(plab->base);
+		plab->base = (int*)malloc_or_die(plab->max_tiles * sizeof(int));
+	}
+}
+
+// ----------------------------------------------------------------
+// The height and width of a tile, which are TILE_SIDE except for the last row
+// and column of tiles when TILE_SIDE does not divide M or N.
+static inline int tile_extent(int tile, int n)
+{
+	int rest = n - tile * TILE_SIDE;
+	return (rest < TILE_SIDE) ? rest : TILE_SIDE;
+}
+
+// Where site (i,j)'s local label is stored.  Each full row of tiles holds
+// TILE_SIDE*N sites, and within it each tile holds th*TILE_SIDE sites, in
+// row-major order.
+static inline int local_index(tile_labeling_t* plab, int i, int j)
+{
+	int ti = i / TILE_SIDE;
+	int tj = j / TILE_SIDE;
+	int th = tile_extent(ti, plab->M);
+	int tw = tile_extent(tj, plab->N);
+	return ti * TILE_SIDE * plab->N + tj * TILE_SIDE * th
+		+ (i - ti * TILE_SIDE) * tw + (j - tj * TILE_SIDE);
+}
+
+// Site (i,j)'s global label, before any merging.
+static inline int global_label(tile_labeling_t* plab, int i, int j)
+{
+	int t = (i / TILE_SIDE) * plab->tiles_across + (j / TILE_SIDE);
+	return plab->base[t] + plab->local[local_index(plab, i, j)];
+}
+
+// ----------------------------------------------------------------
+// Union-find for the local labels.  Each set's root is its least member, so
+// parent[x] <= x always.
+static inline int find16(uint16_t* parent, int x)
+{
+	while (parent[x] != x) {
+		parent[x] = parent[parent[x]];
+		x = parent[x];
+	}
+	return x;
+}
+
+// ----------------------------------------------------------------
+// The first pass, for one tile:  a Hoshen-Kopelman raster scan, following
+// only the up and left bonds within the tile.  Writes the tile's labels to
+// out[], renumbered 0 .. n-1, and returns n.
+static int label_tile(int** vbonds, int** hbonds, int i0, int j0,
+	int th, int tw, uint16_t* out)
+{
+	uint16_t parent[TILE_SITES];
+	uint16_t renum[TILE_SITES];
+	int n = 0;
+	int num_roots = 0;
+	int r, c, k, up, left;
+
+	for (r = 0; r < th; r++) {
+		int* vabove = (r > 0) ? &vbonds[i0+r-1][j0] : 0;
+		int* hrow   = &hbonds[i0+r][j0];
+		k = r * tw;
+		for (c = 0; c < tw; c++, k++) {
+			up   = (r > 0 && vabove[c])  ? find16(parent, out[k-tw]) : -1;
+			left = (c > 0 && hrow[c-1]) ? find16(parent, out[k-1])  : -1;
+			if (up >= 0 && left >= 0) {
+				if (up < left) {
+					parent[left] = up;
+					out[k] = up;
+				}
+				else {
+					parent[up] = left;
+					out[k] = left;
+				}
+			}
+			else if (up >= 0) {
+				out[k] = up;
+			}
+			else if (left >= 0) {
+				out[k] = left;
+			}
+			else {
+				parent[n] = n;
+				out[k] = n++;
+			}
+		}
+	}
+
+	// Since parent[x] <= x, one pass in increasing order renumbers the roots
+	// consecutively and maps every other label to its root's number.
+	for (k = 0; k < n; k++) {
+		if (parent[k] == k)
+			renum[k] = num_roots++;
+		else
+			renum[k] = renum[find16(parent, k)];
+	}
+	for (k = 0; k < th * tw; k++)
+		out[k] = renum[out[k]];
+	return num_roots;
+}
+
+// ----------------------------------------------------------------
+// Union-find for the global labels, with the same convention.
+static inline int find_global(int* parent, int x)
+{
+	while (parent[x] != x) {
+		parent[x] = parent[parent[x]];
+		x = parent[x];
+	}
+	return x;
+}
+
+static inline void union_global(int* parent, int x, int y)
+{
+	x = find_global(parent, x);
+	y = find_global(parent, y);
+	if (x < y)
+		parent[y] = x;
+	else if (y < x)
+		parent[x] = y;
+}
+
+// ----------------------------------------------------------------
+void tile_label(tile_labeling_t* plab, int** vbonds, int** hbonds)
+{
+	int M = plab->M;
+	int N = plab->N;
+	int* parent = plab->parent;
+	int ti, tj, t, i, j, g;
+	int nb[d];
+	int num_labels = 0;
+	int num_clusters = 0;
+
+	// First pass:  each tile by itself.
+	for (ti = 0, t = 0; ti < plab->tiles_down; ti++) {
+		int th = tile_extent(ti, M);
+		for (tj = 0; tj < plab->tiles_across; tj++, t++) {
+			int tw = tile_extent(tj, N);
+			uint16_t* out = &plab->local[local_index(plab,
+				ti * TILE_SIDE, tj * TILE_SIDE)];
+			plab->base[t] = num_labels;
+			num_labels += label_tile(vbonds, hbonds,
+				ti * TILE_SIDE, tj * TILE_SIDE, th, tw, out);
+		}
+	}
+	plab->num_labels = num_labels;
+
+	// Second pass:  the bonds leaving each tile's last column and last row.
+	// Those leaving the lattice's last column and row wrap around.
+	for (g = 0; g < num_labels; g++)
+		parent[g] = g;
+
+	for (tj = 0; tj < plab->tiles_across; tj++) {
+		j = tj * TILE_SIDE + tile_extent(tj, N) - 1;
+		for (i = 0; i < M; i++) {
+			if (!hbonds[i][j])
+				continue;
+			if (j + 1 < N) {
+				nb[0] = i;
+				nb[1] = j + 1;
+			}
+			else {
+				wrap_site(M, N, i, j + 1, nb);
+			}
+			union_global(parent, global_label(plab, i, j),
+				global_label(plab, nb[0], nb[1]));
+		}
+	}
+
+	for (ti = 0; ti < plab->tiles_down; ti++) {
+		i = ti * TILE_SIDE + tile_extent(ti, M) - 1;
+		for (j = 0; j < N; j++) {
+			if (!vbonds[i][j])
+				continue;
+			if (i + 1 < M) {
+				nb[0] = i + 1;
+				nb[1] = j;
+			}
+			else {
+				wrap_site(M, N, i + 1, j, nb);
+			}
+			union_global(parent, global_label(plab, i, j),
+				global_label(plab, nb[0], nb[1]));
+		}
+	}
+
+	// Point every label straight at its root.  Since parent[g] <= g, one pass
+	// in increasing order suffices.
+	for (g = 0; g < num_labels; g++) {
+		parent[g] = parent[parent[g]];
+		if (parent[g] == g)
+			num_clusters++;
+	}
+	plab->num_clusters = num_clusters;
+}
+
+// ----------------------------------------------------------------
+int tile_cluster_root(tile_labeling_t* plab, int i, int j)
+{
+	return plab->parent[global_label(plab, i, j)];
+}
+
+// ----------------------------------------------------------------
+// Third pass.  Rows are scanned in order, a tile-width segment at a time, so
+// the local labels are read sequentially within each segment.
+void tile_write_cluster_numbers(tile_labeling_t* plab, int** site_marks)
+{
+	int M = plab->M;
+	int N = plab->N;
+	int* parent = plab->parent;
+	int* canon  = plab->canon;
+	int cluster_number = 0;
+	int g, i, tj, c, root;
+
+	for (g = 0; g < plab->num_labels; g++)
+		canon[g] = -1;
+
+	for (i = 0; i < M; i++) {
+		int ti = i / TILE_SIDE;
+		for (tj = 0; tj < plab->tiles_across; tj++) {
+			int j0   = tj * TILE_SIDE;
+			int tw   = tile_extent(tj, N);
+			int base = plab->base[ti * plab->tiles_across + tj];
+			uint16_t* seg = &plab->local[local_index(plab, i, j0)];
+			int* marks = &site_marks[i][j0];
+			for (c = 0; c < tw; c++) {
+				root = parent[base + seg[c]];
+				if (canon[root] < 0)
+					canon[root] = cluster_number++;
+				marks[c] = canon[root];
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+// The workspace is per thread, or per context, so that threads may label
+// lattices of different sizes at once.
+void mark_cluster_numbers_tiled(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters)
+{
+	tile_labeling_t* plab = perco_ws_tile_labeling(perco_ws_current(), M, N);
+
+	tile_label(plab, vbonds, hbonds);
+	tile_write_cluster_numbers(plab, site_marks);
+	if (pnum_clusters)
+		*pnum_clusters = plab->num_clusters;
+}
+
+// ================================================================
+// WHOLE-LATTICE LABELING
+
+// ----------------------------------------------------------------
+// The Hoshen-Kopelman raster scan of label_tile(), over the whole lattice at
+// once, with int labels and the union-find in the workspace's parent[].  The
+// provisional labels are written to site_marks.  Each cluster's first site in
+// row-major order gets a new label, smaller than those of its later sites, so
+// in increasing order the roots are the clusters in order of first site.
+void mark_cluster_numbers_hk(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters)
+{
+	tile_labeling_t* plab = perco_ws_tile_labeling(perco_ws_current(), M, N);
+	int* parent = plab->parent;
+	int* canon  = plab->canon;
+	int n = 0;
+	int num_clusters = 0;
+	int i, j, g, up, left;
+	int nb[d];
+
+	for (i = 0; i < M; i++) {
+		int* vabove = (i > 0) ? vbonds[i-1] : 0;
+		int* above  = (i > 0) ? site_marks[i-1] : 0;
+		int* hrow   = hbonds[i];
+		int* marks  = site_marks[i];
+		for (j = 0; j < N; j++) {
+			up   = (i > 0 && vabove[j]) ? find_global(parent, above[j])  : -1;
+			left = (j > 0 && hrow[j-1]) ? find_global(parent, marks[j-1]) : -1;
+			if (up >= 0 && left >= 0) {
+				if (up < left) {
+					parent[left] = up;
+					marks[j] = up;
+				}
+				else {
+					parent[up] = left;
+					marks[j] = left;
+				}
+			}
+			else if (up >= 0) {
+				marks[j] = up;
+			}
+			else if (left >= 0) {
+				marks[j] = left;
+			}
+			else {
+				parent[n] = n;
+				marks[j] = n++;
+			}
+		}
+	}
+
+	// The bonds leaving the last column and last row wrap around, as in
+	// tile_label().
+	for (i = 0; i < M; i++) {
+		if (!hbonds[i][N-1])
+			continue;
+		wrap_site(M, N, i, N, nb);
+		union_global(parent, site_marks[i][N-1], site_marks[nb[0]][nb[1]]);
+	}
+	for (j = 0; j < N; j++) {
+		if (!vbonds[M-1][j])
+			continue;
+		wrap_site(M, N, M, j, nb);
+		union_global(parent, site_marks[M-1][j], site_marks[nb[0]][nb[1]]);
+	}
+
+	// Since parent[g] <= g, one pass in increasing order numbers the roots
+	// and maps every other label to its root's number.
+	for (g = 0; g < n; g++) {
+		if (parent[g] == g)
+			canon[g] = num_clusters++;
+		else
+			canon[g] = canon[find_global(parent, g)];
+	}
+	for (i = 0; i < M; i++) {
+		int* marks = site_marks[i];
+		for (j = 0; j < N; j++)
+			marks[j] = canon[marks[j]];
+	}
+	if (pnum_clusters)
+		*pnum_clusters = num_clusters;
+}
+
+// ================================================================
+// THREADED LABELING
+
+static int labeling_threads = 1;
+
+static int threads_or_cpus(int nthreads)
+{
+	return (nthreads < 1) ? num_online_cpus() : nthreads;
+}
+
+void set_labeling_threads(int nthreads)
+{
+	labeling_threads = threads_or_cpus(nthreads);
+}
+
+int get_labeling_threads(void)
+{
+	perco_ctx_t* pctx = perco_ctx_current();
+	return pctx ? threads_or_cpus(pctx->labeling_threads) : labeling_threads;
+}
+
+// ----------------------------------------------------------------
+// The shared union-find.  As in the serial version each set's root is its
+// least member, and a root is only ever linked below a smaller root, by
+// compare-and-swap.  Path halving only writes the parents of non-roots, which
+// stay non-roots, and only writes ancestors, so it needs no compare-and-swap.
+static inline int find_atomic(int* parent, int x)
+{
+	int p, gp;
+	for (;;) {
+		p = __atomic_load_n(&parent[x], __ATOMIC_RELAXED);
+		if (p == x)
+			return x;
+		gp = __atomic_load_n(&parent[p], __ATOMIC_RELAXED);
+		if (gp == p)
+			return p;
+		__atomic_store_n(&parent[x], gp, __ATOMIC_RELAXED);
+		x = gp;
+	}
+}
+
+static inline void union_atomic(int* parent, int x, int y)
+{
+	int lo, hi;
+	for (;;) {
+		x = find_atomic(parent, x);
+		y = find_atomic(parent, y);
+		if (x == y)
+			return;
+		lo = (x < y) ? x : y;
+		hi = (x < y) ? y : x;
+		if (__atomic_compare_exchange_n(&parent[hi], &hi, lo, 0,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return;
+	}
+}
+
+static inline void min_atomic(int* p, int value)
+{
+	int current = __atomic_load_n(p, __ATOMIC_RELAXED);
+	while (value < current) {
+		if (__atomic_compare_exchange_n(p, &current, value, 1,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return;
+	}
+}
+
+// ----------------------------------------------------------------
+typedef struct _strip_job_t {
+	tile_labeling_t* plab;
+	int** vbonds;
+	int** hbonds;
+	int** site_marks;          // Null for no third pass
+	int ti0, ti1;              // This strip's rows of tiles
+	int t;                     // This strip's index
+	struct _strip_job_t* jobs; // All the strips, for the prefix sums
+	pthread_barrier_t* pbarrier;
+	perco_ctx_t* pctx;         // The caller's context, for wrap_site()
+	int num_labels;            // Local labels in this strip's tiles
+	int num_roots;             // Roots among them, after merging
+	int num_firsts;            // First sites of clusters in this strip
+} strip_job_t;
+
+// ----------------------------------------------------------------
+static void label_strip_body(strip_job_t* pjob)
+{
+	tile_labeling_t* plab = pjob->plab;
+	int** vbonds = pjob->vbonds;
+	int** hbonds = pjob->hbonds;
+	int M = plab->M;
+	int N = plab->N;
+	int* parent = plab->parent;
+	int* first  = plab->first;
+	int* canon  = plab->canon;
+	int i0 = pjob->ti0 * TILE_SIDE;
+	int i1 = (pjob->ti1 * TILE_SIDE < M) ? pjob->ti1 * TILE_SIDE : M;
+	int label0 = 0;
+	int ti, tj, t, i, j, g, k, root, cluster_number;
+	int nb[d];
+
+	// First pass, on this strip's tiles.  The base of each tile is relative
+	// to the strip until all strips' label counts are known.
+	pjob->num_labels = 0;
+	for (ti = pjob->ti0; ti < pjob->ti1; ti++) {
+		int th = tile_extent(ti, M);
+		for (tj = 0; tj < plab->tiles_across; tj++) {
+			int tw = tile_extent(tj, N);
+			uint16_t* out = &plab->local[local_index(plab,
+				ti * TILE_SIDE, tj * TILE_SIDE)];
+			plab->base[ti * plab->tiles_across + tj] = pjob->num_labels;
+			pjob->num_labels += label_tile(vbonds, hbonds,
+				ti * TILE_SIDE, tj * TILE_SIDE, th, tw, out);
+		}
+	}
+	pthread_barrier_wait(pjob->pbarrier);
+
+	for (k = 0; k < pjob->t; k++)
+		label0 += pjob->jobs[k].num_labels;
+	for (t = pjob->ti0 * plab->tiles_across;
+		t < pjob->ti1 * plab->tiles_across; t++)
+		plab->base[t] += label0;
+	for (g = label0; g < label0 + pjob->num_labels; g++) {
+		parent[g] = g;
+		first[g]  = INT_MAX;
+	}
+	pthread_barrier_wait(pjob->pbarrier);
+
+	// Second pass:  the right edges of this strip's tiles, and the bottom
+	// edges, which for the last row of tiles in the strip lead into the next
+	// strip (or, for the last strip, wrap around to the first).
+	for (tj = 0; tj < plab->tiles_across; tj++) {
+		j = tj * TILE_SIDE + tile_extent(tj, N) - 1;
+		for (i = i0; i < i1; i++) {
+			if (!hbonds[i][j])
+				continue;
+			if (j + 1 < N) {
+				nb[0] = i;
+				nb[1] = j + 1;
+			}
+			else {
+				wrap_site(M, N, i, j + 1, nb);
+			}
+			union_atomic(parent, global_label(plab, i, j),
+				global_label(plab, nb[0], nb[1]));
+		}
+	}
+	for (ti = pjob->ti0; ti < pjob->ti1; ti++) {
+		i = ti * TILE_SIDE + tile_extent(ti, M) - 1;
+		for (j = 0; j < N; j++) {
+			if (!vbonds[i][j])
+				continue;
+			if (i + 1 < M) {
+				nb[0] = i + 1;
+				nb[1] = j;
+			}
+			else {
+				wrap_site(M, N, i + 1, j, nb);
+			}
+			union_atomic(parent, global_label(plab, i, j),
+				global_label(plab, nb[0], nb[1]));
+		}
+	}
+	pthread_barrier_wait(pjob->pbarrier);
+
+	// Point each of this strip's labels straight at its root.
+	pjob->num_roots = 0;
+	for (g = label0; g < label0 + pjob->num_labels; g++) {
+		root = find_atomic(parent, g);
+		if (root == g)
+			pjob->num_roots++;
+		__atomic_store_n(&parent[g], root, __ATOMIC_RELAXED);
+	}
+	pthread_barrier_wait(pjob->pbarrier);
+
+	if (!pjob->site_marks)
+		return;
+
+	// Third pass.  Write each site's root to site_marks, and find each
+	// cluster's first site in row-major order.
+	for (i = i0; i < i1; i++) {
+		int ti = i / TILE_SIDE;
+		int* marks = pjob->site_marks[i];
+		for (tj = 0; tj < plab->tiles_across; tj++) {
+			int j0   = tj * TILE_SIDE;
+			int tw   = tile_extent(tj, N);
+			int base = plab->base[ti * plab->tiles_across + tj];
+			uint16_t* seg = &plab->local[local_index(plab, i, j0)];
+			for (k = 0; k < tw; k++) {
+				root = parent[base + seg[k]];
+				marks[j0+k] = root;
+				min_atomic(&first[root], i*N + j0+k);
+			}
+		}
+	}
+	pthread_barrier_wait(pjob->pbarrier);
+
+	// Clusters are numbered in order of first site, so the clusters first
+	// appearing in this strip are numbered consecutively from the count of
+	// those first appearing in earlier strips.
+	pjob->num_firsts = 0;
+	for (i = i0; i < i1; i++) {
+		int* marks = pjob->site_marks[i];
+		for (j = 0; j < N; j++)
+			if (first[marks[j]] == i*N + j)
+				pjob->num_firsts++;
+	}
+	pthread_barrier_wait(pjob->pbarrier);
+
+	cluster_number = 0;
+	for (k = 0; k < pjob->t; k++)
+		cluster_number += pjob->jobs[k].num_firsts;
+	for (i = i0; i < i1; i++) {
+		int* marks = pjob->site_marks[i];
+		for (j = 0; j < N; j++)
+			if (first[marks[j]] == i*N + j)
+				canon[marks[j]] = cluster_number++;
+	}
+	pthread_barrier_wait(pjob->pbarrier);
+
+	for (i = i0; i < i1; i++) {
+		int* marks = pjob->site_marks[i];
+		for (j = 0; j < N; j++)
+			marks[j] = canon[marks[j]];
+	}
+}
+
+// The threads' entry point.  Each thread works in the caller's context, if
+// any, so that wrap_site() uses the caller's boundary condition.
+static void* label_strip(void* pvjob)
+{
+	strip_job_t* pjob = (strip_job_t*)pvjob;
+	perco_ctx_t* pprev = perco_ctx_bind(pjob->pctx);
+	label_strip_body(pjob);
+	perco_ctx_bind(pprev);
+	return 0;
+}
+
+// ----------------------------------------------------------------
+void tile_label_threaded(tile_labeling_t* plab, int** vbonds, int** hbonds,
+	int** site_marks, int nthreads)
+{
+	strip_job_t* jobs;
+	pthread_t* threads;
+	pthread_barrier_t barrier;
+	int t;
+
+	if (nthreads > plab->tiles_down)
+		nthreads = plab->tiles_down;
+	if (nthreads < 1)
+		nthreads = 1;
+
+	if (nthreads > plab->max_threads) {
+		free(plab->jobs);
+		free(plab->threads);
+		plab->jobs    = (strip_job_t*)malloc_or_die(
+			nthreads * sizeof(strip_job_t));
+		plab->threads = (pthread_t*)malloc_or_die(
+			nthreads * sizeof(pthread_t));
+		plab->max_threads = nthreads;
+	}
+	jobs    = plab->jobs;
+	threads = plab->threads;
+	pthread_barrier_init(&barrier, 0, nthreads);
+
+	for (t = 0; t < nthreads; t++) {
+		jobs[t].plab       = plab;
+		jobs[t].vbonds     = vbonds;
+		jobs[t].hbonds     = hbonds;
+		jobs[t].site_marks = site_marks;
+		jobs[t].ti0        = (int)((long long)plab->tiles_down *  t    / nthreads);
+		jobs[t].ti1        = (int)((long long)plab->tiles_down * (t+1) / nthreads);
+		jobs[t].t          = t;
+		jobs[t].jobs       = jobs;
+		jobs[t].pbarrier   = &barrier;
+		jobs[t].pctx       = perco_ctx_current();
+	}
+
+	// The calling thread does the last strip itself.
+	for (t = 0; t < nthreads-1; t++) {
+		if (pthread_create(&threads[t], 0, label_strip, &jobs[t]) != 0) {
+			fprintf(stderr, "tile_label_threaded:  pthread_create failed.\n");
+			exit(1);
+		}
+	}
+	label_strip(&jobs[nthreads-1]);
+	for (t = 0; t < nthreads-1; t++)
+		pthread_join(threads[t], 0);
+
+	plab->num_labels   = 0;
+	plab->num_clusters = 0;
+	for (t = 0; t < nthreads; t++) {
+		plab->num_labels   += jobs[t].num_labels;
+		plab->num_clusters += jobs[t].num_roots;
+	}
+
+	pthread_barrier_destroy(&barrier);
+}
+
+// ----------------------------------------------------------------
+void mark_cluster_numbers_threaded(int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters)
+{
+	tile_labeling_t* plab = perco_ws_tile_labeling(perco_ws_current(), M, N);
+
+	tile_label_threaded(plab, vbonds, hbonds, site_marks,
+		get_labeling_threads());
+	if (pnum_clusters)
+		*pnum_clusters = plab->num_clusters;
+}
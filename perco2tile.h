@@ -0,0 +1,120 @@
+// ================================================================
+// PERCO2TILE.H
+//
+// This is a cache-blocked version of mark_cluster_numbers() from perco2lib.h,
+// for lattices too big for the depth-first search to stay in cache.
+//
+// The lattice is cut into TILE_SIDE by TILE_SIDE tiles, and the work is done
+// in three passes:
+//
+// * Each tile is labeled by itself, with a Hoshen-Kopelman raster scan which
+//   only follows bonds inside the tile.  The tile's labels, its union-find
+//   parents, and its rows of bonds together fit in L1 cache.  The labels are
+//   16-bit, numbered from 0 within each tile, and are stored tile by tile.
+// * Tile t's labels are numbered globally from base[t], and a union-find over
+//   the global numbers merges them across each tile's right and bottom edges.
+//   The bonds leaving the last column and last row of the lattice wrap around
+//   according to the boundary condition, so the periodic (or helical) seams
+//   are merged in the same way as any other tile edge.
+// * Only if cluster numbers are asked for:  each site is looked up and its
+//   cluster given a number in order of first appearance.
+//
+// After the first two passes, tile_cluster_root() answers connectivity
+// questions (are two sites in the same cluster?) without the third.
+//
+// The cluster numbers are identical to those from mark_cluster_numbers():
+// clusters are numbered 0, 1, 2, ... in order of their first site in
+// row-major order.  Either layout and either boundary condition may be used.
+// ================================================================
+
+#ifndef PERCO2TILE_H
+#define PERCO2TILE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "perco2lib.h"
+
+// Tile side.  A tile has at most TILE_SIDE^2 labels, which must fit in 16
+// bits.
+#define TILE_SIDE 64
+
+typedef struct _tile_labeling_t {
+	int M, N;
+	int tiles_down, tiles_across;
+	uint16_t* local;  // M*N local labels, tile by tile
+	int* base;        // Global number of each tile's label 0
+	int* parent;      // Global union-find
+	int* canon;       // Root -> cluster number, for the third pass
+	int* first;       // Root -> row-major index of first site, if threaded
+	int num_labels;   // Total local labels over all tiles
+	int num_clusters;
+
+	// Capacities of the arrays above, which may exceed M*N and the number of
+	// tiles after tile_labeling_size(), and tile_label_threaded()'s
+	// per-thread records, kept from one call to the next.
+	int max_sites, max_tiles, max_threads;
+	struct _strip_job_t* jobs;
+	pthread_t* threads;
+} tile_labeling_t;
+
+// Allocates a workspace for an M by N lattice, to be used for any number of
+// labelings.
+tile_labeling_t* tile_labeling_alloc(int M, int N);
+void tile_labeling_free(tile_labeling_t* plab);
+
+// Makes the workspace one for an M by N lattice, reallocating its arrays
+// only if they are too small.
+void tile_labeling_size(tile_labeling_t* plab, int M, int N);
+
+// The first two passes.  populate_bonds() must have been called first.
+// Afterward plab->num_clusters holds the number of clusters.
+void tile_label(tile_labeling_t* plab, int** vbonds, int** hbonds);
+
+// The same as tile_label(), followed by tile_write_cluster_numbers() if
+// site_marks is non-null, using nthreads threads.  The lattice is split into
+// horizontal strips of whole rows of tiles, one strip per thread.  Each
+// thread labels its own tiles, then merges its tiles' right and bottom edges
+// into the shared union-find, whose links are made with compare-and-swap so
+// that no locks are needed.  The last strip's bottom edge wraps around to the
+// first strip, and each row's last column to its first, so both periodic
+// seams are merged like any other tile edge.  Cluster numbers are assigned
+// in parallel too:  each cluster's first site in row-major order is found
+// with an atomic minimum, and the first sites are counted strip by strip.
+void tile_label_threaded(tile_labeling_t* plab, int** vbonds, int** hbonds,
+	int** site_marks, int nthreads);
+
+// After tile_label():  a number identifying the cluster containing site
+// (i,j), the same for every site of the cluster.  These are not cluster
+// numbers in the sense of mark_cluster_numbers().
+int tile_cluster_root(tile_labeling_t* plab, int i, int j);
+
+// After tile_label():  the third pass, writing cluster numbers to site_marks.
+void tile_write_cluster_numbers(tile_labeling_t* plab, int** site_marks);
+
+// All three passes, with the same arguments and results as
+// mark_cluster_numbers().  The workspace is that of perco_ws_current(), from
+// perco2ws.h.
+void mark_cluster_numbers_tiled(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters);
+
+// The same, with a single Hoshen-Kopelman raster scan over the whole lattice
+// and a union-find of int labels, rather than tile by tile.  This is the
+// textbook algorithm.  On one thread it is faster than the tiled labeler,
+// whose merging across tile edges costs more than its locality saves, so it
+// is the one mark_cluster_numbers() uses for large lattices; the tiles are
+// there for tile_label_threaded(), which labels them in parallel.
+void mark_cluster_numbers_hk(int** site_marks, int** vbonds, int** hbonds,
+	int M, int N, int* pnum_clusters);
+
+// The same, using tile_label_threaded() with get_labeling_threads() threads.
+void mark_cluster_numbers_threaded(int** site_marks, int** vbonds,
+	int** hbonds, int M, int N, int* pnum_clusters);
+
+// The number of threads for mark_cluster_numbers() to use on lattices of
+// TILED_MIN_SITES or more sites.  The default is 1; 0 means one per online
+// CPU.  On a thread with a context from perco2ctx.h bound to it,
+// get_labeling_threads() returns the context's number instead.
+void set_labeling_threads(int nthreads);
+int  get_labeling_threads(void);
+
+#endif // PERCO2TILE_H
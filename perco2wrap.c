@@ -0,0 +1,142 @@
+// ================================================================
+// PERCO2WRAP.C
+// Please see the comments in perco2wrap.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "perco2lib.h"
+#include "perco2ws.h"
+#include "perco2wrap.h"
+
+// ----------------------------------------------------------------
+// Returns the root of x's cluster, and x's displacement to it.  The path is
+// compressed on the way back:  each site on it is pointed straight at the
+// root, with its displacement to the root.
+static inline int find_root(int x, int* parent, int* di, int* dj,
+	int* pdi, int* pdj)
+{
+	int r = x;
+	int si = 0, sj = 0;
+	int next, oi, oj;
+
+	while (parent[r] >= 0) {
+		si += di[r];
+		sj += dj[r];
+		r = parent[r];
+	}
+	*pdi = si;
+	*pdj = sj;
+
+	while (x != r) {
+		next = parent[x];
+		oi = di[x];
+		oj = dj[x];
+		parent[x] = r;
+		di[x] = si;
+		dj[x] = sj;
+		si -= oi;
+		sj -= oj;
+		x = next;
+	}
+	return r;
+}
+
+// ----------------------------------------------------------------
+// Adds the bond from site x to site y, which is (ei, ej) away from x before
+// wrapping.  Returns the wrap bits found, if x and y were already in the same
+// cluster.  Smaller clusters are attached under larger ones.
+static inline int add_bond(int x, int y, int ei, int ej,
+	int* parent, int* di, int* dj)
+{
+	int xi, xj, yi, yj, wi, wj;
+	int rx = find_root(x, parent, di, dj, &xi, &xj);
+	int ry = find_root(y, parent, di, dj, &yi, &yj);
+
+	// The root's position less x's, by way of x and by way of y.
+	wi = ei + yi - xi;
+	wj = ej + yj - xj;
+
+	if (rx == ry)
+		return (wi ? WRAP_V : 0) | (wj ? WRAP_H : 0);
+
+	// Otherwise (wi, wj) is ry's position less rx's.
+	if (parent[rx] > parent[ry]) {
+		parent[ry] += parent[rx];
+		parent[rx] = ry;
+		di[rx] = wi;
+		dj[rx] = wj;
+	}
+	else {
+		parent[rx] += parent[ry];
+		parent[ry] = rx;
+		di[ry] = -wi;
+		dj[ry] = -wj;
+	}
+	return 0;
+}
+
+// ----------------------------------------------------------------
+// Sites are numbered i*N+j.  A root's displacement is never read, so only the
+// parents need initializing.  Once some cluster has wrapped both ways, no
+// more bonds can change the answer.
+int get_wrapping(int** vbonds, int** hbonds, int M, int N)
+{
+	perco_ws_t* pws = perco_ws_current();
+	int* parent;
+	int* di;
+	int* dj;
+	int wraps = 0;
+	int i, j, x, y, k;
+
+	perco_ws_reserve_wrap(pws, M, N);
+	parent = pws->wrap_parent;
+	di     = pws->wrap_di;
+	dj     = pws->wrap_dj;
+	for (k = 0; k < M*N; k++)
+		parent[k] = -1;
+
+	for (i = 0; i < M; i++) {
+		for (j = 0; j < N; j++) {
+			x = i*N + j;
+			if (vbonds[i][j]) { // Down
+				y = (i+1 < M) ? x + N : j;
+				wraps |= add_bond(x, y, 1, 0, parent, di, dj);
+			}
+			if (hbonds[i][j]) { // Right
+				y = (j+1 < N) ? x + 1 : i*N;
+				wraps |= add_bond(x, y, 0, 1, parent, di, dj);
+			}
+		}
+		if (wraps == WRAP_BOTH)
+			break;
+	}
+	return wraps;
+}
+
+// ----------------------------------------------------------------
+void get_wrapping_probabilities(int** vbonds, int** hbonds, int M, int N,
+	double p, int reps, double* pR_h, double* pR_v, double* pR_both,
+	double* pR_either)
+{
+	int num_h = 0, num_v = 0, num_both = 0, num_either = 0;
+	int rep, wraps;
+
+	for (rep = 0; rep < reps; rep++) {
+		populate_bonds(vbonds, hbonds, M, N, p);
+		wraps = get_wrapping(vbonds, hbonds, M, N);
+		if (wraps & WRAP_H)
+			num_h++;
+		if (wraps & WRAP_V)
+			num_v++;
+		if (wraps == WRAP_BOTH)
+			num_both++;
+		if (wraps)
+			num_either++;
+	}
+
+	*pR_h      = (double)num_h      / reps;
+	*pR_v      = (double)num_v      / reps;
+	*pR_both   = (double)num_both   / reps;
+	*pR_either = (double)num_either / reps;
+}
@@ -0,0 +1,46 @@
+// ================================================================
+// PERCO2WRAP.H
+//
+// Wrapping probabilities on the torus:  whether some cluster winds all the
+// way around the lattice.  With R_h the probability that some cluster wraps
+// horizontally (around the N direction), R_v vertically (around the M
+// direction), R_both both, and R_either either, each converges to its
+// infinite-lattice value at p_c far faster in the lattice size than theta(p)
+// does, which makes them the better estimators of p_c.
+//
+// mark_cluster_numbers() cannot tell whether a cluster wraps, since a
+// wrapping cluster and a merely wide one get the same numbers.  Here instead
+// the open bonds are added one at a time to a union-find, as in Newman and
+// Ziff, Phys. Rev. E 64, 016706 (2001), and each site keeps its displacement
+// (di, dj) to its parent as well as the parent itself, following Machta et
+// al.  The displacement to the root is then the site's position relative to
+// the root, unwrapped.  When a bond joins two sites already in the same
+// cluster, the two paths from the bond's ends to the root must end at the
+// same place:  if they do not, they differ by a nonzero multiple of the
+// lattice periods, and that cluster wraps in each direction whose component
+// of the difference is nonzero.  A cluster winding diagonally counts as
+// wrapping both ways.
+//
+// This is for periodic boundary conditions only.  Either layout may be used.
+// The union-find lives in the workspace (perco2ws.h), so the repetition loop
+// makes no heap calls.
+// ================================================================
+
+#ifndef PERCO2WRAP_H
+#define PERCO2WRAP_H
+
+#define WRAP_H    1 // Some cluster wraps horizontally
+#define WRAP_V    2 // Some cluster wraps vertically
+#define WRAP_BOTH (WRAP_H | WRAP_V)
+
+// For one realization, which has had populate_bonds() called:  the OR of
+// WRAP_H and WRAP_V over all clusters.
+int get_wrapping(int** vbonds, int** hbonds, int M, int N);
+
+// Over reps realizations:  the fractions of them in which some cluster wraps
+// horizontally, vertically, both, and either.
+void get_wrapping_probabilities(int** vbonds, int** hbonds, int M, int N,
+	double p, int reps, double* pR_h, double* pR_v, double* pR_both,
+	double* pR_either);
+
+#endif // PERCO2WRAP_H
@@ -0,0 +1,281 @@
+// ================================================================
+// PERCO2WS.C
+// Please see the comments in perco2ws.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include "putil.h"
+#include "perco2ctx.h"
+#include "perco2ws.h"
+#include "perco2mem.h"
+
+#define RING_INITIAL_SITES 1024
+
+static __thread perco_ws_t* pbound_ws = 0;
+
+// The threads' own workspaces are found through a key rather than a
+// __thread pointer, so that each is freed when its thread exits.
+static pthread_key_t  thread_ws_key;
+static pthread_once_t thread_ws_once = PTHREAD_ONCE_INIT;
+
+// ----------------------------------------------------------------
+perco_ws_t* perco_ws_alloc(int M, int N)
+{
+	perco_ws_t* pws = (perco_ws_t*)malloc_or_die(sizeof(perco_ws_t));
+	int k;
+
+	pws->M = 0;
+	pws->N = 0;
+	pws->layout     = LAYOUT_PLAIN;
+	pws->vbonds     = 0;
+	pws->hbonds     = 0;
+	pws->site_marks = 0;
+	for (k = 0; k < 3; k++) {
+		pws->rows[k]   = 0;
+		pws->blocks[k] = 0;
+	}
+	pws->max_rows  = 0;
+	pws->max_block = 0;
+
+	pws->max_sites     = 0;
+	pws->cluster_sizes = 0;
+	pws->stack         = 0;
+	pws->frame_sites   = 0;
+	pws->frame_dirs    = 0;
+	pws->plab          = 0;
+
+	pws->max_wrap_sites = 0;
+	pws->wrap_parent    = 0;
+	pws->wrap_di        = 0;
+	pws->wrap_dj        = 0;
+
+	pws->max_bfs_sites = 0;
+	pws->bfs_stamp     = 0;
+	pws->bfs_dist      = 0;
+	pws->bfs_epoch     = 0;
+	for (k = 0; k < 2; k++) {
+		pws->rings[k].sites = 0;
+		pws->rings[k].mask  = -1;
+		pws->rings[k].head  = 0;
+		pws->rings[k].count = 0;
+	}
+
+	pws->max_pad_elements = 0;
+	pws->pad_M      = -1;
+	pws->pad_N      = -1;
+	pws->pad_bc     = -1;
+	pws->pad_canon  = 0;
+	pws->pad_row_of = 0;
+	pws->pad_col_of = 0;
+
+	perco_ws_reserve(pws, M, N);
+	return pws;
+}
+
+// ----------------------------------------------------------------
+void perco_ws_free(perco_ws_t* pws)
+{
+	int k;
+
+	for (k = 0; k < 3; k++) {
+		free(pws->rows[k]);
+		large_free(pws->blocks[k]);
+	}
+	large_free(pws->cluster_sizes);
+	large_free(pws->stack);
+	large_free(pws->frame_sites);
+	large_free(pws->frame_dirs);
+	if (pws->plab)
+		tile_labeling_free(pws->plab);
+	large_free(pws->wrap_parent);
+	large_free(pws->wrap_di);
+	large_free(pws->wrap_dj);
+	large_free(pws->bfs_stamp);
+	large_free(pws->bfs_dist);
+	for (k = 0; k < 2; k++)
+		free(pws->rings[k].sites);
+	large_free(pws->pad_canon);
+	large_free(pws->pad_row_of);
+	large_free(pws->pad_col_of);
+	free(pws);
+}
+
+// ----------------------------------------------------------------
+void perco_ws_reserve(perco_ws_t* pws, int M, int N)
+{
+	int MN;
+
+	check_lattice_size(M, N);
+	MN = M*N;
+	if (MN <= pws->max_sites)
+		return;
+	large_free(pws->cluster_sizes);
+	large_free(pws->stack);
+	large_free(pws->frame_sites);
+	large_free(pws->frame_dirs);
+	pws->cluster_sizes = (int*)large_alloc_or_die(MN * sizeof(int));
+	pws->stack         = (int*)large_alloc_or_die(MN * sizeof(int));
+	pws->frame_sites   = (int*)large_alloc_or_die(MN * sizeof(int));
+	pws->frame_dirs    = (unsigned char*)large_alloc_or_die(MN);
+	pws->max_sites = MN;
+}
+
+// ----------------------------------------------------------------
+void perco_ws_shape(perco_ws_t* pws, int M, int N)
+{
+	int layout = get_lattice_layout();
+	size_t block_size = matrix_block_size(M, N);
+	int k;
+
+	perco_ws_reserve(pws, M, N);
+	if (pws->site_marks && (pws->M == M) && (pws->N == N) &&
+		(pws->layout == layout))
+		return;
+
+	if (M+2 > pws->max_rows) {
+		for (k = 0; k < 3; k++) {
+			free(pws->rows[k]);
+			pws->rows[k] = (int**)malloc_or_die((M+2) * sizeof(int*));
+		}
+		pws->max_rows = M+2;
+	}
+	if (block_size > pws->max_block) {
+		for (k = 0; k < 3; k++) {
+			large_free(pws->blocks[k]);
+			pws->blocks[k] = (int*)large_alloc_or_die(block_size * sizeof(int));
+		}
+		pws->max_block = block_size;
+	}
+
+	pws->M = M;
+	pws->N = N;
+	pws->layout = layout;
+	pws->vbonds     = shape_matrix(pws->rows[0], pws->blocks[0], M, N, 0);
+	pws->hbonds     = shape_matrix(pws->rows[1], pws->blocks[1], M, N, 0);
+	pws->site_marks = shape_matrix(pws->rows[2], pws->blocks[2], M, N,
+		SITECHAR);
+}
+
+// ----------------------------------------------------------------
+tile_labeling_t* perco_ws_tile_labeling(perco_ws_t* pws, int M, int N)
+{
+	if (pws->plab == 0)
+		pws->plab = tile_labeling_alloc(M, N);
+	else if ((pws->plab->M != M) || (pws->plab->N != N))
+		tile_labeling_size(pws->plab, M, N);
+	return pws->plab;
+}
+
+// ----------------------------------------------------------------
+void perco_ws_reserve_wrap(perco_ws_t* pws, int M, int N)
+{
+	int MN = M*N;
+
+	if (MN <= pws->max_wrap_sites)
+		return;
+	large_free(pws->wrap_parent);
+	large_free(pws->wrap_di);
+	large_free(pws->wrap_dj);
+	pws->wrap_parent = (int*)large_alloc_or_die(MN * sizeof(int));
+	pws->wrap_di     = (int*)large_alloc_or_die(MN * sizeof(int));
+	pws->wrap_dj     = (int*)large_alloc_or_die(MN * sizeof(int));
+	pws->max_wrap_sites = MN;
+}
+
+// ----------------------------------------------------------------
+void perco_ws_reserve_padded(perco_ws_t* pws, int M, int N)
+{
+	int n;
+
+	check_lattice_size(M, N);
+	n = (M+2) * (N+2);
+	if (n <= pws->max_pad_elements)
+		return;
+	large_free(pws->pad_canon);
+	large_free(pws->pad_row_of);
+	large_free(pws->pad_col_of);
+	pws->pad_canon  = (int*)large_alloc_or_die(n * sizeof(int));
+	pws->pad_row_of = (int*)large_alloc_or_die(n * sizeof(int));
+	pws->pad_col_of = (int*)large_alloc_or_die(n * sizeof(int));
+	pws->max_pad_elements = n;
+	pws->pad_M = -1;
+}
+
+// ----------------------------------------------------------------
+// Stamps start at 0 and the epochs at 2, so a fresh array has no site
+// reached.  When the epochs run out, the stamps are cleared and they start
+// over.
+void perco_ws_start_bfs(perco_ws_t* pws, int M, int N)
+{
+	int MN = M*N;
+	int k;
+
+	if (MN > pws->max_bfs_sites) {
+		large_free(pws->bfs_stamp);
+		large_free(pws->bfs_dist);
+		pws->bfs_stamp = (int*)large_alloc_or_die(MN * sizeof(int));
+		pws->bfs_dist  = (int*)large_alloc_or_die(MN * sizeof(int));
+		pws->max_bfs_sites = MN;
+		pws->bfs_epoch = INT_MAX;
+	}
+	if (pws->bfs_epoch >= INT_MAX - 2) {
+		for (k = 0; k < pws->max_bfs_sites; k++)
+			pws->bfs_stamp[k] = 0;
+		pws->bfs_epoch = 0;
+	}
+	pws->bfs_epoch += 2;
+
+	for (k = 0; k < 2; k++) {
+		if (pws->rings[k].sites == 0) {
+			pws->rings[k].sites = (int*)malloc_or_die(
+				RING_INITIAL_SITES * sizeof(int));
+			pws->rings[k].mask = RING_INITIAL_SITES - 1;
+		}
+		pws->rings[k].head  = 0;
+		pws->rings[k].count = 0;
+	}
+}
+
+// ----------------------------------------------------------------
+perco_ws_t* perco_ws_bind(perco_ws_t* pws)
+{
+	perco_ws_t* pprev = pbound_ws;
+	pbound_ws = pws;
+	return pprev;
+}
+
+static void free_thread_ws(void* pvws)
+{
+	perco_ws_free((perco_ws_t*)pvws);
+}
+
+static void make_thread_ws_key(void)
+{
+	if (pthread_key_create(&thread_ws_key, free_thread_ws) != 0) {
+		fprintf(stderr, "perco_ws_current:  pthread_key_create failed.\n");
+		exit(1);
+	}
+}
+
+perco_ws_t* perco_ws_current(void)
+{
+	perco_ctx_t* pctx;
+	perco_ws_t* pws;
+
+	if (pbound_ws)
+		return pbound_ws;
+	pctx = perco_ctx_current();
+	if (pctx)
+		return pctx->pws;
+
+	pthread_once(&thread_ws_once, make_thread_ws_key);
+	pws = (perco_ws_t*)pthread_getspecific(thread_ws_key);
+	if (pws == 0) {
+		pws = perco_ws_alloc(0, 0);
+		pthread_setspecific(thread_ws_key, pws);
+	}
+	return pws;
+}
@@ -0,0 +1,126 @@
+// ================================================================
+// PERCO2WS.H
+//
+// A workspace holds the scratch arrays of the estimators and cluster
+// labelers, so that their repetition loops make no heap calls:  the
+// cluster-size table, the depth-first search stacks, the union-find and
+// cluster tables of the tiled labelers in perco2tile.h, the union-find of the
+// wrapping detector in perco2wrap.h, the breadth-first search queues of
+// perco2chem.h, and the lookup tables of the padded layout in perco2pad.h.
+// It may also hold one lattice's vbonds, hbonds, and site_marks.
+//
+// The arrays only grow.  A workspace reserved or shaped for the largest
+// lattice of a job then serves every smaller one without reallocating, and
+// after the first repetition at a given size nothing more is allocated.
+// "./perco2 benchlabel" and "./perco2 benchavg" print the number of heap
+// calls per repetition, which should be 0.
+//
+// The routines in perco2lib.h, perco2pad.h, and perco2tile.h use
+// perco_ws_current():  the workspace bound to the calling thread with
+// perco_ws_bind(), else that of the context from perco2ctx.h bound to it,
+// else one belonging to the thread, made on first use and freed when the
+// thread exits.  A workspace must not be used by two threads at once.
+//
+// The arrays come from large_alloc_or_die() in perco2mem.h, so that with
+// mem=thp or mem=hugetlb they are on huge pages, and on the NUMA node of the
+// thread which first lays out or fills them.
+// ================================================================
+
+#ifndef PERCO2WS_H
+#define PERCO2WS_H
+
+#include "perco2tile.h"
+
+// A FIFO of site numbers in a power-of-two ring buffer, which doubles when
+// full, so that a breadth-first search needs room only for its frontier.
+typedef struct _site_ring_t {
+	int* sites;
+	int  mask;   // Capacity less 1
+	int  head;   // Where the oldest entry is
+	int  count;
+} site_ring_t;
+
+typedef struct _perco_ws_t {
+	// The lattice, laid out by perco_ws_shape().
+	int   M, N;
+	int   layout;             // LAYOUT_PLAIN or LAYOUT_PADDED
+	int** vbonds;
+	int** hbonds;
+	int** site_marks;
+	int** rows[3];            // Row pointers of the three matrices
+	int*  blocks[3];          // Their elements
+	int   max_rows;
+	size_t max_block;
+
+	// Scratch, with room for max_sites elements each.
+	int   max_sites;
+	int*  cluster_sizes;      // Indexed by cluster number
+	int*  stack;              // Sites still to be visited
+	int*  frame_sites;        // Depth-first search frames:  site, and
+	unsigned char* frame_dirs; // the next direction to try
+
+	tile_labeling_t* plab;    // Null until first used
+
+	// The union-find of perco2wrap.h, also allocated on first use:  each
+	// site's parent, or minus its cluster's size at a root, and its
+	// displacement to the parent.
+	int   max_wrap_sites;
+	int*  wrap_parent;
+	int*  wrap_di;
+	int*  wrap_dj;
+
+	// The breadth-first searches of perco2chem.h, also allocated on first
+	// use:  a site has been reached in the current search from side k if
+	// bfs_stamp[site] is bfs_epoch+k, at distance bfs_dist[site].  The
+	// epoch moves on with each search, so that nothing need be cleared.
+	int   max_bfs_sites;
+	int*  bfs_stamp;
+	int*  bfs_dist;
+	int   bfs_epoch;
+	site_ring_t rings[2];
+
+	// The padded layout's lookup tables of perco2pad.c, also allocated on
+	// first use, with room for max_pad_elements each.  They are filled for
+	// a pad_M by pad_N lattice with boundary condition pad_bc; pad_M is -1
+	// when they are not filled.
+	int   max_pad_elements;
+	int   pad_M, pad_N, pad_bc;
+	int*  pad_canon;
+	int*  pad_row_of;
+	int*  pad_col_of;
+} perco_ws_t;
+
+// A workspace with scratch for an M by N lattice, which may be 0 by 0.
+perco_ws_t* perco_ws_alloc(int M, int N);
+void perco_ws_free(perco_ws_t* pws);
+
+// Makes sure the scratch arrays hold at least M*N elements.  This leaves
+// the lattice alone.
+void perco_ws_reserve(perco_ws_t* pws, int M, int N);
+
+// Lays out pws->vbonds, hbonds, and site_marks for an M by N lattice in the
+// current layout, filled as by allocate_matrix(), and reserves scratch for
+// it.  Does nothing if they are already of that size and layout.  The
+// matrices must not be passed to free_matrix().
+void perco_ws_shape(perco_ws_t* pws, int M, int N);
+
+// The tiled labelers' tables, sized for an M by N lattice.
+tile_labeling_t* perco_ws_tile_labeling(perco_ws_t* pws, int M, int N);
+
+// Makes sure the wrap_* arrays hold at least M*N elements.
+void perco_ws_reserve_wrap(perco_ws_t* pws, int M, int N);
+
+// Makes sure the pad_* tables hold at least (M+2)*(N+2) elements.  If they
+// are reallocated, pad_M is set to -1.
+void perco_ws_reserve_padded(perco_ws_t* pws, int M, int N);
+
+// Makes sure the bfs_* arrays hold at least M*N elements, and starts a new
+// search epoch, with both rings empty.
+void perco_ws_start_bfs(perco_ws_t* pws, int M, int N);
+
+// Makes the calling thread use the workspace until the next call; null goes
+// back to the default described above.  Returns the previously bound one.
+perco_ws_t* perco_ws_bind(perco_ws_t* pws);
+perco_ws_t* perco_ws_current(void);
+
+#endif // PERCO2WS_H
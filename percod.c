@@ -0,0 +1,245 @@
+// ================================================================
+// PERCOD.C
+// Please see the comments in percod.h for information.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "putil.h"
+#include "percod.h"
+#include "perco2lib.h"
+#include "perco2mem.h"
+#include "rcmrand.h"
+
+// ----------------------------------------------------------------
+percod_lattice_t* percod_alloc(int D, int dims[])
+{
+	percod_lattice_t* plat;
+	long long nsites = 1;
+	int k;
+
+	if ((D < 2) || (D > PERCOD_MAXD)) {
+		fprintf(stderr, "percod_alloc:  dimension must be 2 or 3; got %d.\n",
+			D);
+		exit(1);
+	}
+	for (k = 0; k < D; k++) {
+		if (dims[k] < 3) {
+			fprintf(stderr,
+				"percod_alloc:  side lengths must be >= 3; got %d.\n",
+				dims[k]);
+			exit(1);
+		}
+		nsites *= dims[k];
+	}
+	// Flat indices are ints, and a neighbor step forms x + strides[0] before
+	// wrapping, so that must fit as well as nsites itself.
+	if (nsites + nsites / dims[0] > INT_MAX) {
+		fprintf(stderr, "percod_alloc:  lattice of %lld sites is too large:  "
+			"at most about %d.\n", nsites, INT_MAX / 4 * 3);
+		exit(1);
+	}
+
+	plat = (percod_lattice_t*)malloc_or_die(sizeof(percod_lattice_t));
+	memset(plat, 0, sizeof(percod_lattice_t));
+	plat->D = D;
+	plat->nsites = 1;
+	for (k = D-1; k >= 0; k--) {
+		plat->dims[k]    = dims[k];
+		plat->strides[k] = plat->nsites;
+		plat->nsites    *= dims[k];
+		plat->spans[k]   = plat->nsites;
+	}
+
+	for (k = 0; k < D; k++) {
+		plat->bonds[k] = (unsigned char*)large_alloc_or_die(plat->nsites);
+		memset(plat->bonds[k], 0, plat->nsites);
+	}
+	plat->edges         = (unsigned char*)large_alloc_or_die(plat->nsites);
+	plat->site_marks    = (int*)large_alloc_or_die(nsites * sizeof(int));
+	plat->stack         = (int*)large_alloc_or_die(nsites * sizeof(int));
+	plat->cluster_sizes = (int*)large_alloc_or_die(nsites * sizeof(int));
+
+	percod_set_boundary_condition(plat, BC_PERIODIC);
+
+	return plat;
+}
+
+// ----------------------------------------------------------------
+// The neighbor steps in percod_body.h subtract or add spans[k] when the edge
+// bit is set.  For periodic boundary conditions that wraps along axis k only;
+// for helical boundary conditions the wrap is over the whole lattice, taken
+// exactly when the flat index would leave [0, nsites).
+void percod_set_boundary_condition(percod_lattice_t* plat, int bc)
+{
+	int c[PERCOD_MAXD];
+	int k, x;
+
+	if ((bc != BC_PERIODIC) && (bc != BC_HELICAL)) {
+		fprintf(stderr,
+			"percod_set_boundary_condition:  unknown boundary condition %d.\n",
+			bc);
+		exit(1);
+	}
+	plat->bc = bc;
+
+	for (k = 0; k < plat->D; k++) {
+		if (bc == BC_HELICAL)
+			plat->spans[k] = plat->nsites;
+		else
+			plat->spans[k] = plat->dims[k] * plat->strides[k];
+	}
+
+	for (x = 0; x < plat->nsites; x++) {
+		percod_coords(plat, x, c);
+		plat->edges[x] = 0;
+		for (k = 0; k < plat->D; k++) {
+			if (bc == BC_HELICAL) {
+				if (x - plat->strides[k] < 0)
+					plat->edges[x] |= 1 << (2*k);
+				if (x + plat->strides[k] >= plat->nsites)
+					plat->edges[x] |= 1 << (2*k+1);
+			}
+			else {
+				if (c[k] == 0)
+					plat->edges[x] |= 1 << (2*k);
+				if (c[k] == plat->dims[k]-1)
+					plat->edges[x] |= 1 << (2*k+1);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+void percod_free(percod_lattice_t* plat)
+{
+	int k;
+	for (k = 0; k < plat->D; k++)
+		large_free(plat->bonds[k]);
+	large_free(plat->edges);
+	large_free(plat->site_marks);
+	large_free(plat->stack);
+	large_free(plat->cluster_sizes);
+	free(plat);
+}
+
+// ----------------------------------------------------------------
+int percod_site(percod_lattice_t* plat, int coords[])
+{
+	int k, x = 0;
+	for (k = 0; k < plat->D; k++)
+		x += coords[k] * plat->strides[k];
+	return x;
+}
+
+void percod_coords(percod_lattice_t* plat, int x, int coords[])
+{
+	int k;
+	for (k = 0; k < plat->D; k++) {
+		coords[k] = x / plat->strides[k];
+		x        -= coords[k] * plat->strides[k];
+	}
+}
+
+// ----------------------------------------------------------------
+int percod_A1(percod_lattice_t* plat)
+{
+	int c[PERCOD_MAXD];
+	int k;
+	for (k = 0; k < plat->D; k++)
+		c[k] = plat->dims[k]/2;
+	return percod_site(plat, c);
+}
+
+void percod_A1_A2(percod_lattice_t* plat, int* pA1, int* pA2)
+{
+	int c[PERCOD_MAXD];
+	int k;
+	for (k = 0; k < plat->D; k++)
+		c[k] = plat->dims[k]/2;
+	*pA1 = percod_site(plat, c);
+	c[0] = (c[0] + 1) % plat->dims[0];
+	c[1] = (c[1] + 1) % plat->dims[1];
+	*pA2 = percod_site(plat, c);
+}
+
+// ================================================================
+// The dimension-specialized routines.
+
+#define PD_D 2
+#define PD_FN(name) percod_2d_##name
+#include "percod_body.h"
+#undef PD_FN
+#undef PD_D
+
+#define PD_D 3
+#define PD_FN(name) percod_3d_##name
+#include "percod_body.h"
+#undef PD_FN
+#undef PD_D
+
+// ================================================================
+// Dispatchers.  The dimension is checked once per call, outside any loop over
+// sites.
+
+#define PERCOD_DISPATCH(plat, name, args) \
+	((plat)->D == 3 ? percod_3d_##name args : percod_2d_##name args)
+
+void percod_populate_bonds(percod_lattice_t* plat, double p)
+{
+	PERCOD_DISPATCH(plat, populate_bonds, (plat, p));
+}
+
+int percod_get_bonded_neighbors(percod_lattice_t* plat, int x,
+	int neighbors[2*PERCOD_MAXD])
+{
+	return PERCOD_DISPATCH(plat, get_bonded_neighbors, (plat, x, neighbors));
+}
+
+int percod_mark_one_cluster(percod_lattice_t* plat, int x, int mark_value)
+{
+	return PERCOD_DISPATCH(plat, mark_one_cluster, (plat, x, mark_value));
+}
+
+int percod_A1_oo_A2(percod_lattice_t* plat, int x, int y)
+{
+	return PERCOD_DISPATCH(plat, A1_oo_A2, (plat, x, y));
+}
+
+int percod_mark_cluster_numbers(percod_lattice_t* plat)
+{
+	return PERCOD_DISPATCH(plat, mark_cluster_numbers, (plat));
+}
+
+int percod_get_cluster_sizes(percod_lattice_t* plat, int num_clusters)
+{
+	return PERCOD_DISPATCH(plat, get_cluster_sizes, (plat, num_clusters));
+}
+
+double percod_P_A_in_C(percod_lattice_t* plat, double p, int reps)
+{
+	return PERCOD_DISPATCH(plat, P_A_in_C, (plat, p, reps));
+}
+
+double percod_P_A1_or_A2_in_C(percod_lattice_t* plat, double p, int reps)
+{
+	return PERCOD_DISPATCH(plat, P_A1_or_A2_in_C, (plat, p, reps));
+}
+
+double percod_P_A1_oo_A2(percod_lattice_t* plat, double p, int reps)
+{
+	return PERCOD_DISPATCH(plat, P_A1_oo_A2, (plat, p, reps));
+}
+
+double percod_get_mean_C0_size(percod_lattice_t* plat, double p, int reps)
+{
+	return PERCOD_DISPATCH(plat, get_mean_C0_size, (plat, p, reps));
+}
+
+double percod_get_corrlen(percod_lattice_t* plat, double p, int reps)
+{
+	return PERCOD_DISPATCH(plat, get_corrlen, (plat, p, reps));
+}
@@ -0,0 +1,149 @@
+// ================================================================
+// PERCOD.H
+//
+// These routines are for bond percolation on the d-dimensional cubic lattice
+// with periodic (or helical) boundary conditions, for d = 2 and d = 3.  They compute the
+// same quantities as the 2D routines in perco2lib.h -- theta, sigma, tau, the
+// correlation length, and the mean size of the cluster at the origin -- but
+// the dimension is a compile-time parameter rather than the fixed '#define d
+// 2' of perco2lib.h.
+//
+// ================================================================
+// STORAGE REPRESENTATION
+//
+// Unlike perco2lib, these routines keep the lattice in a struct, with each
+// per-site array stored flat (one dimensional) in row-major order:
+//
+// * dims[0] .. dims[D-1] are the side lengths.  For D=2 these are M (rows)
+//   and N (columns), as in perco2lib.h; for D=3 the third is L.
+// * Site x has coordinates (c_0, ..., c_{D-1}), with
+//   x = c_0*strides[0] + ... + c_{D-1}*strides[D-1] and strides[D-1] = 1.
+// * There is one bond plane per axis:  bonds[k][x] is 1 if the bond from x to
+//   x + e_k is open.  For D=2, bonds[0] is perco2lib's vbonds (indexed by the
+//   site above) and bonds[1] is hbonds (indexed by the site left).
+// * edges[x] has bit 2k set if c_k == 0, and bit 2k+1 set if c_k == dims[k]-1.
+//   This lets a neighbor step wrap around the torus with a multiply by 0 or 1
+//   rather than with a compare-and-branch.
+//
+// Helical boundary conditions (BC_HELICAL in perco2lib.h) are also supported:
+// the neighbors of x are x +/- strides[k] mod nsites.  This is done by
+// setting every spans[k] to nsites and setting the edge bits where the flat
+// index would leave [0, nsites), so the neighbor steps are unchanged.
+//
+// The routines with "_2d" and "_3d" in their names are generated from a
+// single source (percod_body.h) with the dimension fixed at compile time, so
+// the loops over axes are fully unrolled.  The routines without a dimension
+// in their names check plat->D once and call the appropriate one of those.
+//
+// For D=2, populate_bonds() draws random numbers in the same order as
+// perco2lib's populate_bonds(), and the cluster numbers agree with
+// perco2lib's mark_cluster_numbers().  So, with the same seed, the two
+// libraries give the same answers.
+//
+#ifndef PERCOD_H
+#define PERCOD_H
+
+// Largest dimension supported.
+#define PERCOD_MAXD 3
+
+// Critical bond densities for the square and simple-cubic lattices.
+#define PERCOD_P_C_2D 0.5
+#define PERCOD_P_C_3D 0.2488126
+
+typedef struct _percod_lattice_t {
+	int D;                         // 2 or 3
+	int dims   [PERCOD_MAXD];      // Side lengths
+	int strides[PERCOD_MAXD];      // Flat-index step along each axis
+	int spans  [PERCOD_MAXD];      // dims[k] * strides[k], or nsites if helical
+	int bc;                        // BC_PERIODIC or BC_HELICAL
+	int nsites;                    // Product of the side lengths
+	unsigned char* bonds[PERCOD_MAXD]; // One bond plane per axis
+	unsigned char* edges;          // Boundary bits, as described above
+	int* site_marks;               // Workspace:  cluster numbers or visit marks
+	int* stack;                    // Workspace:  depth-first-search stack
+	int* cluster_sizes;            // Workspace:  one entry per cluster
+} percod_lattice_t;
+
+// ----------------------------------------------------------------
+// Allocates a lattice with the given dimension D and side lengths dims[0] ..
+// dims[D-1], with all bonds closed.  Each side length must be at least 3.
+// The caller should use percod_free() to release the memory.
+percod_lattice_t* percod_alloc(int D, int dims[]);
+void percod_free(percod_lattice_t* plat);
+
+// Sets the boundary condition, BC_PERIODIC (the default) or BC_HELICAL, as
+// defined in perco2lib.h.
+void percod_set_boundary_condition(percod_lattice_t* plat, int bc);
+
+// Converts between flat site indices and coordinates.
+int  percod_site(percod_lattice_t* plat, int coords[]);
+void percod_coords(percod_lattice_t* plat, int x, int coords[]);
+
+// A1 is the center site (dims[0]/2, dims[1]/2, ...).  A2 is diagonally
+// opposite A1 on a unit square, i.e. A1 + e_0 + e_1, as in perco2lib's
+// set_A1_A2().
+int  percod_A1(percod_lattice_t* plat);
+void percod_A1_A2(percod_lattice_t* plat, int* pA1, int* pA2);
+
+// ----------------------------------------------------------------
+// These are the same as their namesakes in perco2lib.h, except that sites are
+// flat indices.  Each one dispatches to the _2d or _3d version.
+
+// Populates lattice bonds, IID and open with probability p.
+void percod_populate_bonds(percod_lattice_t* plat, double p);
+
+// Writes the up-to-2D bonded neighbors of site x to neighbors[] and returns
+// their number.
+int percod_get_bonded_neighbors(percod_lattice_t* plat, int x,
+	int neighbors[2*PERCOD_MAXD]);
+
+// Writes mark_value into site_marks[] at each site of the cluster containing
+// x, returning the cluster size.  Other elements of site_marks[] are left
+// unmodified.
+int percod_mark_one_cluster(percod_lattice_t* plat, int x, int mark_value);
+
+// Returns 1 if there is an open path from x to y, else 0.
+int percod_A1_oo_A2(percod_lattice_t* plat, int x, int y);
+
+// Writes cluster numbers 0, 1, 2, ... into site_marks[], numbered in order of
+// each cluster's first site, and returns the number of clusters.
+int percod_mark_cluster_numbers(percod_lattice_t* plat);
+
+// Fills plat->cluster_sizes[] and returns the number of the largest cluster.
+// percod_mark_cluster_numbers() must have been called first.
+int percod_get_cluster_sizes(percod_lattice_t* plat, int num_clusters);
+
+// ----------------------------------------------------------------
+// Estimators over reps realizations, populating bonds each time.  These
+// correspond to the perco2 commands PAinC, PU2inC, P1o2, meanC0size, and
+// corrlen.
+double percod_P_A_in_C        (percod_lattice_t* plat, double p, int reps);
+double percod_P_A1_or_A2_in_C (percod_lattice_t* plat, double p, int reps);
+double percod_P_A1_oo_A2      (percod_lattice_t* plat, double p, int reps);
+double percod_get_mean_C0_size(percod_lattice_t* plat, double p, int reps);
+double percod_get_corrlen     (percod_lattice_t* plat, double p, int reps);
+
+// ----------------------------------------------------------------
+// The dimension-specialized versions, generated from percod_body.h.
+#define PERCOD_PROTOTYPES(SFX) \
+void   percod_##SFX##_populate_bonds(percod_lattice_t* plat, double p); \
+int    percod_##SFX##_get_bonded_neighbors(percod_lattice_t* plat, int x, \
+	int neighbors[2*PERCOD_MAXD]); \
+int    percod_##SFX##_mark_one_cluster(percod_lattice_t* plat, int x, \
+	int mark_value); \
+int    percod_##SFX##_A1_oo_A2(percod_lattice_t* plat, int x, int y); \
+int    percod_##SFX##_mark_cluster_numbers(percod_lattice_t* plat); \
+int    percod_##SFX##_get_cluster_sizes(percod_lattice_t* plat, \
+	int num_clusters); \
+double percod_##SFX##_P_A_in_C(percod_lattice_t* plat, double p, int reps); \
+double percod_##SFX##_P_A1_or_A2_in_C(percod_lattice_t* plat, double p, \
+	int reps); \
+double percod_##SFX##_P_A1_oo_A2(percod_lattice_t* plat, double p, int reps); \
+double percod_##SFX##_get_mean_C0_size(percod_lattice_t* plat, double p, \
+	int reps); \
+double percod_##SFX##_get_corrlen(percod_lattice_t* plat, double p, int reps);
+
+PERCOD_PROTOTYPES(2d)
+PERCOD_PROTOTYPES(3d)
+
+#endif // PERCOD_H
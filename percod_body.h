@@ -0,0 +1,266 @@
+// ================================================================
+// PERCOD_BODY.H
+//
+// This is the dimension-generic body of percod.c.  It is included by percod.c
+// once per supported dimension, with PD_D defined as the dimension and with
+// PD_FN(name) pasting the dimension into each routine name.  Since PD_D is a
+// compile-time constant, the "for (k = 0; k < PD_D; k++)" loops over axes
+// unroll completely.  This file should not be included anywhere else.
+//
+// Please see percod.h for a description of the routines.
+// ================================================================
+
+// ----------------------------------------------------------------
+// Site one step from x along axis k, in the + or - direction, wrapping around
+// the torus.  The edge bit is 0 or 1, so there is no branch.
+static inline int PD_FN(plus)(percod_lattice_t* plat, int x, int k)
+{
+	int wrap = (plat->edges[x] >> (2*k+1)) & 1;
+	return x + plat->strides[k] - wrap * plat->spans[k];
+}
+
+static inline int PD_FN(minus)(percod_lattice_t* plat, int x, int k)
+{
+	int wrap = (plat->edges[x] >> (2*k)) & 1;
+	return x - plat->strides[k] + wrap * plat->spans[k];
+}
+
+// ----------------------------------------------------------------
+void PD_FN(populate_bonds)(percod_lattice_t* plat, double p)
+{
+	int x, k;
+	for (x = 0; x < plat->nsites; x++)
+		for (k = 0; k < PD_D; k++)
+			plat->bonds[k][x] = (URANDOM() < p) ? 1 : 0;
+}
+
+// ----------------------------------------------------------------
+// Neighbors are listed in the same order as in perco2lib's
+// get_bonded_neighbors():  first the + direction along each axis, then the -
+// direction along each axis.  For D=2 that is down, right, up, left.
+int PD_FN(get_bonded_neighbors)(percod_lattice_t* plat, int x,
+	int neighbors[2*PERCOD_MAXD])
+{
+	int numnei = 0;
+	int k, y;
+
+	for (k = 0; k < PD_D; k++)
+		if (plat->bonds[k][x])
+			neighbors[numnei++] = PD_FN(plus)(plat, x, k);
+	for (k = 0; k < PD_D; k++) {
+		y = PD_FN(minus)(plat, x, k);
+		if (plat->bonds[k][y])
+			neighbors[numnei++] = y;
+	}
+	return numnei;
+}
+
+// ----------------------------------------------------------------
+// This is an iterative depth-first search using the stack in the lattice
+// struct.  Sites are marked when pushed, so the stack never holds more than
+// nsites entries.
+int PD_FN(mark_one_cluster)(percod_lattice_t* plat, int x, int mark_value)
+{
+	int* site_marks = plat->site_marks;
+	int* stack = plat->stack;
+	int neighbors[2*PERCOD_MAXD];
+	int numnei, m;
+	int sp = 0;
+	int size = 0;
+
+	site_marks[x] = mark_value;
+	stack[sp++] = x;
+	while (sp > 0) {
+		x = stack[--sp];
+		size++;
+		numnei = PD_FN(get_bonded_neighbors)(plat, x, neighbors);
+		for (m = 0; m < numnei; m++) {
+			int y = neighbors[m];
+			if (site_marks[y] != mark_value) {
+				site_marks[y] = mark_value;
+				stack[sp++] = y;
+			}
+		}
+	}
+	return size;
+}
+
+// ----------------------------------------------------------------
+// Same as mark_one_cluster(), but stops as soon as y is reached.
+int PD_FN(A1_oo_A2)(percod_lattice_t* plat, int x, int y)
+{
+	int* site_marks = plat->site_marks;
+	int* stack = plat->stack;
+	int neighbors[2*PERCOD_MAXD];
+	int numnei, m;
+	int sp = 0;
+
+	if (x == y)
+		return 1;
+	memset(site_marks, 0, plat->nsites * sizeof(int));
+	site_marks[x] = 1;
+	stack[sp++] = x;
+	while (sp > 0) {
+		x = stack[--sp];
+		numnei = PD_FN(get_bonded_neighbors)(plat, x, neighbors);
+		for (m = 0; m < numnei; m++) {
+			int z = neighbors[m];
+			if (z == y)
+				return 1;
+			if (!site_marks[z]) {
+				site_marks[z] = 1;
+				stack[sp++] = z;
+			}
+		}
+	}
+	return 0;
+}
+
+// ----------------------------------------------------------------
+int PD_FN(mark_cluster_numbers)(percod_lattice_t* plat)
+{
+	int* site_marks = plat->site_marks;
+	int cluster_number = 0;
+	int x;
+
+	for (x = 0; x < plat->nsites; x++)
+		site_marks[x] = -1;
+	for (x = 0; x < plat->nsites; x++) {
+		if (site_marks[x] >= 0) // Already marked
+			continue;
+		PD_FN(mark_one_cluster)(plat, x, cluster_number);
+		cluster_number++;
+	}
+	return cluster_number;
+}
+
+// ----------------------------------------------------------------
+int PD_FN(get_cluster_sizes)(percod_lattice_t* plat, int num_clusters)
+{
+	int* cluster_sizes = plat->cluster_sizes;
+	int x, k;
+	int largest = 0;
+
+	for (k = 0; k < num_clusters; k++)
+		cluster_sizes[k] = 0;
+	for (x = 0; x < plat->nsites; x++)
+		cluster_sizes[plat->site_marks[x]]++;
+	for (k = 0; k < num_clusters; k++)
+		if (cluster_sizes[k] > cluster_sizes[largest])
+			largest = k;
+	return largest;
+}
+
+// ----------------------------------------------------------------
+double PD_FN(P_A_in_C)(percod_lattice_t* plat, double p, int reps)
+{
+	int A = percod_A1(plat);
+	int num_A_in_C = 0;
+	int rep, num_clusters, C_clno;
+
+	for (rep = 0; rep < reps; rep++) {
+		PD_FN(populate_bonds)(plat, p);
+		num_clusters = PD_FN(mark_cluster_numbers)(plat);
+		C_clno = PD_FN(get_cluster_sizes)(plat, num_clusters);
+		if (plat->site_marks[A] == C_clno)
+			num_A_in_C++;
+	}
+	return (double)num_A_in_C/(double)reps;
+}
+
+// ----------------------------------------------------------------
+double PD_FN(P_A1_or_A2_in_C)(percod_lattice_t* plat, double p, int reps)
+{
+	int A1, A2;
+	int num_A1_or_A2_in_C = 0;
+	int rep, num_clusters, C_clno;
+
+	percod_A1_A2(plat, &A1, &A2);
+	for (rep = 0; rep < reps; rep++) {
+		PD_FN(populate_bonds)(plat, p);
+		num_clusters = PD_FN(mark_cluster_numbers)(plat);
+		C_clno = PD_FN(get_cluster_sizes)(plat, num_clusters);
+		if ((plat->site_marks[A1] == C_clno) ||
+			(plat->site_marks[A2] == C_clno))
+			num_A1_or_A2_in_C++;
+	}
+	return (double)num_A1_or_A2_in_C/(double)reps;
+}
+
+// ----------------------------------------------------------------
+double PD_FN(P_A1_oo_A2)(percod_lattice_t* plat, double p, int reps)
+{
+	int A1, A2;
+	double nctd = 0.0;
+	int rep;
+
+	percod_A1_A2(plat, &A1, &A2);
+	for (rep = 0; rep < reps; rep++) {
+		PD_FN(populate_bonds)(plat, p);
+		if (PD_FN(A1_oo_A2)(plat, A1, A2))
+			nctd += 1.0;
+	}
+	return nctd / reps;
+}
+
+// ----------------------------------------------------------------
+double PD_FN(get_mean_C0_size)(percod_lattice_t* plat, double p, int reps)
+{
+	int A = percod_A1(plat);
+	double mean_C0_size = 0.0;
+	int rep;
+
+	for (rep = 0; rep < reps; rep++) {
+		PD_FN(populate_bonds)(plat, p);
+		memset(plat->site_marks, 0, plat->nsites * sizeof(int));
+		mean_C0_size += PD_FN(mark_one_cluster)(plat, A, 1);
+	}
+	return mean_C0_size / reps;
+}
+
+// ----------------------------------------------------------------
+// Please see the comments above get_corrlen() in perco2lib.c.  As there,
+// distances from A are measured without wrapping around the torus.
+double PD_FN(get_corrlen)(percod_lattice_t* plat, double p, int reps)
+{
+	int A = percod_A1(plat);
+	int Ac[PD_D], c[PD_D];
+	int rep, x, k;
+	int num_clusters, A_clno, largest_clno;
+	double upper_sum = 0.0;
+	double lower_sum = 0.0;
+
+	percod_coords(plat, A, Ac);
+	for (rep = 0; rep < reps; rep++) {
+		PD_FN(populate_bonds)(plat, p);
+		num_clusters = PD_FN(mark_cluster_numbers)(plat);
+		largest_clno = PD_FN(get_cluster_sizes)(plat, num_clusters);
+		A_clno = plat->site_marks[A];
+		if (A_clno == largest_clno)
+			continue;
+
+		// Walk the coordinates along with x, odometer-style, rather than
+		// dividing x out into coordinates at each site.
+		for (k = 0; k < PD_D; k++)
+			c[k] = 0;
+		for (x = 0; x < plat->nsites; x++) {
+			if (plat->site_marks[x] == A_clno) {
+				int normx2 = 0;
+				for (k = 0; k < PD_D; k++)
+					normx2 += (c[k] - Ac[k]) * (c[k] - Ac[k]);
+				upper_sum += normx2;
+				lower_sum++;
+			}
+			for (k = PD_D-1; k >= 0; k--) {
+				if (++c[k] < plat->dims[k])
+					break;
+				c[k] = 0;
+			}
+		}
+	}
+
+	if (lower_sum == 0.0)
+		return 0.0;
+	else
+		return sqrt(upper_sum / lower_sum);
+}
@@ -16,6 +16,11 @@
 #include <sys/time.h>
 #include "psdes.h"
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PSDES_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 // ================================================================
 // A 64-bit in-place hash, loosely inspired by DES.
 // From _Numerical Recipes in C_.
@@ -63,9 +68,11 @@ void psdes_hash_64(
 // ================================================================
 // The remaining routines are wrappers around psdes_hash_64.
 
-static unsigned non_reentrant_state0 = 0;
-static unsigned non_reentrant_state1 = 0;
-static unsigned non_reentrant_seeded = 0;
+// The state for the routines without "_r" is per thread, so that threads
+// using them do not race; each thread seeds its own.
+static __thread unsigned non_reentrant_state0 = 0;
+static __thread unsigned non_reentrant_state1 = 0;
+static __thread unsigned non_reentrant_seeded = 0;
 
 // ----------------------------------------------------------------
 unsigned iran32(void)
@@ -161,3 +168,180 @@ void sran32_tod_r(unsigned * pstate0, unsigned * pstate1)
 	*pstate0 = getpid() ^ tod.tv_usec;
 	*pstate1 = tod.tv_sec ^ (tod.tv_usec * tod.tv_usec + 1);
 }
+
+// ================================================================
+// Bulk generation.  Since output k is just the hash of the state plus k, the
+// hashes of consecutive states are independent of one another and can be
+// computed several at a time, one per SIMD lane:  8 lanes with AVX2, or 16
+// with AVX-512.  Each lane does exactly the 32-bit arithmetic of
+// psdes_hash_64() above, so the results are bit-identical.  The instruction
+// set is chosen at run time.
+
+static unsigned psdes_c1[NITER] = {
+	0xbaa96887, 0x1e17d32c, 0x03bcdc3c, 0x0f33d1b2 };
+static unsigned psdes_c2[NITER] = {
+	0x4b0f3b58, 0xe874f0c3, 0x6955c5a6, 0x55a7ca46 };
+
+// ----------------------------------------------------------------
+// Scalar:  n outputs from states (s0, s1), (s0, s1+1), ..., with carry.
+static void iran32_fill_scalar(unsigned* out, int n,
+	unsigned* pstate0, unsigned* pstate1)
+{
+	int k;
+	for (k = 0; k < n; k++)
+		out[k] = iran32_r(pstate0, pstate1);
+}
+
+#ifdef PSDES_HAVE_X86_SIMD
+// ----------------------------------------------------------------
+// Eight lanes.  The caller ensures that state1 + 7 does not wrap, so all
+// lanes share state0.
+__attribute__((target("avx2")))
+static void psdes_hash_8_avx2(unsigned state0, unsigned state1, unsigned* out)
+{
+	__m256i w0 = _mm256_set1_epi32(state0);
+	__m256i w1 = _mm256_add_epi32(_mm256_set1_epi32(state1),
+		_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	__m256i lo16 = _mm256_set1_epi32(0xffff);
+	__m256i ones = _mm256_set1_epi32(-1);
+	int i;
+
+	for (i = 0; i < NITER; i++) {
+		__m256i iswap = w1;
+		__m256i ia  = _mm256_xor_si256(iswap, _mm256_set1_epi32(psdes_c1[i]));
+		__m256i ial = _mm256_and_si256(ia, lo16);
+		__m256i iah = _mm256_srli_epi32(ia, 16);
+		__m256i ib  = _mm256_add_epi32(_mm256_mullo_epi32(ial, ial),
+			_mm256_xor_si256(_mm256_mullo_epi32(iah, iah), ones));
+		__m256i ic  = _mm256_or_si256(_mm256_srli_epi32(ib, 16),
+			_mm256_slli_epi32(ib, 16));
+		w1 = _mm256_xor_si256(w0, _mm256_add_epi32(
+			_mm256_xor_si256(ic, _mm256_set1_epi32(psdes_c2[i])),
+			_mm256_mullo_epi32(ial, iah)));
+		w0 = iswap;
+	}
+	_mm256_storeu_si256((__m256i*)out, w1);
+}
+
+// ----------------------------------------------------------------
+// Sixteen lanes.  The caller ensures that state1 + 15 does not wrap.
+__attribute__((target("avx512f")))
+static void psdes_hash_16_avx512(unsigned state0, unsigned state1,
+	unsigned* out)
+{
+	__m512i w0 = _mm512_set1_epi32(state0);
+	__m512i w1 = _mm512_add_epi32(_mm512_set1_epi32(state1),
+		_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+			8, 9, 10, 11, 12, 13, 14, 15));
+	__m512i lo16 = _mm512_set1_epi32(0xffff);
+	__m512i ones = _mm512_set1_epi32(-1);
+	int i;
+
+	for (i = 0; i < NITER; i++) {
+		__m512i iswap = w1;
+		__m512i ia  = _mm512_xor_si512(iswap, _mm512_set1_epi32(psdes_c1[i]));
+		__m512i ial = _mm512_and_si512(ia, lo16);
+		__m512i iah = _mm512_srli_epi32(ia, 16);
+		__m512i ib  = _mm512_add_epi32(_mm512_mullo_epi32(ial, ial),
+			_mm512_xor_si512(_mm512_mullo_epi32(iah, iah), ones));
+		__m512i ic  = _mm512_rol_epi32(ib, 16);
+		w1 = _mm512_xor_si512(w0, _mm512_add_epi32(
+			_mm512_xor_si512(ic, _mm512_set1_epi32(psdes_c2[i])),
+			_mm512_mullo_epi32(ial, iah)));
+		w0 = iswap;
+	}
+	_mm512_storeu_si512((void*)out, w1);
+}
+#endif // PSDES_HAVE_X86_SIMD
+
+// ----------------------------------------------------------------
+static int psdes_lanes = -1; // 1, 8, or 16, once known
+
+// The detection may race between threads, but they all store the same value.
+int psdes_simd_lanes(void)
+{
+	int lanes = __atomic_load_n(&psdes_lanes, __ATOMIC_RELAXED);
+	if (lanes < 0) {
+		lanes = 1;
+#ifdef PSDES_HAVE_X86_SIMD
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f"))
+			lanes = 16;
+		else if (__builtin_cpu_supports("avx2"))
+			lanes = 8;
+#endif
+		__atomic_store_n(&psdes_lanes, lanes, __ATOMIC_RELAXED);
+	}
+	return lanes;
+}
+
+void psdes_set_simd_lanes(int lanes)
+{
+	int max_lanes;
+	psdes_lanes = -1;
+	max_lanes = psdes_simd_lanes();
+	psdes_lanes = (lanes > max_lanes) ? max_lanes : lanes;
+	if ((psdes_lanes != 1) && (psdes_lanes != 8) && (psdes_lanes != 16))
+		psdes_lanes = 1;
+}
+
+// ----------------------------------------------------------------
+void iran32_fill_r(unsigned* out, int n, unsigned* pstate0, unsigned* pstate1)
+{
+#ifdef PSDES_HAVE_X86_SIMD
+	int lanes = psdes_simd_lanes();
+	int k = 0;
+
+	if (lanes > 1) {
+		while (n - k >= lanes) {
+			// A batch in which the low word would carry into the high
+			// word is done one at a time.
+			if (*pstate1 > 0xffffffffU - (unsigned)(lanes-1)) {
+				iran32_fill_scalar(&out[k], lanes, pstate0, pstate1);
+			}
+			else {
+				if (lanes == 16)
+					psdes_hash_16_avx512(*pstate0, *pstate1, &out[k]);
+				else
+					psdes_hash_8_avx2(*pstate0, *pstate1, &out[k]);
+				*pstate1 += lanes;
+				if (*pstate1 == 0)
+					(*pstate0)++;
+			}
+			k += lanes;
+		}
+	}
+	iran32_fill_scalar(&out[k], n - k, pstate0, pstate1);
+#else
+	iran32_fill_scalar(out, n, pstate0, pstate1);
+#endif
+}
+
+// ----------------------------------------------------------------
+void fran32_fill_r(double* out, int n, unsigned* pstate0, unsigned* pstate1)
+{
+	unsigned words[256];
+	int k, m, chunk;
+
+	for (k = 0; k < n; k += chunk) {
+		chunk = (n - k < 256) ? n - k : 256;
+		iran32_fill_r(words, chunk, pstate0, pstate1);
+		for (m = 0; m < chunk; m++)
+			out[k+m] = (double)( (double)words[m] / (double)4294967296.0 );
+	}
+}
+
+// ----------------------------------------------------------------
+void iran32_fill(unsigned* out, int n)
+{
+	if (!non_reentrant_seeded)
+		sran32_tod();
+	iran32_fill_r(out, n, &non_reentrant_state0, &non_reentrant_state1);
+}
+
+void fran32_fill(double* out, int n)
+{
+	if (!non_reentrant_seeded)
+		sran32_tod();
+	fran32_fill_r(out, n, &non_reentrant_state0, &non_reentrant_state1);
+}
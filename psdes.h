@@ -168,6 +168,25 @@ double    fran32_r(unsigned * pstate0, unsigned * pstate1);
 // This puts time-of-day information into your state variables.
 void     sran32_tod_r(unsigned * pstate0, unsigned * pstate1void);
 
+// ----------------------------------------------------------------
+// Bulk versions.  These write n outputs to out[], the same n values, in the
+// same order, as n calls to iran32() or fran32() (or their reentrant
+// versions) would return, leaving the state where those calls would.  They
+// hash 8 states at a time with AVX2, or 16 with AVX-512, when the CPU has
+// them.
+void iran32_fill(unsigned* out, int n);
+void fran32_fill(double*   out, int n);
+void iran32_fill_r(unsigned* out, int n,
+	unsigned * pstate0, unsigned * pstate1);
+void fran32_fill_r(double*   out, int n,
+	unsigned * pstate0, unsigned * pstate1);
+
+// The number of lanes the bulk versions use:  16, 8, or 1 (scalar), as
+// detected from the CPU.  psdes_set_simd_lanes() lowers it, e.g. for timing
+// comparisons; it cannot raise it past what the CPU supports.
+int  psdes_simd_lanes(void);
+void psdes_set_simd_lanes(int lanes);
+
 // ----------------------------------------------------------------
 // This is the 64-bit pseudo-DES in-place hash.
 void psdes_hash_64(
@@ -19,10 +19,13 @@
 #include <unistd.h>
 #include "putil.h"
 
+static long long malloc_count = 0;
+
 // ----------------------------------------------------------------
 void* malloc_or_die(int num_bytes)
 {
 	void* rv = malloc(num_bytes);
+	__atomic_fetch_add(&malloc_count, 1, __ATOMIC_RELAXED);
 	if (rv == 0) {
 		fprintf(stderr, "malloc(%d) failed.\n", num_bytes);
 		exit(1);
@@ -30,6 +33,23 @@ void* malloc_or_die(int num_bytes)
 	return rv;
 }
 
+long long get_malloc_count(void)
+{
+	return __atomic_load_n(&malloc_count, __ATOMIC_RELAXED);
+}
+
+void count_heap_call(void)
+{
+	__atomic_fetch_add(&malloc_count, 1, __ATOMIC_RELAXED);
+}
+
+// ----------------------------------------------------------------
+int num_online_cpus(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return (ncpus < 1) ? 1 : (int)ncpus;
+}
+
 // ----------------------------------------------------------------
 char* get_sys_time_string(void)
 {
@@ -41,6 +61,17 @@ char* get_sys_time_string(void)
 	return ctime(&now.tv_sec);
 }
 
+// ----------------------------------------------------------------
+double get_sys_time_float(void)
+{
+	struct timeval now;
+	if (gettimeofday(&now, 0) < 0) {
+		perror("gettimeofday");
+		exit(1);
+	}
+	return (double)now.tv_sec + (double)now.tv_usec * 1e-6;
+}
+
 // ----------------------------------------------------------------
 // If there is a file in the current directory called "__stop__", then quit.
 void check_stop(void)
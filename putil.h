@@ -16,9 +16,24 @@
 // and aborting the process if the request fails.
 void* malloc_or_die(int num_bytes);
 
+// The number of calls to malloc_or_die() so far, by all threads, and to
+// other allocators which call count_heap_call().  The benchmarks difference
+// this across their repetition loops, to check that those run without heap
+// calls once the workspace (perco2ws.h) is warm.
+long long get_malloc_count(void);
+void count_heap_call(void);
+
+// The number of online CPUs, or 1 if that cannot be found.  This is the
+// number of threads used when a command is asked for one per CPU.
+int num_online_cpus(void);
+
 // A keystroke-saving wrapper around gettimeofday() and ctime().
 char* get_sys_time_string(void);
 
+// Seconds since the epoch, with microsecond resolution.  Differences of these
+// are handy for timing.
+double get_sys_time_float(void);
+
 // Aborts the process if a file called "__stop__" exists in the current
 // directory.  This is a useful way to kill multi-processor jobs.
 void check_stop(void);
@@ -9,12 +9,15 @@
 // * pseudo-DES from Numerical Recipes, 2nd ed.
 // * rand48() from the standard C library.
 // * The Linux /dev/urandom stream.
+// * Any of the above, or xoshiro256++, PCG64, or Philox4x32-10, chosen at run
+//   time:  please see fastrng.h.  This is the default.
 //
 // The uses to which the generators are put in this software
 // application are:
 // * SRANDOM():      seed from 32-bit value.
 // * URANDOM():      uniform double on [0.0, 1.0).
 // * IMODRANDOM(m):  uniform int on {0, 1, 2, ..., m-1}.
+// * URANDOM_FILL(out,n): n URANDOM()s, in order, into out[0..n-1].
 // * RANDRANGE(lo,hi): uniform double on [lo, hi).
 // * RANDPM():       uniform on {+1, -1}.
 // ================================================================
@@ -39,9 +42,12 @@
 
 #include "urandom.h" // Linux /dev/urandom with caching.
 
+#include "fastrng.h" // Runtime-selectable generators.
+
 #define RCM_PSDES   1
 #define RCM_URANDOM 2
 #define RCM_RAND48  3
+#define RCM_RUNTIME 4
 
 // ================================================================
 // Here is where one specifies the RNG.  All but one of the following
@@ -49,7 +55,8 @@
 
 //#define RCM_WHICH RCM_PSDES
 //#define RCM_WHICH RCM_URANDOM
-#define RCM_WHICH RCM_RAND48
+//#define RCM_WHICH RCM_RAND48
+#define RCM_WHICH RCM_RUNTIME
 
 // ================================================================
 // pseudo-DES.
@@ -60,6 +67,7 @@
 #define SRANDOM(s)    sran32((unsigned)(s))
 #define URANDOM()     fran32()
 #define IMODRANDOM(m) (iran32() % (m))
+#define URANDOM_FILL(out,n) fran32_fill((out),(n))
 #endif
 
 // ----------------------------------------------------------------
@@ -84,6 +92,22 @@
 #endif
 
 // ----------------------------------------------------------------
+// Chosen at run time, with rcm_select_generator().  The default, rand48,
+// gives the same sequence as RCM_RAND48.
+#if RCM_WHICH == RCM_RUNTIME
+#define RCM_RAND_DESC rcm_generator_name(rcm_get_generator())
+#define STRANDOM(s)   rcm_seed((uint64_t)(time(0) ^ getpid()))
+#define SRANDOM(s)    rcm_seed((uint64_t)(s))
+#define URANDOM()     rcm_urandom()
+#define IMODRANDOM(m) ((int)(rcm_irandom32() % (m)))
+#define URANDOM_FILL(out,n) rcm_urandom_fill((out),(n))
+#endif
+
+// ----------------------------------------------------------------
+#ifndef URANDOM_FILL
+#define URANDOM_FILL(out,n) \
+	do { int _k; for (_k = 0; _k < (n); _k++) (out)[_k] = URANDOM(); } while (0)
+#endif
 #define RANDRANGE(lo,hi) (lo+(hi-lo)*URANDOM())
 #define RANDPM()         (URANDOM() < 0.5 ? 1 : -1)
 
@@ -13,14 +13,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include "putil.h"
+#include "perco2mem.h"
 #include "rgb_matrix.h"
 
 // ----------------------------------------------------------------
-rgb_matrix_t* allocate_rgb_matrix(int height, int width,
-	int r_fill, int g_fill, int b_fill)
+rgb_matrix_t* allocate_rgb_matrix_unfilled(int height, int width)
 {
 	rgb_matrix_t* pmatrix;
-	int i, j;
+	rgb_pixel_t* block;
+	int i;
 
 	if ((height < 1) || (width < 1)) {
 		fprintf(stderr,
@@ -34,13 +35,32 @@ rgb_matrix_t* allocate_rgb_matrix(int height, int width,
 	pmatrix->width  = width;
 	pmatrix->data = (rgb_pixel_t **)malloc_or_die(
 		height * sizeof(rgb_pixel_t *));
-	for (i = 0; i < height; i++) {
-		pmatrix->data[i] = (rgb_pixel_t*)malloc_or_die(
-			width * sizeof(rgb_pixel_t));
-		for (j = 0; j < width; j++) {
-			pmatrix->data[i][j].r = r_fill;
-			pmatrix->data[i][j].g = g_fill;
-			pmatrix->data[i][j].b = b_fill;
+	// The pixels of a large lattice's image may be more than an int's worth
+	// of bytes, which malloc_or_die() cannot ask for.
+	block = (rgb_pixel_t*)large_alloc_or_die(
+		(size_t)height * width * sizeof(rgb_pixel_t));
+	for (i = 0; i < height; i++)
+		pmatrix->data[i] = block + (size_t)i * width;
+
+	return pmatrix;
+}
+
+// ----------------------------------------------------------------
+rgb_matrix_t* allocate_rgb_matrix(int height, int width,
+	int r_fill, int g_fill, int b_fill)
+{
+	rgb_matrix_t* pmatrix = allocate_rgb_matrix_unfilled(height, width);
+	rgb_pixel_t* block = pmatrix->data[0];
+	size_t k, n = (size_t)height * width;
+
+	if ((r_fill == g_fill) && (g_fill == b_fill)) {
+		memset(block, r_fill, n * sizeof(rgb_pixel_t));
+	}
+	else {
+		for (k = 0; k < n; k++) {
+			block[k].r = r_fill;
+			block[k].g = g_fill;
+			block[k].b = b_fill;
 		}
 	}
 
@@ -50,18 +70,25 @@ rgb_matrix_t* allocate_rgb_matrix(int height, int width,
 // ----------------------------------------------------------------
 void free_rgb_matrix(rgb_matrix_t* prgb_matrix)
 {
-	int i;
-	for (i = 0; i < prgb_matrix->height; i++)
-		free(prgb_matrix->data[i]);
+	large_free(prgb_matrix->data[0]);
 	free(prgb_matrix->data);
 	free(prgb_matrix);
 }
 
 // ----------------------------------------------------------------
 void write_rgb_matrix_to_ppm(rgb_matrix_t* prgb_matrix, char* ppm_file_name)
+{
+	FILE* fp = begin_ppm_stream(ppm_file_name, prgb_matrix->height,
+		prgb_matrix->width);
+	write_ppm_stream_rows(fp, prgb_matrix->data[0], prgb_matrix->height,
+		prgb_matrix->width, ppm_file_name);
+	end_ppm_stream(fp, ppm_file_name);
+}
+
+// ----------------------------------------------------------------
+FILE* begin_ppm_stream(char* ppm_file_name, int height, int width)
 {
 	FILE * fp = fopen(ppm_file_name, "w");
-	int i, j;
 
 	if (fp == 0) {
 		fprintf(stderr, "Couldn't open \"%s\" for write.\n",
@@ -69,18 +96,29 @@ void write_rgb_matrix_to_ppm(rgb_matrix_t* prgb_matrix, char* ppm_file_name)
 		exit(1);
 	}
 
-
 	fprintf(fp, "P6\n");
-	fprintf(fp, "%d %d\n", prgb_matrix->width, prgb_matrix->height);
+	fprintf(fp, "%d %d\n", width, height);
 	fprintf(fp, "255\n");
+	return fp;
+}
 
-	for (i = 0; i < prgb_matrix->height; i++) {
-		for (j = 0; j < prgb_matrix->width; j++) {
-			putc(prgb_matrix->data[i][j].r, fp);
-			putc(prgb_matrix->data[i][j].g, fp);
-			putc(prgb_matrix->data[i][j].b, fp);
-		}
+// ----------------------------------------------------------------
+void write_ppm_stream_rows(FILE* fp, rgb_pixel_t* rows, int nrows, int width,
+	char* ppm_file_name)
+{
+	size_t nbytes = (size_t)nrows * width * sizeof(rgb_pixel_t);
+
+	if (fwrite(rows, 1, nbytes, fp) != nbytes) {
+		fprintf(stderr, "Couldn't write \"%s\".\n", ppm_file_name);
+		exit(1);
 	}
+}
 
-	fclose(fp);
+// ----------------------------------------------------------------
+void end_ppm_stream(FILE* fp, char* ppm_file_name)
+{
+	if (fclose(fp) != 0) {
+		fprintf(stderr, "Couldn't close \"%s\".\n", ppm_file_name);
+		exit(1);
+	}
 }
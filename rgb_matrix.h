@@ -4,6 +4,12 @@
 // These are routines for dynamically allocating, freeing, and writing to
 // a PPM file a matrix of red-green-blue triples.  Filling out the contents
 // of the matrix is left to the imagination of the caller.
+//
+// The pixels are stored in one contiguous block, row after row, with no
+// padding:  data[i] points into that block at the start of row i, and
+// data[0] is the start of the block.  Since each pixel is three bytes in
+// r-g-b order, the block is exactly the body of a binary PPM file, and is
+// written out with a single fwrite().
 // ================================================================
 
 // ================================================================
@@ -15,6 +21,8 @@
 #ifndef RGB_MATRIX_H
 #define RGB_MATRIX_H
 
+#include <stdio.h>
+
 // ----------------------------------------------------------------
 typedef struct _rgb_pixel_t {
 	unsigned char r;
@@ -31,7 +39,20 @@ typedef struct _rgb_matrix_t {
 // ----------------------------------------------------------------
 rgb_matrix_t* allocate_rgb_matrix(int height, int width,
 	int r_fill, int g_fill, int b_fill);
+// The same, but leaving the pixels uninitialized, for callers which will
+// write every pixel anyway.
+rgb_matrix_t* allocate_rgb_matrix_unfilled(int height, int width);
 void free_rgb_matrix(rgb_matrix_t* prgb_matrix);
 void write_rgb_matrix_to_ppm(rgb_matrix_t* prgb_matrix, char* ppm_file_name);
 
+// ----------------------------------------------------------------
+// For writing a PPM file a band of rows at a time, without having the whole
+// image in memory.  begin_ppm_stream() opens the file and writes the header;
+// write_ppm_stream_rows() appends nrows rows of width pixels each; and
+// end_ppm_stream() closes the file.  The file name is for error messages.
+FILE* begin_ppm_stream(char* ppm_file_name, int height, int width);
+void  write_ppm_stream_rows(FILE* fp, rgb_pixel_t* rows, int nrows, int width,
+	char* ppm_file_name);
+void  end_ppm_stream(FILE* fp, char* ppm_file_name);
+
 #endif // RGB_MATRIX_H
@@ -18,29 +18,37 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 #include "urandom.h"
 
 #define BUFSZ 2048
 
+// The device is opened once for all threads; each thread has its own buffer.
+static int fd = -1;
+static pthread_once_t fd_once = PTHREAD_ONCE_INIT;
+static char * dev_name = "/dev/urandom";
+
+static void open_urandom(void)
+{
+	fd = open(dev_name, O_RDONLY);
+	if (fd < 0) {
+		perror("open");
+		fprintf(stderr, "Couldn't open %s.\n", dev_name);
+		exit(1);
+	}
+}
+
 // ----------------------------------------------------------------
 int get_urandom(void)
 {
-	static int fd = -1;
-	static int buf[BUFSZ];
-	static int bufpos = 0;
-	static char * dev_name = "/dev/urandom";
+	static __thread int buf[BUFSZ];
+	static __thread int bufpos = 0;
 	int bytes_wanted;
 	int bytes_read;
 	int rv;
-	if (fd == -1) {
-		fd = open(dev_name, O_RDONLY);
-		if (fd < 0) {
-			perror("open");
-			fprintf(stderr, "Couldn't open %s.\n", dev_name);
-			exit(1);
-		}
-	}
+
+	pthread_once(&fd_once, open_urandom);
 
 	if (bufpos == 0) {
 		bytes_wanted = BUFSZ * sizeof(int);